@@ -1,6 +1,7 @@
 #ifdef PYTHON_MODULE
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <structmember.h>
 #endif
 
 #include <SDL2/SDL.h>
@@ -12,10 +13,19 @@
 #include <SDL2/SDL_render.h>
 #include <SDL2/SDL_ttf.h>
 #include <SDL2/SDL_video.h>
+#include <errno.h>
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 #include "bell_wav.xxd"
 #include "lemon_ttf.xxd"
@@ -36,11 +46,23 @@
 #define FRAME_DELAY (1000 / FPS)
 #define MAX_NODES 1000
 #define MAX_LABEL_LENGTH 4096
+#define MAX_HOVER_LABEL_LENGTH 1024
+#define MAX_CUT_LABELS 64 // Edge labels drawn along a minimum cut
+#define MAX_CYCLE_LENGTH 12
+#define MAX_CYCLES 1000
+#define CYCLE_SEARCH_SLICE_MS 4 // Per frame
+#define REACH_MAX_THREADS 8
+#define REACH_PARALLEL_FRONTIER 16384 // Smaller BFS levels stay on one thread
+#define COMPONENT_SPACING 60 // Condensation layout, within a layer
+#define COMPONENT_LAYER_SPACING 150
+#define WEAKREF_EDGE_LABEL "weak reference" // Skipped by traversals by default
+#define MIN_CHAIN_LENGTH 2 // Nodes folded into a "chain of N" edge
 #define SEARCH_BAR_HEIGHT 30
 #define MAX_SEARCH_LENGTH 4096
 #define RAND_XY_INIT_RANGE 500
 #define TOP_BAR_HEIGHT 40
 #define OPEN_BUTTON_WIDTH 100
+#define COMPARE_BUTTON_WIDTH 100
 
 #define LAYOUT_AREA_MULTIPLIER 1000
 #define FORCE_ITERATIONS 100
@@ -48,6 +70,34 @@
 #define FRUCHTERMAN_REINGOLD_INITIAL_TEMP 10.0
 #define FRUCHTERMAN_REINGOLD_COOLING 0.80
 
+#define NODE_RADIUS 5
+#define ARROWHEAD_SIZE 10
+#define ARROWHEAD_MIN_ZOOM 0.4f
+#define ARROWHEAD_COS 0.96592582628f // cos(pi / 12)
+#define ARROWHEAD_SIN 0.25881904510f // sin(pi / 12)
+
+// Below LOD_ZOOM_THRESHOLD the graph is drawn as a density map plus bundled
+// edges; between it and LOD_FADE_ZOOM the two representations crossfade.
+#define LOD_ZOOM_THRESHOLD 0.25f
+#define LOD_FADE_ZOOM 0.5f
+#define LOD_CELL_SIZE 4
+#define LOD_BUNDLE_CELL_SIZE 32
+
+// Full-detail graph layer tiles. Levels are spaced TILE_LEVELS_PER_OCTAVE
+// per doubling of zoom; level 0 is zoom 1.
+#define TILE_SIZE 256
+#define TILE_LEVELS_PER_OCTAVE 2
+#define TILE_CACHE_MAX_TILES 256
+#define TILE_HASH_BUCKETS 512
+#define TILE_FALLBACK_OCTAVES 3
+#define SPATIAL_NODES_PER_CELL 8 // Level 0 of the spatial index, if spread evenly
+#define SPATIAL_MAX_COLUMNS 1024
+#define SPATIAL_MAX_LEVELS 32
+
+// Live updates (--listen)
+#define LABEL_CHUNK_SIZE (64 * 1024)
+#define DELTA_READ_SIZE (64 * 1024)
+
 // Color definitions
 #define COLOR_MENU_ITEM_1                                                      \
   (SDL_Color) { 55, 55, 55, 255 }
@@ -62,25 +112,124 @@ typedef struct {
   float x, y;
 } Vec2f;
 
+// How a node relates to the earlier snapshot in a diff.
+typedef enum {
+  DIFF_NONE,
+  DIFF_RETAINED,
+  DIFF_ADDED,
+  DIFF_REMOVED,
+} DiffStatus;
+
 typedef struct {
   int id;
   int visible;
+  int removed; // Tombstone left by a live update; the slot may be reused
   Vec2f position;
   const char *label;
+  const char *type; // Type name from objgraph, or NULL
+  int type_id;      // Index into GraphData.type_names, -1 when untyped
+  Uint64 address;   // Object address from objgraph, or 0
+  DiffStatus diff;
+  int label_resolved; // The resolver has already been asked for this node
+  int root;           // Flagged "root" by objgraph
+  Uint64 size;        // Shallow size in bytes from objgraph, or 0
+  Uint64 retained;    // Size of everything the node dominates, itself included
 } GraphNode;
 
 typedef struct {
   int source;
   int target;
   const char *label;
+  int label_id; // Index into GraphData.edge_label_names
 } GraphEdge;
 
+// Edge labels traversals follow: only the follow labels when there are any,
+// and never the skip labels. version is bumped on every change.
+typedef struct {
+  char **follow;
+  int follow_count;
+  char **skip;
+  int skip_count;
+  unsigned version;
+} EdgeFilter;
+
+// Labels added after loading are copied into a list of chunks owned by the
+// graph.
+typedef struct LabelChunk {
+  struct LabelChunk *next;
+  size_t used;
+  size_t size;
+  char data[];
+} LabelChunk;
+
+// Edges grouped by one endpoint: the edges of node i are
+// edges[offsets[i]] .. edges[offsets[i + 1] - 1], as indices into
+// GraphData.edges, and nodes[] holds the node at their other end.
+typedef struct {
+  int *offsets;
+  int *edges;
+  int *nodes;
+} EdgeIndex;
+
+// World-space grid over the layout, so that drawing a region only visits
+// the nodes and edges near it. Level l has cells of cell_size << l. Nodes
+// are filed under their level 0 cell. An edge is filed once, at the first
+// level whose cells are at least as large as its bounding box, under the
+// cell holding the box's low corner, so it reaches at most one cell further
+// right and down. Rebuilt by ensure_spatial_index when the layout changes.
+typedef struct {
+  float min_x;
+  float min_y;
+  float cell_size;
+  int levels;
+  int columns[SPATIAL_MAX_LEVELS];
+  int rows[SPATIAL_MAX_LEVELS];
+  int first_cell[SPATIAL_MAX_LEVELS]; // Of each level in edge_offsets
+  int *node_offsets; // Per level 0 cell, into nodes
+  int *nodes;
+  int *edge_offsets; // Per cell of every level, into edges
+  int *edges;
+  unsigned layout_version;
+  int valid;
+} SpatialIndex;
+
+// Produces the full label of a node whose stored label was shortened during
+// collection, e.g. by calling back into the process the graph came from.
+typedef struct {
+  char *(*resolve)(void *context, int node_id); // malloc'd, or NULL
+  void (*release)(void *context);
+  void *context;
+} LabelResolver;
+
 typedef struct {
   GraphNode *nodes;
   GraphEdge *edges;
   int node_count;
   int edge_count;
+  int node_capacity;
+  int edge_capacity;
   yyjson_doc *doc;
+  char *label_arena; // Owns the labels of graphs not backed by a JSON doc
+  LabelChunk *label_chunks;
+  Vec2f *edge_directions; // Unit source->target vectors, world space
+  int edge_directions_valid;
+  unsigned layout_version; // Bumped whenever node positions change
+  LabelResolver resolver;  // resolve is NULL when labels are final
+  EdgeIndex out_edges;     // By source
+  EdgeIndex in_edges;      // By target
+  int edge_index_valid;
+  SpatialIndex spatial;    // See ensure_spatial_index()
+  int *retained_order;     // Node ids by retained size, largest first
+  int retained_valid;
+  const char **type_names; // Distinct node types, indexed by type_id
+  int type_count;
+  int types_valid;
+  const char **edge_label_names; // Distinct edge labels, indexed by label_id
+  int edge_label_count;
+  int edge_labels_valid;
+  const EdgeFilter *filter; // The viewer's, or NULL to follow every edge
+  Uint64 *followed_edges;   // Bitset over edges, see edge_followed()
+  unsigned filter_version;  // Of the filter followed_edges was built for
 } GraphData;
 
 typedef enum {
@@ -89,9 +238,23 @@ typedef enum {
   SELECT_REFERENCED_BY,
   SELECT_REFERENCES_RECURSIVE,
   SELECT_REFERENCED_BY_RECURSIVE,
+  SELECT_PATH_TO_ROOT,
+  SELECT_MIN_CUT,
+  SELECT_CYCLES,
   SELECT_MODE_COUNT
 } NodeSelectionMode;
 
+static const char *selection_mode_names[SELECT_MODE_COUNT] = {
+    "Single",
+    "References",
+    "Referenced By",
+    "References (Recursive)",
+    "Referenced By (Recursive)",
+    "Path to Root",
+    "Min Cut",
+    "Cycles",
+};
+
 typedef struct {
   float zoom;
   Vec2f position;
@@ -103,6 +266,175 @@ typedef struct {
 } SearchBar;
 
 typedef struct {
+  SDL_Texture *texture;
+  int grid_width;
+  int grid_height;
+  Uint32 *counts;          // Visible nodes per cell
+  Uint32 *selected_counts; // Selected visible nodes per cell
+  Uint32 *pixels;
+  // Edge bundles: open-addressed map from (cell, cell) to edge count. Slots
+  // whose stamp differs from the current frame are treated as empty.
+  Uint64 *bundle_keys;
+  Uint32 *bundle_counts;
+  Uint32 *bundle_stamps;
+  int bundle_capacity;
+  Uint32 frame;
+} DensityLayer;
+
+// The unselected part of the graph, rasterized once and reused until the
+// camera, the layout, visibility or the selection changes.
+typedef struct {
+  SDL_Texture *texture;
+  int width;
+  int height;
+  int valid;
+  Camera camera;
+  unsigned layout_version;
+} GraphLayerCache;
+
+typedef enum {
+  TILE_FREE,
+  TILE_QUEUED,     // Waiting for the worker
+  TILE_RENDERING,  // Owned by the worker
+  TILE_RASTERIZED, // Surface ready, texture not yet created
+  TILE_READY,
+} TileState;
+
+typedef struct {
+  int level;
+  int x;
+  int y;
+  TileState state;
+  SDL_Surface *surface;
+  SDL_Texture *texture;
+  Uint32 last_used;
+  int next; // Hash chain
+} Tile;
+
+// Unselected edges and nodes of one region of the graph layer, copied out
+// of the graph in the region's pixel coordinates so that they can be drawn
+// without holding graph_lock. Edges are already clipped to the region.
+typedef struct {
+  Vec2f start;
+  Vec2f end;
+  Vec2f direction;
+  int arrowhead; // end is the target node, not a clipped point
+} LayerEdge;
+
+typedef struct {
+  Vec2f position;
+  SDL_Color color;
+} LayerNode;
+
+typedef struct {
+  LayerEdge *edges;
+  int edge_count;
+  int edge_capacity;
+  LayerNode *nodes;
+  int node_count;
+  int node_capacity;
+} LayerBatch;
+
+typedef struct {
+  Tile tiles[TILE_CACHE_MAX_TILES];
+  int buckets[TILE_HASH_BUCKETS];
+  int queue[TILE_CACHE_MAX_TILES];
+  int queue_length;
+  unsigned version; // Bumped whenever cached tile contents become stale
+  unsigned layout_version;
+  Uint32 frame;
+  int quit;
+  SDL_Thread *thread;
+  SDL_mutex *lock;       // Guards everything above
+  SDL_cond *wake;
+  SDL_mutex *graph_lock; // Held by the worker while it reads the graph
+  LayerBatch holes;      // Main thread only, see render_tiled_graph_layer
+} TileCache;
+
+// Open-addressed map from nonzero 64-bit keys to ints. Removal shifts the
+// following entries back, so deletions leave no tombstones.
+typedef struct {
+  Uint64 *keys; // 0 marks an empty slot
+  int *values;
+  size_t mask;
+  size_t count;
+} KeyTable;
+
+// Enumeration of the elementary cycles through one node, shortest first. It
+// runs a slice per frame so the first cycles show up right away; pass L
+// finds the cycles of exactly L edges.
+typedef struct {
+  int node;          // -1 when no search is running or shown
+  int done;
+  int bound;         // Length of the cycles the current pass looks for
+  int depth;         // Edges on the current path
+  int *distance;     // Edges from a node back to node, -1 outside its SCC
+  char *on_path;
+  int *path;         // path[d] is the node at depth d
+  int *path_edges;   // path_edges[d] leaves path[d]
+  int *next;         // next[d] is the next out slot of path[d] to try
+  int *cycle_edges;  // Edges of every cycle found, back to back
+  int *cycle_starts; // cycle_count + 1 offsets into cycle_edges
+  int cycle_count;
+  int cycle_edges_capacity;
+} CycleSearch;
+
+typedef struct {
+  int type; // Type slot, see type_name()
+  int count;
+  Uint64 size;
+} TypeCount;
+
+// Instances per type among the visible nodes, or among the selected ones
+// after select_unreachable, for the right menu's type view. Recounted from
+// the type ids whenever visibility changes.
+typedef struct {
+  TypeCount *rows; // Sorted by count, largest first
+  int length;
+  int valid;
+  int selected_only; // Count the selection instead of the visible nodes
+} TypeHistogram;
+
+typedef enum { SUMMARY_TYPES, SUMMARY_COMPONENTS, SUMMARY_CHAINS } SummaryKind;
+
+// While a summary is shown, app->graph is built from full by
+// summarize_graph() and replaced whenever a group is expanded or collapsed.
+// Groups are the type slots, the strongly connected components or the
+// linear chains of full. Nodes in group group_count are never grouped.
+typedef struct {
+  GraphData *full; // NULL when the summary is off
+  SummaryKind kind;
+  int *groups;      // Group of each node of full
+  int group_count;
+  Vec2f *positions; // Per group; NULL places supernodes at their first member
+  int *chain_ends;  // Per chain, the nodes before and after it
+  char *expanded;   // Per group
+  int *origins;     // See summarize_graph()
+  int *chain_edges; // Per view edge, the collapsed chain it stands for, or -1
+  KeyTable node_keys; // The live update state of full, set aside
+  int *free_nodes;
+  int free_node_count;
+} GraphSummary;
+
+typedef struct DeltaMessage {
+  yyjson_doc *doc;
+  struct DeltaMessage *next;
+} DeltaMessage;
+
+// Requests posted to a running viewer from another thread. The viewer picks
+// them up once per frame.
+typedef struct {
+  SDL_mutex *lock;     // Guards everything below
+  GraphData *graph;    // Replacement graph, owned by the viewer once taken
+  int *selection;      // Node ids to select, or NULL
+  int selection_count;
+  DeltaMessage *deltas; // Live updates, oldest first
+  DeltaMessage *deltas_tail;
+  int close;
+  int finished;        // Set by the viewer when its window is gone
+} ViewerControl;
+
+typedef struct AppState {
   GraphData *graph;
   Camera camera;
   TTF_Font *font_small;
@@ -113,6 +445,7 @@ typedef struct {
   SearchBar search_bar;
   NodeSelectionMode selection_mode;
   int *selected_nodes;
+  Vec2f *screen_positions; // Per-node screen coordinates for the current frame
   int right_scroll_position;
   int right_menu_hovered_item;
   int left_scroll_position;
@@ -121,6 +454,18 @@ typedef struct {
   int nodes_per_page;
   Vec2f mouse_position;
   int filter_referenced;
+  int sort_by_retained; // Right menu ordered by retained size
+  int group_by_type;    // Right menu lists types instead of nodes
+  TypeHistogram types;
+  GraphSummary summary;
+  EdgeFilter filter; // Edge labels traversals follow, see edge_followed()
+  int *path;            // Nodes of the selected path to root, root first
+  int *path_edges;      // path_edges[k] goes from path[k] to path[k + 1]
+  int path_length;      // 0 unless the selection is a path
+  int *cut_edges;       // Edges of the selected minimum cut
+  int cut_length;       // 0 unless the selection is a cut
+  int cut_node;         // The node the cut separates from the roots
+  CycleSearch cycles;
   int hovered_node;
   int hovered_edge;
   int is_dragging_left_scrollbar;
@@ -128,28 +473,52 @@ typedef struct {
   int drag_start_y;
   int drag_start_scroll;
   SDL_Rect open_button;
+  SDL_Rect compare_button;
+  DensityLayer density;
+  GraphLayerCache graph_layer;
+  TileCache tiles;
+  KeyTable node_keys; // Live update key -> node index
+  int *free_nodes;    // Tombstoned node slots, node_capacity entries
+  int free_node_count;
+  int live_seeded; // node_keys came from the loaded file's addresses
 } AppState;
 
 // Function declarations
 static inline GraphData *create_graph(int node_count, int edge_count);
 static inline void free_graph(GraphData *graph);
 static inline GraphData *load_graph(const char *filename);
+static inline GraphData *diff_graphs(const GraphData *before,
+                                     const GraphData *after);
+static inline GraphData *
+create_graph_from_arrays(int node_count, int edge_count, const int32_t *sources,
+                         const int32_t *targets, const char *const *node_labels,
+                         const char *const *edge_labels);
 static inline void apply_force_directed_layout(GraphData *graph);
 static inline void apply_fruchterman_reingold_layout(GraphData *graph);
+static inline void invalidate_layout(GraphData *graph);
+static inline void update_edge_directions(GraphData *graph);
 static inline void update_node_visibility(AppState *app);
+static inline void update_screen_positions(AppState *app);
+static inline void invalidate_graph_layer(AppState *app);
 static inline void cycle_selection_mode(AppState *app);
 static inline void update_open_button_position(AppState *app);
 static inline char *handle_open_button_click(void);
 static inline void set_node_selection(AppState *app, int node_id);
 static inline void set_edge_selection(AppState *app, int edge_id);
+static inline void set_selection(AppState *app, const int *ids, int count);
 static inline void render_top_bar(SDL_Renderer *renderer, AppState *app);
 static inline void render_graph(SDL_Renderer *renderer, AppState *app);
+static inline void render_label(SDL_Renderer *renderer, const char *text, int x,
+                                int y, TTF_Font *font, SDL_Color color,
+                                int max_width);
 static inline void render_left_menu(SDL_Renderer *renderer, AppState *app);
 static inline void render_right_menu(SDL_Renderer *renderer, AppState *app);
 static inline void handle_input(SDL_Event *event, AppState *app);
-static inline void initialize_app(AppState *app, const char *graph_file);
+static inline void initialize_app(AppState *app, GraphData *graph);
 static inline void cleanup_app(AppState *app);
-static inline void reinitialize_app(AppState *app, const char *graph_file);
+static inline void reinitialize_app(AppState *app, GraphData *graph);
+static inline void seed_node_keys(AppState *app);
+static inline int run_viewer(GraphData *graph, ViewerControl *control);
 static inline int run_graph_viewer(const char *graph_file);
 
 #define LEFT_MENU_WIDTH(window_width) ((window_width) * 0.15)
@@ -165,6 +534,29 @@ static inline GraphData *create_graph(int node_count, int edge_count) {
   }
   graph->node_count = node_count;
   graph->edge_count = edge_count;
+  graph->node_capacity = node_count;
+  graph->edge_capacity = edge_count;
+  graph->doc = NULL;
+  graph->label_arena = NULL;
+  graph->label_chunks = NULL;
+  graph->edge_directions = NULL;
+  graph->edge_directions_valid = 0;
+  graph->layout_version = 0;
+  graph->resolver = (LabelResolver){0};
+  graph->out_edges = graph->in_edges = (EdgeIndex){0};
+  graph->edge_index_valid = 0;
+  memset(&graph->spatial, 0, sizeof(SpatialIndex));
+  graph->retained_order = NULL;
+  graph->retained_valid = 0;
+  graph->type_names = NULL;
+  graph->type_count = 0;
+  graph->types_valid = 0;
+  graph->edge_label_names = NULL;
+  graph->edge_label_count = 0;
+  graph->edge_labels_valid = 0;
+  graph->filter = NULL;
+  graph->followed_edges = NULL;
+  graph->filter_version = 0;
   graph->nodes = (GraphNode *)calloc(node_count, sizeof(GraphNode));
   graph->edges = (GraphEdge *)calloc(edge_count, sizeof(GraphEdge));
   if (!graph->nodes || !graph->edges) {
@@ -181,14 +573,324 @@ static inline void free_graph(GraphData *graph) {
   if (graph->doc) {
     yyjson_doc_free(graph->doc);
   }
+  free(graph->label_arena);
+  while (graph->label_chunks) {
+    LabelChunk *next = graph->label_chunks->next;
+    free(graph->label_chunks);
+    graph->label_chunks = next;
+  }
+  if (graph->resolver.release)
+    graph->resolver.release(graph->resolver.context);
+  free(graph->out_edges.offsets);
+  free(graph->out_edges.edges);
+  free(graph->out_edges.nodes);
+  free(graph->in_edges.offsets);
+  free(graph->in_edges.edges);
+  free(graph->in_edges.nodes);
+  free(graph->spatial.node_offsets);
+  free(graph->spatial.nodes);
+  free(graph->spatial.edge_offsets);
+  free(graph->spatial.edges);
+  free(graph->retained_order);
+  free(graph->type_names);
+  free(graph->edge_label_names);
+  free(graph->followed_edges);
   free(graph->nodes);
   free(graph->edges);
+  free(graph->edge_directions);
   free(graph);
 }
 
+static inline size_t key_slot(const KeyTable *table, Uint64 key) {
+  key ^= key >> 30;
+  key *= 0xBF58476D1CE4E5B9ull;
+  key ^= key >> 27;
+  key *= 0x94D049BB133111EBull;
+  key ^= key >> 31;
+  return (size_t)key & table->mask;
+}
+
+static inline void key_table_free(KeyTable *table) {
+  free(table->keys);
+  free(table->values);
+  memset(table, 0, sizeof(KeyTable));
+}
+
+static inline int key_table_get(const KeyTable *table, Uint64 key) {
+  if (!table->keys || !key)
+    return -1;
+  for (size_t slot = key_slot(table, key); table->keys[slot];
+       slot = (slot + 1) & table->mask)
+    if (table->keys[slot] == key)
+      return table->values[slot];
+  return -1;
+}
+
+static inline void key_table_put(KeyTable *table, Uint64 key, int value) {
+  size_t slot = key_slot(table, key);
+  while (table->keys[slot] && table->keys[slot] != key)
+    slot = (slot + 1) & table->mask;
+  table->count += !table->keys[slot];
+  table->keys[slot] = key;
+  table->values[slot] = value;
+}
+
+// Makes room for count entries, keeping the load factor at most one half.
+static inline int key_table_reserve(KeyTable *table, size_t count) {
+  size_t capacity = table->keys ? table->mask + 1 : 0;
+  if (2 * count <= capacity)
+    return 1;
+  size_t new_capacity = capacity ? capacity : 1024;
+  while (new_capacity < 2 * count)
+    new_capacity *= 2;
+
+  KeyTable grown = {calloc(new_capacity, sizeof(Uint64)),
+                    malloc(new_capacity * sizeof(int)), new_capacity - 1, 0};
+  if (!grown.keys || !grown.values) {
+    key_table_free(&grown);
+    return 0;
+  }
+  for (size_t i = 0; i < capacity; i++)
+    if (table->keys[i])
+      key_table_put(&grown, table->keys[i], table->values[i]);
+  key_table_free(table);
+  *table = grown;
+  return 1;
+}
+
+// Removes key and returns its value, or -1 if it was not present.
+static inline int key_table_remove(KeyTable *table, Uint64 key) {
+  if (!table->keys || !key)
+    return -1;
+  size_t hole = key_slot(table, key);
+  while (table->keys[hole] != key) {
+    if (!table->keys[hole])
+      return -1;
+    hole = (hole + 1) & table->mask;
+  }
+  int value = table->values[hole];
+
+  for (size_t slot = (hole + 1) & table->mask; table->keys[slot];
+       slot = (slot + 1) & table->mask) {
+    size_t home = key_slot(table, table->keys[slot]);
+    int reachable = hole < slot ? (home > hole && home <= slot)
+                                : (home > hole || home <= slot);
+    if (!reachable) {
+      table->keys[hole] = table->keys[slot];
+      table->values[hole] = table->values[slot];
+      hole = slot;
+    }
+  }
+  table->keys[hole] = 0;
+  table->count--;
+  return value;
+}
+
+static inline Uint64 edge_key(int source, int target) {
+  return ((Uint64)(source + 1) << 32) | (Uint32)target;
+}
+
+static inline const char *store_label(GraphData *graph, const char *label,
+                                      size_t length) {
+  if (!length)
+    return "";
+  LabelChunk *chunk = graph->label_chunks;
+  if (!chunk || chunk->size - chunk->used < length + 1) {
+    size_t size = length + 1 > LABEL_CHUNK_SIZE ? length + 1 : LABEL_CHUNK_SIZE;
+    chunk = malloc(sizeof(LabelChunk) + size);
+    if (!chunk)
+      return NULL;
+    chunk->next = graph->label_chunks;
+    chunk->used = 0;
+    chunk->size = size;
+    graph->label_chunks = chunk;
+  }
+  char *copy = chunk->data + chunk->used;
+  memcpy(copy, label, length);
+  copy[length] = '\0';
+  chunk->used += length + 1;
+  return copy;
+}
+
+// Grows the node and edge arrays to hold at least node_count nodes and
+// edge_count edges.
+static inline int reserve_graph_storage(GraphData *graph, int node_count,
+                                        int edge_count) {
+  if (node_count > graph->node_capacity) {
+    int capacity = graph->node_capacity ? graph->node_capacity : 64;
+    while (capacity < node_count)
+      capacity *= 2;
+    GraphNode *nodes = realloc(graph->nodes, capacity * sizeof(GraphNode));
+    if (!nodes)
+      return 0;
+    graph->nodes = nodes;
+    graph->node_capacity = capacity;
+  }
+
+  if (edge_count > graph->edge_capacity) {
+    int capacity = graph->edge_capacity ? graph->edge_capacity : 64;
+    while (capacity < edge_count)
+      capacity *= 2;
+    GraphEdge *edges = realloc(graph->edges, capacity * sizeof(GraphEdge));
+    if (!edges)
+      return 0;
+    graph->edges = edges;
+    graph->edge_capacity = capacity;
+    // Reallocated at the new capacity on the next update.
+    free(graph->edge_directions);
+    graph->edge_directions = NULL;
+    graph->edge_directions_valid = 0;
+  }
+  return 1;
+}
+
+// Appends the line-per-record format written by objgraph.write_graph_jsonl:
+// a header line, then one node or edge object per line. Records are parsed
+// one at a time, so besides the graph only the current line is buffered.
+// Node ids have to continue where the graph left off.
+static inline void read_graph_jsonl(GraphData *graph, FILE *file) {
+  char *line = NULL;
+  size_t line_capacity = 0;
+  ssize_t length;
+  while ((length = getline(&line, &line_capacity, file)) > 0) {
+    yyjson_doc *doc = yyjson_read(line, length, 0);
+    yyjson_val *record = yyjson_doc_get_root(doc);
+    yyjson_val *id = yyjson_obj_get(record, "id");
+    yyjson_val *source = yyjson_obj_get(record, "source");
+    yyjson_val *target = yyjson_obj_get(record, "target");
+    yyjson_val *label = yyjson_obj_get(record, "label");
+    const char *text = yyjson_is_str(label)
+                           ? store_label(graph, yyjson_get_str(label),
+                                         yyjson_get_len(label))
+                           : NULL;
+
+    if (yyjson_is_int(id) && text) {
+      if (yyjson_get_int(id) != graph->node_count) {
+        fprintf(stderr, "Node %lld is out of order, expected %d\n",
+                (long long)yyjson_get_sint(id), graph->node_count);
+        yyjson_doc_free(doc);
+        break;
+      }
+      if (!reserve_graph_storage(graph, graph->node_count + 1,
+                                 graph->edge_count))
+        goto oom;
+      GraphNode *node = &graph->nodes[graph->node_count++];
+      memset(node, 0, sizeof(GraphNode));
+      yyjson_val *type = yyjson_obj_get(record, "type");
+      node->id = yyjson_get_int(id);
+      node->position.x =
+          (rand() % (2 * RAND_XY_INIT_RANGE)) - RAND_XY_INIT_RANGE;
+      node->position.y =
+          (rand() % (2 * RAND_XY_INIT_RANGE)) - RAND_XY_INIT_RANGE;
+      node->label = text;
+      node->type = yyjson_is_str(type) ? store_label(graph, yyjson_get_str(type),
+                                                     yyjson_get_len(type))
+                                       : NULL;
+      node->address = yyjson_get_uint(yyjson_obj_get(record, "address"));
+      node->size = yyjson_get_uint(yyjson_obj_get(record, "size"));
+      node->root = yyjson_get_bool(yyjson_obj_get(record, "root"));
+      node->visible = 1;
+    } else if (yyjson_is_int(source) && yyjson_is_int(target) && text) {
+      if (!reserve_graph_storage(graph, graph->node_count,
+                                 graph->edge_count + 1))
+        goto oom;
+      graph->edges[graph->edge_count++] = (GraphEdge){
+          yyjson_get_int(source), yyjson_get_int(target), text, 0};
+    }
+    yyjson_doc_free(doc);
+    continue;
+
+  oom:
+    fprintf(stderr, "Failed to allocate memory for graph\n");
+    yyjson_doc_free(doc);
+    break;
+  }
+  free(line);
+}
+
+// A stream cut short can end with edges to nodes it never wrote.
+static inline void drop_dangling_edges(GraphData *graph) {
+  int kept = 0;
+  for (int i = 0; i < graph->edge_count; i++) {
+    GraphEdge edge = graph->edges[i];
+    if (edge.source >= 0 && edge.source < graph->node_count &&
+        edge.target >= 0 && edge.target < graph->node_count)
+      graph->edges[kept++] = edge;
+  }
+  graph->edge_count = kept;
+}
+
+// Reads a manifest written by objgraph.write_graph_shards,
+//   {"format": "graph-shards", "version": 1, "shards": [path, ...]},
+// and joins the listed streams into one graph. Relative paths are taken
+// from the manifest's directory.
+static inline void read_graph_shards(GraphData *graph, const char *filename) {
+  yyjson_read_err err;
+  yyjson_doc *doc = yyjson_read_file(filename, 0, NULL, &err);
+  if (!doc) {
+    fprintf(stderr, "Failed to read %s: %s\n", filename, err.msg);
+    return;
+  }
+  const char *slash = strrchr(filename, '/');
+  int dir_length = slash ? (int)(slash - filename + 1) : 0;
+
+  yyjson_val *shards = yyjson_obj_get(yyjson_doc_get_root(doc), "shards");
+  yyjson_val *shard;
+  yyjson_arr_iter iter;
+  yyjson_arr_iter_init(shards, &iter);
+  while ((shard = yyjson_arr_iter_next(&iter))) {
+    const char *name = yyjson_get_str(shard);
+    if (!name)
+      continue;
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%.*s%s", name[0] == '/' ? 0 : dir_length,
+             filename, name);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+      fprintf(stderr, "Failed to open shard %s: %s\n", path, strerror(errno));
+      break;
+    }
+    int before = graph->node_count;
+    read_graph_jsonl(graph, file);
+    fclose(file);
+    DEBUG_PRINT("Shard %s: %d nodes\n", path, graph->node_count - before);
+  }
+  yyjson_doc_free(doc);
+}
+
 static inline GraphData *load_graph(const char *filename) {
   DEBUG_PRINT("Loading graph from file: %s\n", filename);
 
+  // Streams written by objgraph.write_graph_jsonl, and the manifests of
+  // sharded ones, start with these headers.
+  static const char jsonl_header[] = "{\"format\":\"graph-jsonl\"";
+  static const char shards_header[] = "{\"format\":\"graph-shards\"";
+  FILE *file = filename ? fopen(filename, "r") : NULL;
+  if (file) {
+    char prefix[sizeof(shards_header)] = {0};
+    size_t read = fread(prefix, 1, sizeof(prefix) - 1, file);
+    int jsonl = read >= sizeof(jsonl_header) - 1 &&
+                !memcmp(prefix, jsonl_header, sizeof(jsonl_header) - 1);
+    int shards = read == sizeof(shards_header) - 1 &&
+                 !memcmp(prefix, shards_header, sizeof(shards_header) - 1);
+    GraphData *graph = jsonl || shards ? create_graph(0, 0) : NULL;
+    if (graph && jsonl) {
+      rewind(file);
+      read_graph_jsonl(graph, file);
+    } else if (graph) {
+      read_graph_shards(graph, filename);
+    }
+    fclose(file);
+    if (jsonl || shards) {
+      if (graph)
+        drop_dangling_edges(graph);
+      DEBUG_PRINT("Node count: %d, Edge count: %d\n",
+                  graph ? graph->node_count : 0,
+                  graph ? graph->edge_count : 0);
+      return graph;
+    }
+  }
+
   // Read the entire file
   yyjson_read_flag flg = 0;
   yyjson_read_err err;
@@ -248,6 +950,10 @@ static inline GraphData *load_graph(const char *filename) {
     graph->nodes[idx].position.y =
         (rand() % (2 * RAND_XY_INIT_RANGE)) - RAND_XY_INIT_RANGE;
     graph->nodes[idx].label = yyjson_get_str(label);
+    graph->nodes[idx].type = yyjson_get_str(yyjson_obj_get(node, "type"));
+    graph->nodes[idx].address = yyjson_get_uint(yyjson_obj_get(node, "address"));
+    graph->nodes[idx].size = yyjson_get_uint(yyjson_obj_get(node, "size"));
+    graph->nodes[idx].root = yyjson_get_bool(yyjson_obj_get(node, "root"));
     graph->nodes[idx].visible = 1;
     DEBUG_PRINT("Node %zu: id=%d, label=%s\n", idx, graph->nodes[idx].id,
                 graph->nodes[idx].label);
@@ -281,1406 +987,6392 @@ static inline GraphData *load_graph(const char *filename) {
   return graph;
 }
 
-static inline void apply_force_directed_layout(GraphData *graph) {
-  float width = sqrt(LAYOUT_AREA_MULTIPLIER * graph->node_count);
-  float height = width;
-  float area = width * height;
-  float k = sqrt(area / graph->node_count);
-  float t = width / 10;
+// Builds a graph straight from edge index arrays, without going through
+// JSON. Node ids are array indices. Labels are copied into one arena owned
+// by the graph; edge_labels may be NULL.
+static inline GraphData *
+create_graph_from_arrays(int node_count, int edge_count, const int32_t *sources,
+                         const int32_t *targets, const char *const *node_labels,
+                         const char *const *edge_labels) {
+  DEBUG_PRINT("Node count: %d, Edge count: %d\n", node_count, edge_count);
 
-  Vec2f *forces = calloc(graph->node_count, sizeof(Vec2f));
-  if (!forces) {
-    fprintf(stderr, "Failed to allocate memory for force calculation\n");
-    return;
-  }
+  GraphData *graph = create_graph(node_count, edge_count);
+  if (!graph)
+    return NULL;
 
-  for (int iter = 0; iter < FORCE_ITERATIONS; iter++) {
-    memset(forces, 0, graph->node_count * sizeof(Vec2f));
+  size_t arena_size = 1;
+  for (int i = 0; i < node_count; i++)
+    arena_size += strlen(node_labels[i]) + 1;
+  for (int i = 0; edge_labels && i < edge_count; i++)
+    arena_size += strlen(edge_labels[i]) + 1;
 
-    // Calculate repulsive forces
-    for (int i = 0; i < graph->node_count; i++) {
-      for (int j = i + 1; j < graph->node_count; j++) {
-        float dx = graph->nodes[i].position.x - graph->nodes[j].position.x;
-        float dy = graph->nodes[i].position.y - graph->nodes[j].position.y;
-        float distance = sqrt(dx * dx + dy * dy);
-        if (distance == 0)
-          distance = 0.01;
+  char *arena = graph->label_arena = malloc(arena_size);
+  if (!arena) {
+    fprintf(stderr, "Failed to allocate memory for labels\n");
+    free_graph(graph);
+    return NULL;
+  }
+  *arena++ = '\0'; // Shared empty label
 
-        float force = k * k / distance;
-        float fx = dx / distance * force;
-        float fy = dy / distance * force;
+  for (int i = 0; i < node_count; i++) {
+    size_t length = strlen(node_labels[i]) + 1;
+    memcpy(arena, node_labels[i], length);
+    graph->nodes[i].id = i;
+    graph->nodes[i].position.x =
+        (rand() % (2 * RAND_XY_INIT_RANGE)) - RAND_XY_INIT_RANGE;
+    graph->nodes[i].position.y =
+        (rand() % (2 * RAND_XY_INIT_RANGE)) - RAND_XY_INIT_RANGE;
+    graph->nodes[i].label = arena;
+    graph->nodes[i].visible = 1;
+    arena += length;
+  }
 
-        forces[i].x += fx;
-        forces[i].y += fy;
-        forces[j].x -= fx;
-        forces[j].y -= fy;
-      }
+  for (int i = 0; i < edge_count; i++) {
+    graph->edges[i].source = sources[i];
+    graph->edges[i].target = targets[i];
+    graph->edges[i].label = graph->label_arena;
+    if (edge_labels) {
+      size_t length = strlen(edge_labels[i]) + 1;
+      memcpy(arena, edge_labels[i], length);
+      graph->edges[i].label = arena;
+      arena += length;
     }
+  }
 
-    // Calculate attractive forces
-    for (int i = 0; i < graph->edge_count; i++) {
-      int source = graph->edges[i].source;
-      int target = graph->edges[i].target;
-      float dx =
-          graph->nodes[source].position.x - graph->nodes[target].position.x;
-      float dy =
-          graph->nodes[source].position.y - graph->nodes[target].position.y;
-      float distance = sqrt(dx * dx + dy * dy);
-      if (distance == 0)
-        distance = 0.01;
+  return graph;
+}
 
-      float force = (distance * distance) / k;
-      float fx = dx / distance * force;
-      float fy = dy / distance * force;
+static inline Uint64 type_hash(const char *type) {
+  Uint64 hash = 14695981039346656037ull; // FNV-1a
+  for (const char *c = type ? type : ""; *c; c++)
+    hash = (hash ^ (unsigned char)*c) * 1099511628211ull;
+  return hash;
+}
 
-      forces[source].x -= fx;
-      forces[source].y -= fy;
-      forces[target].x += fx;
-      forces[target].y += fy;
-    }
+static inline Uint64 object_key(const GraphNode *node) {
+  Uint64 key = node->address * 0x9E3779B97F4A7C15ull ^ type_hash(node->type);
+  return key ? key : 1;
+}
 
-    // Apply forces
-    for (int i = 0; i < graph->node_count; i++) {
-      float dx = forces[i].x;
-      float dy = forces[i].y;
-      float distance = sqrt(dx * dx + dy * dy);
-      if (distance > 0) {
-        float limiting_distance = fmin(distance, t);
-        graph->nodes[i].position.x += dx / distance * limiting_distance;
-        graph->nodes[i].position.y += dy / distance * limiting_distance;
-      }
+// Strings interned by intern_name(): names[id] for each id below count.
+typedef struct {
+  KeyTable ids; // By type_hash() of the name
+  const char **names;
+  int count;
+  int capacity;
+} NameTable;
+
+// Returns the id of name in table, adding it if it is new, or -1 when out of
+// memory.
+static inline int intern_name(NameTable *table, const char *name) {
+  // Probe on past hash collisions between different names
+  Uint64 key = type_hash(name);
+  int id;
+  while ((id = key_table_get(&table->ids, key ? key : 1)) >= 0 &&
+         strcmp(table->names[id], name))
+    key = key * 0x9E3779B97F4A7C15ull + 1;
+  if (id >= 0)
+    return id;
+  if (table->count == table->capacity) {
+    int capacity = table->capacity ? 2 * table->capacity : 64;
+    const char **grown =
+        realloc(table->names, capacity * sizeof(const char *));
+    if (!grown)
+      return -1;
+    table->names = grown;
+    if (!key_table_reserve(&table->ids, capacity))
+      return -1;
+    table->capacity = capacity;
+  }
+  key_table_put(&table->ids, key ? key : 1, table->count);
+  table->names[table->count] = name;
+  return table->count++;
+}
 
-      graph->nodes[i].position.x =
-          fmax(0, fmin(width, graph->nodes[i].position.x));
-      graph->nodes[i].position.y =
-          fmax(0, fmin(height, graph->nodes[i].position.y));
+// Interns the node types in one pass: each node gets a type_id indexing
+// graph->type_names, so grouping by type costs an array lookup per node
+// instead of a string comparison.
+static inline int ensure_type_ids(GraphData *graph) {
+  if (graph->types_valid)
+    return 1;
+  NameTable types = {0};
+  for (int i = 0; i < graph->node_count; i++) {
+    GraphNode *node = &graph->nodes[i];
+    node->type_id = node->type ? intern_name(&types, node->type) : -1;
+    if (node->type && node->type_id < 0) {
+      fprintf(stderr, "Failed to allocate memory for type ids\n");
+      free(types.names);
+      key_table_free(&types.ids);
+      return 0;
     }
-
-    t *= FORCE_COOLING_FACTOR;
   }
+  key_table_free(&types.ids);
+  free(graph->type_names);
+  graph->type_names = types.names;
+  graph->type_count = types.count;
+  graph->types_valid = 1;
+  return 1;
+}
 
-  free(forces);
+static inline int label_listed(char *const *labels, int count,
+                               const char *label) {
+  for (int i = 0; i < count; i++)
+    if (!strcmp(labels[i], label))
+      return 1;
+  return 0;
 }
 
-static inline void apply_fruchterman_reingold_layout(GraphData *graph) {
-  int width = 1000;
-  int height = 1000;
-  float area = width * height * LAYOUT_AREA_MULTIPLIER;
-  float k = sqrt(area / graph->node_count);
-  float t = FRUCHTERMAN_REINGOLD_INITIAL_TEMP;
+// Interns the edge labels like ensure_type_ids() and, when the graph has a
+// filter, rebuilds followed_edges from it whenever the labels or the filter
+// have changed. The filter is matched once per distinct label into a bitset
+// over label ids, which then marks the edges in one pass.
+static inline int ensure_edge_filter(GraphData *graph) {
+  int m = graph->edge_count;
+  if (!graph->edge_labels_valid) {
+    NameTable labels = {0};
+    for (int e = 0; e < m; e++) {
+      GraphEdge *edge = &graph->edges[e];
+      edge->label_id = intern_name(&labels, edge->label ? edge->label : "");
+      if (edge->label_id < 0) {
+        fprintf(stderr, "Failed to allocate memory for edge label ids\n");
+        free(labels.names);
+        key_table_free(&labels.ids);
+        return 0;
+      }
+    }
+    key_table_free(&labels.ids);
+    free(graph->edge_label_names);
+    graph->edge_label_names = labels.names;
+    graph->edge_label_count = labels.count;
+    graph->edge_labels_valid = 1;
+    free(graph->followed_edges);
+    graph->followed_edges = NULL;
+  }
+  const EdgeFilter *filter = graph->filter;
+  if (!filter || (graph->followed_edges &&
+                  graph->filter_version == filter->version))
+    return 1;
 
-  Vec2f *displacement = calloc(graph->node_count, sizeof(Vec2f));
-  if (!displacement) {
-    fprintf(stderr, "Failed to allocate memory for displacement calculation\n");
-    return;
+  int count = graph->edge_label_count;
+  Uint64 *followed_labels = calloc(count / 64 + 1, sizeof(Uint64));
+  Uint64 *followed_edges = calloc(m / 64 + 1, sizeof(Uint64));
+  if (!followed_labels || !followed_edges) {
+    fprintf(stderr, "Failed to allocate memory for the edge filter\n");
+    free(followed_labels);
+    free(followed_edges);
+    return 0;
   }
+  for (int id = 0; id < count; id++) {
+    const char *label = graph->edge_label_names[id];
+    if ((!filter->follow_count ||
+         label_listed(filter->follow, filter->follow_count, label)) &&
+        !label_listed(filter->skip, filter->skip_count, label))
+      followed_labels[id >> 6] |= 1ull << (id & 63);
+  }
+  for (int e = 0; e < m; e++) {
+    int id = graph->edges[e].label_id;
+    if (followed_labels[id >> 6] >> (id & 63) & 1)
+      followed_edges[e >> 6] |= 1ull << (e & 63);
+  }
+  free(followed_labels);
+  free(graph->followed_edges);
+  graph->followed_edges = followed_edges;
+  graph->filter_version = filter->version;
+  return 1;
+}
 
-  for (int iter = 0; iter < FORCE_ITERATIONS; iter++) {
-    memset(displacement, 0, graph->node_count * sizeof(Vec2f));
+// Whether traversals follow edge e. Valid after ensure_edge_index().
+static inline int edge_followed(const GraphData *graph, int e) {
+  return !graph->followed_edges ||
+         (graph->followed_edges[e >> 6] >> (e & 63) & 1);
+}
 
-    // Calculate repulsive forces
-    for (int i = 0; i < graph->node_count; i++) {
-      for (int j = 0; j < graph->node_count; j++) {
-        if (i != j) {
-          float dx = graph->nodes[i].position.x - graph->nodes[j].position.x;
-          float dy = graph->nodes[i].position.y - graph->nodes[j].position.y;
-          float distance = sqrt(dx * dx + dy * dy);
-          if (distance > 0) {
-            float repulsive_force = (k * k) / distance;
-            displacement[i].x += dx / distance * repulsive_force;
-            displacement[i].y += dy / distance * repulsive_force;
-          }
-        }
-      }
-    }
+// Name of a type slot; slot type_count collects the untyped nodes.
+static inline const char *type_name(const GraphData *graph, int slot) {
+  return slot < graph->type_count ? graph->type_names[slot] : "(untyped)";
+}
 
-    // Calculate attractive forces
-    for (int e = 0; e < graph->edge_count; e++) {
-      int i = graph->edges[e].source;
-      int j = graph->edges[e].target;
-      float dx = graph->nodes[i].position.x - graph->nodes[j].position.x;
-      float dy = graph->nodes[i].position.y - graph->nodes[j].position.y;
-      float distance = sqrt(dx * dx + dy * dy);
-      float attractive_force = distance * distance / k;
-      if (distance > 0) {
-        displacement[i].x -= dx / distance * attractive_force;
-        displacement[i].y -= dy / distance * attractive_force;
-        displacement[j].x += dx / distance * attractive_force;
-        displacement[j].y += dy / distance * attractive_force;
-      }
-    }
+static inline int type_slot(const GraphData *graph, const GraphNode *node) {
+  return node->type_id < 0 ? graph->type_count : node->type_id;
+}
 
-    // Apply displacement
-    for (int i = 0; i < graph->node_count; i++) {
-      float disp_length = sqrt(displacement[i].x * displacement[i].x +
-                               displacement[i].y * displacement[i].y);
-      if (disp_length > 0) {
-        float capped_disp_length = fmin(disp_length, t);
-        graph->nodes[i].position.x +=
-            displacement[i].x / disp_length * capped_disp_length;
-        graph->nodes[i].position.y +=
-            displacement[i].y / disp_length * capped_disp_length;
-      }
+static inline int same_object(const GraphNode *a, const GraphNode *b) {
+  return a->address == b->address &&
+         !strcmp(a->type ? a->type : "", b->type ? b->type : "");
+}
 
-      graph->nodes[i].position.x =
-          fmin((float)width / 2,
-               fmax(-(float)width / 2, graph->nodes[i].position.x));
-      graph->nodes[i].position.y =
-          fmin((float)height / 2,
-               fmax(-(float)height / 2, graph->nodes[i].position.y));
+// Matches the objects of two snapshots by address and type with a hash join
+// and returns their union: the nodes of `after`, marked retained or added,
+// followed by the nodes only `before` has, marked removed. Retained and
+// removed nodes keep their `before` position. Edges of `before` missing
+// from `after` are carried over between the matched nodes. Labels are
+// copied, so both inputs can be freed afterwards.
+static inline GraphData *diff_graphs(const GraphData *before,
+                                     const GraphData *after) {
+  GraphData *result = NULL;
+  KeyTable objects = {0}, after_edges = {0};
+  int *before_to_result = malloc((before->node_count + 1) * sizeof(int));
+  if (!before_to_result ||
+      !key_table_reserve(&objects, before->node_count) ||
+      !key_table_reserve(&after_edges, after->edge_count)) {
+    fprintf(stderr, "Failed to allocate memory for the diff\n");
+    goto done;
+  }
+
+  int addressed = 0;
+  for (int i = 0; i < before->node_count; i++) {
+    const GraphNode *node = &before->nodes[i];
+    before_to_result[i] = -1;
+    addressed += node->address != 0;
+    // Nodes a previous diff marked removed were not in this snapshot.
+    if (!node->removed && node->diff != DIFF_REMOVED)
+      key_table_put(&objects, object_key(node), i);
+  }
+  for (int i = 0; i < after->node_count; i++)
+    addressed += after->nodes[i].address != 0;
+  if (!addressed)
+    fprintf(stderr, "Neither graph has object addresses; regenerate them "
+                    "with objgraph.py to diff\n");
+
+  int retained = 0;
+  for (int i = 0; i < after->node_count; i++) {
+    int match = key_table_get(&objects, object_key(&after->nodes[i]));
+    if (match >= 0 && same_object(&before->nodes[match], &after->nodes[i])) {
+      before_to_result[match] = i;
+      retained++;
     }
+  }
 
-    t *= FRUCHTERMAN_REINGOLD_COOLING;
+  int node_count = after->node_count;
+  for (int i = 0; i < before->node_count; i++)
+    if (before_to_result[i] < 0 && !before->nodes[i].removed &&
+        before->nodes[i].diff != DIFF_REMOVED)
+      before_to_result[i] = node_count++;
+
+  for (int i = 0; i < after->edge_count; i++)
+    key_table_put(&after_edges,
+                  edge_key(after->edges[i].source, after->edges[i].target), 1);
+  int edge_count = after->edge_count;
+  for (int i = 0; i < before->edge_count; i++) {
+    int source = before_to_result[before->edges[i].source];
+    int target = before_to_result[before->edges[i].target];
+    if (source >= 0 && target >= 0 &&
+        key_table_get(&after_edges, edge_key(source, target)) < 0)
+      edge_count++;
   }
 
-  free(displacement);
-}
+  result = create_graph(node_count, edge_count);
+  if (!result)
+    goto done;
 
-static inline void update_node_visibility(AppState *app) {
-  app->visible_nodes_count = 0;
-  for (int i = 0; i < app->graph->node_count; i++) {
-    if (strlen(app->search_bar.text) == 0) {
-      app->graph->nodes[i].visible =
-          !app->filter_referenced || app->selected_nodes[i];
+  for (int i = 0; i < after->node_count; i++) {
+    GraphNode node = after->nodes[i];
+    node.id = i;
+    node.diff = DIFF_ADDED;
+    result->nodes[i] = node;
+  }
+  for (int i = 0; i < before->node_count; i++) {
+    int index = before_to_result[i];
+    if (index < 0)
+      continue;
+    if (index < after->node_count) {
+      result->nodes[index].diff = DIFF_RETAINED;
     } else {
-      char id_str[20];
-      snprintf(id_str, sizeof(id_str), "%d", app->graph->nodes[i].id);
-      app->graph->nodes[i].visible =
-          ((strstr(app->graph->nodes[i].label, app->search_bar.text) != NULL) ||
-           (strstr(id_str, app->search_bar.text) != NULL)) &&
-          (!app->filter_referenced || app->selected_nodes[i]);
-    }
-    if (app->graph->nodes[i].visible) {
-      app->visible_nodes_count++;
+      result->nodes[index] = before->nodes[i];
+      result->nodes[index].id = index;
+      result->nodes[index].diff = DIFF_REMOVED;
     }
+    result->nodes[index].position = before->nodes[i].position;
   }
-}
 
-static inline void cycle_selection_mode(AppState *app) {
-  app->selection_mode = (app->selection_mode + 1) % SELECT_MODE_COUNT;
-}
+  memcpy(result->edges, after->edges, after->edge_count * sizeof(GraphEdge));
+  for (int i = 0, e = after->edge_count; i < before->edge_count; i++) {
+    int source = before_to_result[before->edges[i].source];
+    int target = before_to_result[before->edges[i].target];
+    if (source >= 0 && target >= 0 &&
+        key_table_get(&after_edges, edge_key(source, target)) < 0)
+      result->edges[e++] =
+          (GraphEdge){source, target, before->edges[i].label, 0};
+  }
 
-static inline void select_references_recursive(AppState *app, int node_id) {
-  for (int i = 0; i < app->graph->edge_count; i++) {
-    if (app->graph->edges[i].source == node_id &&
-        !app->selected_nodes[app->graph->edges[i].target]) {
-      app->selected_nodes[app->graph->edges[i].target] = 1;
-      select_references_recursive(app, app->graph->edges[i].target);
+  // The labels still point into the inputs; give the result its own copies.
+  int copied = 1;
+  for (int i = 0; copied && i < node_count; i++) {
+    GraphNode *node = &result->nodes[i];
+    node->visible = 1;
+    node->label = store_label(result, node->label, strlen(node->label));
+    copied = node->label != NULL;
+    if (copied && node->type) {
+      node->type = store_label(result, node->type, strlen(node->type));
+      copied = node->type != NULL;
     }
   }
+  for (int i = 0; copied && i < edge_count; i++) {
+    GraphEdge *edge = &result->edges[i];
+    edge->label = store_label(result, edge->label, strlen(edge->label));
+    copied = edge->label != NULL;
+  }
+  if (!copied) {
+    fprintf(stderr, "Failed to allocate memory for the diff labels\n");
+    free_graph(result);
+    result = NULL;
+    goto done;
+  }
+
+  DEBUG_PRINT("Diff: %d retained, %d added, %d removed\n", retained,
+              after->node_count - retained, node_count - after->node_count);
+
+done:
+  key_table_free(&objects);
+  key_table_free(&after_edges);
+  free(before_to_result);
+  return result;
 }
 
-static inline void select_referenced_by_recursive(AppState *app, int node_id) {
-  for (int i = 0; i < app->graph->edge_count; i++) {
-    if (app->graph->edges[i].target == node_id &&
-        !app->selected_nodes[app->graph->edges[i].source]) {
-      app->selected_nodes[app->graph->edges[i].source] = 1;
-      select_referenced_by_recursive(app, app->graph->edges[i].source);
-    }
+// Builds the summary of full: a supernode for each group whose slot in
+// summary->expanded is 0, labelled with its member count, and the members of
+// expanded groups as themselves. Collapsed chains are drawn as one edge
+// instead of a supernode. Edges between the same two view nodes are merged
+// with a hash aggregation and labelled with how many references they stand
+// for. Sets summary->origins to the full node behind each view node, or
+// -1 - the group of a supernode, and summary->chain_edges.
+static inline GraphData *summarize_graph(GraphData *full,
+                                         GraphSummary *summary) {
+  GraphData *view = NULL;
+  int n = full->node_count;
+  int *view_of = malloc((n ? n : 1) * sizeof(int)); // Full node -> view node
+  int *origin = malloc((n ? n : 1) * sizeof(int));
+  int *chain_edges = NULL;
+  int *members = calloc(n ? n : 1, sizeof(int));
+  int *supernode = malloc((summary->group_count + 1) * sizeof(int));
+  int *sizes = calloc(summary->group_count + 1, sizeof(int));
+  int *placed = calloc(summary->group_count + 1, sizeof(int));
+  int *edge_counts = malloc((full->edge_count ? full->edge_count : 1) *
+                            sizeof(int));
+  int *first_edge = malloc((full->edge_count ? full->edge_count : 1) *
+                           sizeof(int));
+  KeyTable pairs = {0};
+  if (!view_of || !origin || !members || !supernode || !sizes || !placed ||
+      !edge_counts || !first_edge ||
+      !key_table_reserve(&pairs, full->edge_count)) {
+    fprintf(stderr, "Failed to allocate memory for the summary\n");
+    goto done;
   }
-}
 
-static inline void set_node_selection(AppState *app, int node_id) {
-  memset(app->selected_nodes, 0, app->graph->node_count * sizeof(int));
+  for (int g = 0; g < summary->group_count; g++)
+    supernode[g] = -1;
+  int node_count = 0;
+  for (int i = 0; i < n; i++) {
+    view_of[i] = -1;
+    if (full->nodes[i].removed)
+      continue;
+    int group = summary->groups[i];
+    sizes[group]++;
+    if (summary->expanded[group]) {
+      origin[node_count] = i;
+      view_of[i] = node_count++;
+      continue;
+    }
+    if (summary->kind == SUMMARY_CHAINS)
+      continue; // Drawn as an edge instead
+    if (supernode[group] < 0) {
+      origin[node_count] = -1 - group;
+      supernode[group] = node_count++;
+    }
+    view_of[i] = supernode[group];
+  }
 
-  switch (app->selection_mode) {
-  case SELECT_SINGLE:
-    app->selected_nodes[node_id] = 1;
-    break;
-  case SELECT_REFERENCES:
-    app->selected_nodes[node_id] = 1;
-    for (int i = 0; i < app->graph->edge_count; i++) {
-      if (app->graph->edges[i].source == node_id) {
-        app->selected_nodes[app->graph->edges[i].target] = 1;
-      }
+  int edge_count = 0;
+  for (int e = 0; e < full->edge_count; e++) {
+    int source = view_of[full->edges[e].source];
+    int target = view_of[full->edges[e].target];
+    if (source < 0 || target < 0)
+      continue;
+    Uint64 key = edge_key(source, target);
+    int k = key_table_get(&pairs, key);
+    if (k < 0) {
+      k = edge_count++;
+      key_table_put(&pairs, key, k);
+      edge_counts[k] = 0;
+      first_edge[k] = e;
     }
-    break;
-  case SELECT_REFERENCED_BY:
-    app->selected_nodes[node_id] = 1;
-    for (int i = 0; i < app->graph->edge_count; i++) {
-      if (app->graph->edges[i].target == node_id) {
-        app->selected_nodes[app->graph->edges[i].source] = 1;
+    edge_counts[k]++;
+  }
+  int chain_count = 0;
+  for (int g = 0; summary->kind == SUMMARY_CHAINS && g < summary->group_count;
+       g++)
+    if (!summary->expanded[g] && view_of[summary->chain_ends[2 * g]] >= 0 &&
+        view_of[summary->chain_ends[2 * g + 1]] >= 0)
+      chain_count++;
+
+  view = create_graph(node_count, edge_count + chain_count);
+  chain_edges = malloc((edge_count + chain_count + 1) * sizeof(int));
+  if (!view || !chain_edges)
+    goto fail;
+  for (int i = 0; i < n; i++) {
+    int v = view_of[i];
+    if (v < 0)
+      continue;
+    GraphNode *node = &view->nodes[v];
+    const GraphNode *source = &full->nodes[i];
+    int group = summary->groups[i];
+    if (origin[v] >= 0) {
+      *node = *source;
+      if (summary->positions && sizes[group] > 1) {
+        // Expanded components ring their place in the layered layout
+        float radius = sizes[group] * 2 * NODE_RADIUS / M_PI;
+        float angle = 2 * M_PI * placed[group]++ / sizes[group];
+        node->position.x = summary->positions[group].x + radius * cos(angle);
+        node->position.y = summary->positions[group].y + radius * sin(angle);
+      } else if (summary->positions) {
+        node->position = summary->positions[group];
       }
+    } else if (!members[v]) {
+      // Supernodes sit where their first member is, unless laid out
+      node->position = summary->positions ? summary->positions[group]
+                                          : source->position;
+      if (summary->kind == SUMMARY_TYPES)
+        node->type = source->type;
     }
-    break;
-  case SELECT_REFERENCES_RECURSIVE:
-    app->selected_nodes[node_id] = 1;
-    select_references_recursive(app, node_id);
-    break;
-  case SELECT_REFERENCED_BY_RECURSIVE:
-    app->selected_nodes[node_id] = 1;
-    select_referenced_by_recursive(app, node_id);
-    break;
-  case SELECT_MODE_COUNT:
-    printf("This should never happen.\n");
-    exit(1);
+    node->id = v;
+    node->visible = 1;
+    if (origin[v] < 0) {
+      node->size += source->size;
+      node->root |= source->root;
+    }
+    members[v]++;
   }
-  update_node_visibility(app);
-  app->left_scroll_position = 0; // Reset left menu scroll position
+
+  int copied = 1;
+  for (int v = 0; copied && v < node_count; v++) {
+    GraphNode *node = &view->nodes[v];
+    char label[MAX_LABEL_LENGTH];
+    if (origin[v] < 0 && summary->kind == SUMMARY_TYPES)
+      snprintf(label, sizeof(label), "%s (%d)",
+               type_name(full, -1 - origin[v]), members[v]);
+    else if (origin[v] < 0)
+      snprintf(label, sizeof(label), "Component %d (%d)", -1 - origin[v],
+               members[v]);
+    else
+      snprintf(label, sizeof(label), "%s", node->label);
+    node->label = store_label(view, label, strlen(label));
+    copied = node->label != NULL;
+    if (copied && node->type) {
+      node->type = store_label(view, node->type, strlen(node->type));
+      copied = node->type != NULL;
+    }
+  }
+  for (int k = 0; copied && k < edge_count; k++) {
+    const GraphEdge *source = &full->edges[first_edge[k]];
+    char label[64];
+    if (edge_counts[k] > 1)
+      snprintf(label, sizeof(label), "%d references", edge_counts[k]);
+    view->edges[k] = (GraphEdge){view_of[source->source],
+                                 view_of[source->target],
+                                 edge_counts[k] > 1
+                                     ? store_label(view, label, strlen(label))
+                                     : store_label(view, source->label,
+                                                   strlen(source->label)),
+                                 0};
+    copied = view->edges[k].label != NULL;
+    chain_edges[k] = -1;
+  }
+  for (int g = 0, k = edge_count; copied && k < edge_count + chain_count;
+       g++) {
+    int source = view_of[summary->chain_ends[2 * g]];
+    int target = view_of[summary->chain_ends[2 * g + 1]];
+    if (summary->expanded[g] || source < 0 || target < 0)
+      continue;
+    char label[64];
+    snprintf(label, sizeof(label), "chain of %d", sizes[g]);
+    view->edges[k] = (GraphEdge){
+        source, target, store_label(view, label, strlen(label)), 0};
+    copied = view->edges[k].label != NULL;
+    chain_edges[k++] = g;
+  }
+  if (!copied) {
+    fprintf(stderr, "Failed to allocate memory for the summary labels\n");
+    goto fail;
+  }
+
+  free(summary->origins);
+  summary->origins = origin;
+  origin = NULL;
+  free(summary->chain_edges);
+  summary->chain_edges = chain_edges;
+  chain_edges = NULL;
+  static const char *kind_names[] = {"Type", "Component", "Chain"};
+  DEBUG_PRINT("%s summary: %d nodes and %d edges for %d nodes and %d edges\n",
+              kind_names[summary->kind], node_count, edge_count + chain_count,
+              n, full->edge_count);
+  goto done;
+
+fail:
+  free_graph(view);
+  view = NULL;
+done:
+  free(view_of);
+  free(origin);
+  free(chain_edges);
+  free(members);
+  free(supernode);
+  free(sizes);
+  free(placed);
+  free(edge_counts);
+  free(first_edge);
+  key_table_free(&pairs);
+  return view;
 }
 
-static inline void set_edge_selection(AppState *app, int edge_id) {
-  memset(app->selected_nodes, 0, app->graph->node_count * sizeof(int));
-  app->selected_nodes[app->graph->edges[edge_id].source] = 1;
-  app->selected_nodes[app->graph->edges[edge_id].target] = 1;
-  update_node_visibility(app);
-  app->left_scroll_position = 0; // Reset left menu scroll position
+// Groups edge indices by source and by target with a counting sort.
+// Also brings the edge filter up to date, as every traversal needs both.
+static inline int ensure_edge_index(GraphData *graph) {
+  if (!ensure_edge_filter(graph))
+    return 0;
+  if (graph->edge_index_valid)
+    return 1;
+  int n = graph->node_count, m = graph->edge_count;
+  EdgeIndex *indices[2] = {&graph->out_edges, &graph->in_edges};
+  for (int side = 0; side < 2; side++) {
+    EdgeIndex *index = indices[side];
+    free(index->offsets);
+    free(index->edges);
+    free(index->nodes);
+    index->offsets = calloc(n + 1, sizeof(int));
+    index->edges = malloc((m ? m : 1) * sizeof(int));
+    index->nodes = malloc((m ? m : 1) * sizeof(int));
+    if (!index->offsets || !index->edges || !index->nodes) {
+      fprintf(stderr, "Failed to allocate memory for the edge index\n");
+      return 0;
+    }
+    for (int i = 0; i < m; i++) {
+      GraphEdge *edge = &graph->edges[i];
+      index->offsets[(side ? edge->target : edge->source) + 1]++;
+    }
+    for (int i = 0; i < n; i++)
+      index->offsets[i + 1] += index->offsets[i];
+    // Fill back to front, so each node's edges stay in edge order.
+    for (int i = m - 1; i >= 0; i--) {
+      GraphEdge *edge = &graph->edges[i];
+      int slot = --index->offsets[(side ? edge->target : edge->source) + 1];
+      index->edges[slot] = i;
+      index->nodes[slot] = side ? edge->source : edge->target;
+    }
+    // The decrements left offsets[i + 1] at the start of node i.
+    for (int i = 0; i < n; i++)
+      index->offsets[i] = index->offsets[i + 1];
+    index->offsets[n] = m;
+  }
+  graph->edge_index_valid = 1;
+  return 1;
 }
 
-static inline void render_label_background(SDL_Renderer *renderer, int x, int y,
-                                           int width, int height) {
-  SDL_Rect bg_rect = {x - 2, y - 2, width + 4, height + 4};
-  SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
-  SDL_RenderFillRect(renderer, &bg_rect);
+// Nodes objgraph flagged as roots, or node 0 when there are none. Returns
+// the number written to roots, which must hold node_count entries.
+static inline int graph_roots(const GraphData *graph, int *roots) {
+  int count = 0;
+  for (int i = 0; i < graph->node_count; i++)
+    if (graph->nodes[i].root && !graph->nodes[i].removed)
+      roots[count++] = i;
+  if (!count && graph->node_count && !graph->nodes[0].removed)
+    roots[count++] = 0;
+  return count;
 }
 
-static inline void render_hover_label(SDL_Renderer *renderer, AppState *app,
-                                      const char *label, int x, int y) {
-  if (label == NULL || strlen(label) == 0) {
-    return;
+// Numbers the strongly connected components of graph with an iterative
+// Tarjan search. They come out in reverse topological order: every edge
+// between two components points to the lower number. Removed nodes get -1.
+// Returns the number of components, or -1 on failure.
+static inline int compute_components(GraphData *graph, int *component) {
+  int n = graph->node_count;
+  int *number = malloc((n ? n : 1) * sizeof(int)); // Discovery order
+  int *low = malloc((n ? n : 1) * sizeof(int));
+  int *next = malloc((n ? n : 1) * sizeof(int)); // Next out edge to visit
+  int *stack = malloc((n ? n : 1) * sizeof(int)); // Tarjan's stack
+  int *calls = malloc((n ? n : 1) * sizeof(int)); // The DFS path
+  int count = -1;
+  if (!number || !low || !next || !stack || !calls ||
+      !ensure_edge_index(graph)) {
+    fprintf(stderr, "Failed to allocate memory for the components\n");
+    goto done;
   }
 
-  int max_width = 300;
-  SDL_Surface *text_surface = TTF_RenderText_Blended_Wrapped(
-      app->font_small, label, COLOR_WHITE, max_width);
-  if (!text_surface) {
-    fprintf(stderr, "Failed to render text: %s\n", TTF_GetError());
-    return;
+  const EdgeIndex *out = &graph->out_edges;
+  for (int i = 0; i < n; i++) {
+    component[i] = -1;
+    number[i] = -1;
   }
-
-  SDL_Texture *text_texture =
-      SDL_CreateTextureFromSurface(renderer, text_surface);
-  if (!text_texture) {
-    fprintf(stderr, "Failed to create texture: %s\n", SDL_GetError());
-    SDL_FreeSurface(text_surface);
-    return;
+  int counter = 0, top = 0;
+  count = 0;
+  for (int root = 0; root < n; root++) {
+    if (graph->nodes[root].removed || number[root] >= 0)
+      continue;
+    int depth = 0;
+    calls[depth++] = root;
+    number[root] = low[root] = counter++;
+    next[root] = out->offsets[root];
+    stack[top++] = root;
+    while (depth) {
+      int v = calls[depth - 1];
+      if (next[v] < out->offsets[v + 1]) {
+        int s = next[v]++;
+        int w = out->nodes[s];
+        if (graph->nodes[w].removed || !edge_followed(graph, out->edges[s]))
+          continue;
+        if (number[w] < 0) {
+          number[w] = low[w] = counter++;
+          next[w] = out->offsets[w];
+          stack[top++] = w;
+          calls[depth++] = w;
+        } else if (component[w] < 0 && number[w] < low[v]) {
+          low[v] = number[w]; // Still on the stack
+        }
+        continue;
+      }
+      if (--depth && low[v] < low[calls[depth - 1]])
+        low[calls[depth - 1]] = low[v];
+      if (low[v] == number[v]) {
+        int w;
+        do {
+          w = stack[--top];
+          component[w] = count;
+        } while (w != v);
+        count++;
+      }
+    }
   }
 
-  int text_width = text_surface->w;
-  int text_height = text_surface->h;
+done:
+  free(number);
+  free(low);
+  free(next);
+  free(stack);
+  free(calls);
+  return count;
+}
 
-  // Use cursor position (stored in app->mouse_position)
-  x = app->mouse_position.x;
-  y = app->mouse_position.y;
+// Lays out the condensation of graph in layers by topological depth: a
+// component sits one layer below the deepest component referring to it, and
+// each layer is centred on x = 0. component is as from compute_components().
+static inline Vec2f *layer_components(GraphData *graph, const int *component,
+                                      int count) {
+  int n = graph->node_count;
+  int *offsets = calloc(count + 1, sizeof(int));
+  int *members = malloc((n ? n : 1) * sizeof(int));
+  int *depth = calloc(count ? count : 1, sizeof(int));
+  int *layer_sizes = calloc(count + 1, sizeof(int));
+  Vec2f *positions = malloc((count ? count : 1) * sizeof(Vec2f));
+  if (!offsets || !members || !depth || !layer_sizes || !positions) {
+    fprintf(stderr, "Failed to allocate memory for the condensation layout\n");
+    free(positions);
+    positions = NULL;
+    goto done;
+  }
 
-  // Adjust position to keep label on screen
-  if (x + text_width > app->window_width) {
-    x = app->window_width - text_width - 5;
+  // Members grouped by component with a counting sort
+  for (int i = 0; i < n; i++)
+    if (component[i] >= 0)
+      offsets[component[i] + 1]++;
+  for (int c = 0; c < count; c++)
+    offsets[c + 1] += offsets[c];
+  for (int i = 0; i < n; i++)
+    if (component[i] >= 0)
+      members[offsets[component[i]]++] = i;
+  for (int c = count; c > 0; c--)
+    offsets[c] = offsets[c - 1];
+  offsets[0] = 0;
+
+  // Edges point to lower numbers, so the highest numbers come first in
+  // topological order and each depth is final before it is propagated.
+  const EdgeIndex *out = &graph->out_edges;
+  int layer_count = 0;
+  for (int c = count - 1; c >= 0; c--) {
+    for (int k = offsets[c]; k < offsets[c + 1]; k++) {
+      int v = members[k];
+      for (int e = out->offsets[v]; e < out->offsets[v + 1]; e++) {
+        int d = component[out->nodes[e]];
+        if (!edge_followed(graph, out->edges[e]))
+          continue;
+        if (d >= 0 && d != c && depth[d] < depth[c] + 1)
+          depth[d] = depth[c] + 1;
+      }
+    }
+    if (depth[c] + 1 > layer_count)
+      layer_count = depth[c] + 1;
   }
-  if (y + text_height > app->window_height) {
-    y = app->window_height - text_height - 5;
+  for (int c = 0; c < count; c++)
+    layer_sizes[depth[c]]++;
+  int *ranks = offsets; // Reused: components placed so far in each layer
+  memset(ranks, 0, (count + 1) * sizeof(int));
+  for (int c = count - 1; c >= 0; c--) {
+    int d = depth[c];
+    positions[c].x = (ranks[d]++ - (layer_sizes[d] - 1) / 2.0f) *
+                     COMPONENT_SPACING;
+    positions[c].y = d * COMPONENT_LAYER_SPACING;
   }
-
-  render_label_background(renderer, x, y, text_width, text_height);
-
-  SDL_Rect text_rect = {x, y, text_width, text_height};
-  SDL_RenderCopy(renderer, text_texture, NULL, &text_rect);
-
-  SDL_FreeSurface(text_surface);
-  SDL_DestroyTexture(text_texture);
+  DEBUG_PRINT("Condensation: %d components in %d layers\n", count, layer_count);
+
+done:
+  free(offsets);
+  free(members);
+  free(depth);
+  free(layer_sizes);
+  return positions;
 }
 
-static inline void render_graph(SDL_Renderer *renderer, AppState *app) {
-  int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
-  int graph_width = GRAPH_WIDTH(app->window_width);
-
-  // First pass: Render non-highlighted edges
-  for (int i = 0; i < app->graph->edge_count; i++) {
-    GraphNode *source = &app->graph->nodes[app->graph->edges[i].source];
-    GraphNode *target = &app->graph->nodes[app->graph->edges[i].target];
-
-    if (!source->visible || !target->visible)
+// Finds the maximal chains of at least MIN_CHAIN_LENGTH nodes with exactly
+// one reference in and one out, and numbers them in groups; other nodes get
+// group count. ends receives, per chain, the nodes before and after it.
+// Rings made only of such nodes are left alone. Every edge counts, followed
+// or not, so compressing never hides one. Returns the number of chains, or
+// -1 on failure.
+static inline int find_chains(GraphData *graph, int *groups, int *ends) {
+  if (!ensure_edge_index(graph))
+    return -1;
+  const EdgeIndex *out = &graph->out_edges, *in = &graph->in_edges;
+  int n = graph->node_count;
+#define CHAIN_LINK(v)                                                          \
+  (!graph->nodes[v].removed && !graph->nodes[v].root &&                        \
+   out->offsets[v + 1] - out->offsets[v] == 1 &&                               \
+   in->offsets[v + 1] - in->offsets[v] == 1 &&                                 \
+   out->nodes[out->offsets[v]] != (v))
+  int count = 0;
+  for (int v = 0; v < n; v++)
+    groups[v] = -1;
+  for (int v = 0; v < n; v++) {
+    if (groups[v] >= 0 || !CHAIN_LINK(v))
       continue;
+    int before = in->nodes[in->offsets[v]];
+    if (CHAIN_LINK(before))
+      continue; // Not the start of the chain
+    int length = 1, last = v;
+    while (CHAIN_LINK(out->nodes[out->offsets[last]])) {
+      last = out->nodes[out->offsets[last]];
+      length++;
+    }
+    if (length < MIN_CHAIN_LENGTH)
+      continue;
+    for (int w = v;; w = out->nodes[out->offsets[w]]) {
+      groups[w] = count;
+      if (w == last)
+        break;
+    }
+    ends[2 * count] = before;
+    ends[2 * count + 1] = out->nodes[out->offsets[last]];
+    count++;
+  }
+#undef CHAIN_LINK
+  for (int v = 0; v < n; v++)
+    if (groups[v] < 0)
+      groups[v] = count;
+  return count;
+}
 
-    int both_selected = app->selected_nodes[app->graph->edges[i].source] &&
-                        app->selected_nodes[app->graph->edges[i].target];
-
-    if (both_selected)
-      continue; // Skip highlighted edges in this pass
-
-    float x1 =
-        (source->position.x + app->camera.position.x) * app->camera.zoom +
-        left_menu_width + (float)graph_width / 2;
-    float y1 =
-        (source->position.y + app->camera.position.y) * app->camera.zoom +
-        (float)app->window_height / 2;
-    float x2 =
-        (target->position.x + app->camera.position.x) * app->camera.zoom +
-        left_menu_width + (float)graph_width / 2;
-    float y2 =
-        (target->position.y + app->camera.position.y) * app->camera.zoom +
-        (float)app->window_height / 2;
+typedef struct {
+  Uint64 retained;
+  int id;
+} RetainedEntry;
 
-    float angle = atan2(y2 - y1, x2 - x1);
-    float circle_radius = 5 * app->camera.zoom;
-    float x2_adj = x2 - circle_radius * cos(angle);
-    float y2_adj = y2 - circle_radius * sin(angle);
+static inline int compare_retained(const void *a, const void *b) {
+  const RetainedEntry *x = a, *y = b;
+  if (x->retained != y->retained)
+    return x->retained < y->retained ? 1 : -1;
+  return x->id - y->id;
+}
 
-    lineRGBA(renderer, x1, y1, x2_adj, y2_adj, 200, 200, 200, 255);
+// Builds the dominator tree of everything reachable from the roots with the
+// iterative algorithm of Cooper, Harvey and Kennedy, then sums sizes up the
+// tree: a node's retained size is what would be freed if it went away.
+// Without sizes from objgraph every node counts as 1. Unreachable nodes
+// retain nothing.
+static inline int compute_retained_sizes(GraphData *graph) {
+  if (graph->retained_valid)
+    return 1;
+  if (!ensure_edge_index(graph))
+    return 0;
+
+  Uint32 start = SDL_GetTicks();
+  int n = graph->node_count;
+  int root = n; // Virtual root above every real one
+  int *roots = malloc((n ? n : 1) * sizeof(int));
+  int *postorder = malloc((n + 1) * sizeof(int)); // Node ids, finish order
+  int *number = malloc((n + 1) * sizeof(int));    // Node -> postorder index
+  int *stack = malloc((n + 1) * sizeof(int));
+  int *next = malloc((n + 1) * sizeof(int)); // Next out edge to explore
+  int *pred_offsets = NULL, *preds = NULL, *doms = NULL;
+  Uint64 *retained = NULL;
+  RetainedEntry *entries = malloc((n ? n : 1) * sizeof(RetainedEntry));
+  int *order = malloc((n ? n : 1) * sizeof(int));
+  int ok = roots && postorder && number && stack && next && entries && order;
+  if (!ok) {
+    fprintf(stderr, "Failed to allocate memory for the dominator tree\n");
+    free(order);
+    goto done;
+  }
 
-    float arrow_size = 10 * app->camera.zoom;
-    float x3 = x2_adj - arrow_size * cos(angle - M_PI / 12);
-    float y3 = y2_adj - arrow_size * sin(angle - M_PI / 12);
-    float x4 = x2_adj - arrow_size * cos(angle + M_PI / 12);
-    float y4 = y2_adj - arrow_size * sin(angle + M_PI / 12);
+  int root_count = graph_roots(graph, roots);
+  int has_sizes = 0;
+  for (int i = 0; i < n && !has_sizes; i++)
+    has_sizes = graph->nodes[i].size != 0;
+  for (int i = 0; i <= n; i++)
+    number[i] = -1;
+
+  // Iterative depth-first search for the postorder. The virtual root's
+  // children are the roots; everyone else's are their out edges.
+  // Removed nodes have no edges left and are never roots.
+  const int *out_offsets = graph->out_edges.offsets;
+  const int *out = graph->out_edges.nodes;
+  const int *out_edges = graph->out_edges.edges;
+  int count = 0, depth = 0;
+  stack[depth++] = root;
+  next[root] = 0;
+  number[root] = 0; // Marks it visited; renumbered when it finishes
+  while (depth) {
+    int v = stack[depth - 1];
+    int child = -1;
+    if (v == root) {
+      while (next[v] < root_count && child < 0) {
+        int r = roots[next[v]++];
+        if (number[r] < 0)
+          child = r;
+      }
+    } else {
+      while (next[v] < out_offsets[v + 1] && child < 0) {
+        int s = next[v]++;
+        if (number[out[s]] < 0 && edge_followed(graph, out_edges[s]))
+          child = out[s];
+      }
+    }
+    if (child >= 0) {
+      number[child] = 0;
+      next[child] = out_offsets[child];
+      stack[depth++] = child;
+    } else {
+      depth--;
+      number[v] = count;
+      postorder[count++] = v;
+    }
+  }
 
-    filledTrigonRGBA(renderer, x2_adj, y2_adj, x3, y3, x4, y4, 200, 200, 200,
-                     255);
+  // From here on nodes are named by their postorder number, which puts
+  // the virtual root at count - 1 and every dominator above the nodes it
+  // dominates. Predecessor lists are rebuilt in those terms once, so the
+  // passes below touch only small sequential arrays. Roots get the virtual
+  // root as an extra predecessor.
+  const int *in_offsets = graph->in_edges.offsets;
+  const int *in = graph->in_edges.nodes;
+  pred_offsets = malloc((count + 1) * sizeof(int));
+  doms = malloc(count * sizeof(int));
+  retained = malloc(count * sizeof(Uint64));
+  size_t pred_count = root_count;
+  for (int k = 0; k < count - 1; k++) {
+    int v = postorder[k];
+    pred_count += in_offsets[v + 1] - in_offsets[v];
+  }
+  preds = malloc((pred_count ? pred_count : 1) * sizeof(int));
+  if (!pred_offsets || !doms || !retained || !preds) {
+    fprintf(stderr, "Failed to allocate memory for the dominator tree\n");
+    ok = 0;
+    free(order);
+    goto done;
+  }
+  for (int i = 0; i < root_count; i++)
+    next[roots[i]] = -2;
+  pred_count = 0;
+  for (int k = 0; k < count - 1; k++) {
+    int v = postorder[k];
+    pred_offsets[k] = pred_count;
+    if (next[v] == -2)
+      preds[pred_count++] = count - 1;
+    for (int e = in_offsets[v]; e < in_offsets[v + 1]; e++) {
+      int p = number[in[e]];
+      if (p >= 0 && edge_followed(graph, graph->in_edges.edges[e]))
+        preds[pred_count++] = p;
+    }
+  }
+  pred_offsets[count - 1] = pred_offsets[count] = pred_count;
+
+  for (int k = 0; k < count; k++)
+    doms[k] = -1;
+  doms[count - 1] = count - 1;
+  int changed = 1, passes = 0;
+  while (changed) {
+    changed = 0;
+    passes++;
+    for (int k = count - 2; k >= 0; k--) {
+      int new_idom = -1;
+      for (int e = pred_offsets[k]; e < pred_offsets[k + 1]; e++) {
+        int a = preds[e];
+        if (doms[a] < 0)
+          continue; // Not processed yet
+        if (new_idom < 0) {
+          new_idom = a;
+          continue;
+        }
+        int b = new_idom;
+        while (a != b) {
+          while (a < b)
+            a = doms[a];
+          while (b < a)
+            b = doms[b];
+        }
+        new_idom = a;
+      }
+      if (doms[k] != new_idom) {
+        doms[k] = new_idom;
+        changed = 1;
+      }
+    }
   }
 
-  // Second pass: Render non-highlighted nodes
-  for (int i = 0; i < app->graph->node_count; i++) {
-    if (!app->graph->nodes[i].visible || app->selected_nodes[i])
-      continue;
+  // Dominators come later in postorder, so one pass sums every subtree.
+  for (int k = 0; k < count - 1; k++) {
+    const GraphNode *node = &graph->nodes[postorder[k]];
+    retained[k] = has_sizes ? node->size : 1;
+  }
+  retained[count - 1] = 0;
+  for (int k = 0; k < count - 1; k++)
+    retained[doms[k]] += retained[k];
+  for (int i = 0; i < n; i++)
+    graph->nodes[i].retained = 0;
+  for (int k = 0; k < count - 1; k++)
+    graph->nodes[postorder[k]].retained = retained[k];
+
+  for (int i = 0; i < n; i++)
+    entries[i] = (RetainedEntry){graph->nodes[i].retained, i};
+  qsort(entries, n, sizeof(RetainedEntry), compare_retained);
+  for (int i = 0; i < n; i++)
+    order[i] = entries[i].id;
+  free(graph->retained_order);
+  graph->retained_order = order;
+  graph->retained_valid = 1;
+  DEBUG_PRINT("Dominator tree: %d of %d nodes reachable from %d roots, "
+              "%d passes, %u ms\n",
+              count - 1, n, root_count, passes, SDL_GetTicks() - start);
+
+done:
+  free(roots);
+  free(postorder);
+  free(number);
+  free(stack);
+  free(next);
+  free(entries);
+  free(pred_offsets);
+  free(preds);
+  free(doms);
+  free(retained);
+  return ok;
+}
 
-    int x = (app->graph->nodes[i].position.x + app->camera.position.x) *
-                app->camera.zoom +
-            left_menu_width + (float)graph_width / 2;
-    int y = (app->graph->nodes[i].position.y + app->camera.position.y) *
-                app->camera.zoom +
-            (float)app->window_height / 2;
+// One thread's share of a breadth-first level: the out edges of
+// frontier[begin, end). Targets are claimed with an atomic OR on the visited
+// bitset, so each lands in the next level exactly once.
+typedef struct {
+  const GraphData *graph;
+  Uint64 *visited;
+  const int *frontier;
+  int begin;
+  int end;
+  int *next;
+  int *next_count;
+} ReachShare;
+
+static int expand_reach_share(void *data) {
+  ReachShare *share = data;
+  const int *offsets = share->graph->out_edges.offsets;
+  const int *targets = share->graph->out_edges.nodes;
+  const int *edges = share->graph->out_edges.edges;
+  for (int i = share->begin; i < share->end; i++) {
+    int v = share->frontier[i];
+    for (int s = offsets[v]; s < offsets[v + 1]; s++) {
+      if (!edge_followed(share->graph, edges[s]))
+        continue;
+      int w = targets[s];
+      Uint64 bit = 1ull << (w & 63);
+      if (__atomic_load_n(&share->visited[w >> 6], __ATOMIC_RELAXED) & bit)
+        continue;
+      if (__atomic_fetch_or(&share->visited[w >> 6], bit, __ATOMIC_RELAXED) &
+          bit)
+        continue;
+      share->next[__atomic_fetch_add(share->next_count, 1, __ATOMIC_RELAXED)] =
+          w;
+    }
+  }
+  return 0;
+}
 
-    filledCircleRGBA(renderer, x, y, 5 * app->camera.zoom, 0, 0, 255, 255);
+// Returns a bitset of the nodes reachable from the roots, or NULL. Levels
+// wide enough to pay for it are split across threads; most heaps have a
+// handful of very wide levels and a long tail of narrow ones.
+static inline Uint64 *reachable_from_roots(GraphData *graph) {
+  if (!ensure_edge_index(graph))
+    return NULL;
+  int n = graph->node_count;
+  Uint64 *visited = calloc((n + 63) / 64 + 1, sizeof(Uint64));
+  int *frontier = malloc((n ? n : 1) * sizeof(int));
+  int *next = malloc((n ? n : 1) * sizeof(int));
+  if (!visited || !frontier || !next) {
+    fprintf(stderr, "Failed to allocate memory for reachability\n");
+    free(visited);
+    visited = NULL;
+    goto done;
   }
 
-  // Third pass: Render highlighted edges
-  for (int i = 0; i < app->graph->edge_count; i++) {
-    GraphNode *source = &app->graph->nodes[app->graph->edges[i].source];
-    GraphNode *target = &app->graph->nodes[app->graph->edges[i].target];
+  int threads = SDL_GetCPUCount();
+  threads = threads < 1 ? 1 : threads > REACH_MAX_THREADS ? REACH_MAX_THREADS
+                                                            : threads;
+  int count = graph_roots(graph, frontier);
+  for (int i = 0; i < count; i++)
+    visited[frontier[i] >> 6] |= 1ull << (frontier[i] & 63);
+
+  while (count) {
+    int next_count = 0;
+    int parts = count < REACH_PARALLEL_FRONTIER ? 1 : threads;
+    ReachShare shares[REACH_MAX_THREADS];
+    SDL_Thread *workers[REACH_MAX_THREADS] = {NULL};
+    for (int t = 0; t < parts; t++) {
+      shares[t] = (ReachShare){graph,
+                               visited,
+                               frontier,
+                               (int)((Sint64)count * t / parts),
+                               (int)((Sint64)count * (t + 1) / parts),
+                               next,
+                               &next_count};
+      // The calling thread takes the first share itself
+      if (t > 0)
+        workers[t] = SDL_CreateThread(expand_reach_share, "reach", &shares[t]);
+    }
+    expand_reach_share(&shares[0]);
+    for (int t = 1; t < parts; t++) {
+      if (workers[t])
+        SDL_WaitThread(workers[t], NULL);
+      else
+        expand_reach_share(&shares[t]);
+    }
+    int *swap = frontier;
+    frontier = next;
+    next = swap;
+    count = next_count;
+  }
 
-    if (!source->visible || !target->visible)
-      continue;
+done:
+  free(frontier);
+  free(next);
+  return visited;
+}
 
-    int both_selected = app->selected_nodes[app->graph->edges[i].source] &&
-                        app->selected_nodes[app->graph->edges[i].target];
+static inline void apply_force_directed_layout(GraphData *graph) {
+  float width = sqrt(LAYOUT_AREA_MULTIPLIER * graph->node_count);
+  float height = width;
+  float area = width * height;
+  float k = sqrt(area / graph->node_count);
+  float t = width / 10;
 
-    if (!both_selected)
-      continue; // Skip non-highlighted edges in this pass
+  Vec2f *forces = calloc(graph->node_count, sizeof(Vec2f));
+  if (!forces) {
+    fprintf(stderr, "Failed to allocate memory for force calculation\n");
+    return;
+  }
 
-    float x1 =
-        (source->position.x + app->camera.position.x) * app->camera.zoom +
-        left_menu_width + (float)graph_width / 2;
-    float y1 =
-        (source->position.y + app->camera.position.y) * app->camera.zoom +
-        (float)app->window_height / 2;
-    float x2 =
-        (target->position.x + app->camera.position.x) * app->camera.zoom +
-        left_menu_width + (float)graph_width / 2;
-    float y2 =
-        (target->position.y + app->camera.position.y) * app->camera.zoom +
-        (float)app->window_height / 2;
+  for (int iter = 0; iter < FORCE_ITERATIONS; iter++) {
+    memset(forces, 0, graph->node_count * sizeof(Vec2f));
 
-    float angle = atan2(y2 - y1, x2 - x1);
-    float circle_radius = 5 * app->camera.zoom;
-    float x2_adj = x2 - circle_radius * cos(angle);
-    float y2_adj = y2 - circle_radius * sin(angle);
+    // Calculate repulsive forces
+    for (int i = 0; i < graph->node_count; i++) {
+      for (int j = i + 1; j < graph->node_count; j++) {
+        float dx = graph->nodes[i].position.x - graph->nodes[j].position.x;
+        float dy = graph->nodes[i].position.y - graph->nodes[j].position.y;
+        float distance = sqrt(dx * dx + dy * dy);
+        if (distance == 0)
+          distance = 0.01;
 
-    lineRGBA(renderer, x1, y1, x2_adj, y2_adj, 255, 0, 0, 255);
+        float force = k * k / distance;
+        float fx = dx / distance * force;
+        float fy = dy / distance * force;
 
-    float arrow_size = 10 * app->camera.zoom;
-    float x3 = x2_adj - arrow_size * cos(angle - M_PI / 12);
-    float y3 = y2_adj - arrow_size * sin(angle - M_PI / 12);
-    float x4 = x2_adj - arrow_size * cos(angle + M_PI / 12);
-    float y4 = y2_adj - arrow_size * sin(angle + M_PI / 12);
+        forces[i].x += fx;
+        forces[i].y += fy;
+        forces[j].x -= fx;
+        forces[j].y -= fy;
+      }
+    }
 
-    filledTrigonRGBA(renderer, x2_adj, y2_adj, x3, y3, x4, y4, 255, 0, 0, 255);
-  }
+    // Calculate attractive forces
+    for (int i = 0; i < graph->edge_count; i++) {
+      int source = graph->edges[i].source;
+      int target = graph->edges[i].target;
+      float dx =
+          graph->nodes[source].position.x - graph->nodes[target].position.x;
+      float dy =
+          graph->nodes[source].position.y - graph->nodes[target].position.y;
+      float distance = sqrt(dx * dx + dy * dy);
+      if (distance == 0)
+        distance = 0.01;
 
-  // Fourth pass: Render highlighted nodes
-  for (int i = 0; i < app->graph->node_count; i++) {
-    if (!app->graph->nodes[i].visible || !app->selected_nodes[i])
-      continue;
+      float force = (distance * distance) / k;
+      float fx = dx / distance * force;
+      float fy = dy / distance * force;
 
-    int x = (app->graph->nodes[i].position.x + app->camera.position.x) *
-                app->camera.zoom +
-            left_menu_width + (float)graph_width / 2;
-    int y = (app->graph->nodes[i].position.y + app->camera.position.y) *
-                app->camera.zoom +
-            (float)app->window_height / 2;
+      forces[source].x -= fx;
+      forces[source].y -= fy;
+      forces[target].x += fx;
+      forces[target].y += fy;
+    }
 
-    filledCircleRGBA(renderer, x, y, 5 * app->camera.zoom, 255, 0, 0, 255);
-  }
+    // Apply forces
+    for (int i = 0; i < graph->node_count; i++) {
+      float dx = forces[i].x;
+      float dy = forces[i].y;
+      float distance = sqrt(dx * dx + dy * dy);
+      if (distance > 0) {
+        float limiting_distance = fmin(distance, t);
+        graph->nodes[i].position.x += dx / distance * limiting_distance;
+        graph->nodes[i].position.y += dy / distance * limiting_distance;
+      }
 
-  // Final pass: Render hover labels
-  if (app->hovered_node != -1) {
-    int x = (app->graph->nodes[app->hovered_node].position.x +
-             app->camera.position.x) *
-                app->camera.zoom +
-            left_menu_width + (float)graph_width / 2;
-    int y = (app->graph->nodes[app->hovered_node].position.y +
-             app->camera.position.y) *
-                app->camera.zoom +
-            (float)app->window_height / 2;
-    render_hover_label(renderer, app,
-                       app->graph->nodes[app->hovered_node].label, x + 10,
-                       y - 20);
-  } else if (app->hovered_edge != -1) {
-    GraphNode *source =
-        &app->graph->nodes[app->graph->edges[app->hovered_edge].source];
-    GraphNode *target =
-        &app->graph->nodes[app->graph->edges[app->hovered_edge].target];
-
-    float x1 =
-        (source->position.x + app->camera.position.x) * app->camera.zoom +
-        left_menu_width + (float)graph_width / 2;
-    float y1 =
-        (source->position.y + app->camera.position.y) * app->camera.zoom +
-        (float)app->window_height / 2;
-    float x2 =
-        (target->position.x + app->camera.position.x) * app->camera.zoom +
-        left_menu_width + (float)graph_width / 2;
-    float y2 =
-        (target->position.y + app->camera.position.y) * app->camera.zoom +
-        (float)app->window_height / 2;
-
-    int label_x = (x1 + x2) / 2;
-    int label_y = (y1 + y2) / 2;
-    render_hover_label(renderer, app,
-                       app->graph->edges[app->hovered_edge].label, label_x,
-                       label_y);
+      graph->nodes[i].position.x =
+          fmax(0, fmin(width, graph->nodes[i].position.x));
+      graph->nodes[i].position.y =
+          fmax(0, fmin(height, graph->nodes[i].position.y));
+    }
+
+    t *= FORCE_COOLING_FACTOR;
   }
-}
 
-static inline void render_label(SDL_Renderer *renderer, const char *text, int x,
-                                int y, TTF_Font *font, SDL_Color color,
-                                int max_width) {
-  SDL_Surface *surface = TTF_RenderText_Solid(font, text, color);
-  SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+  free(forces);
+  invalidate_layout(graph);
+}
 
-  SDL_Rect rect;
-  rect.x = x;
-  rect.y = y;
-  SDL_QueryTexture(texture, NULL, NULL, &rect.w, &rect.h);
+static inline void apply_fruchterman_reingold_layout(GraphData *graph) {
+  int width = 1000;
+  int height = 1000;
+  float area = width * height * LAYOUT_AREA_MULTIPLIER;
+  float k = sqrt(area / graph->node_count);
+  float t = FRUCHTERMAN_REINGOLD_INITIAL_TEMP;
 
-  if (rect.w > max_width) {
-    SDL_Rect src_rect = {0, 0, max_width, rect.h};
-    rect.w = max_width;
-    SDL_RenderCopy(renderer, texture, &src_rect, &rect);
-  } else {
-    SDL_RenderCopy(renderer, texture, NULL, &rect);
+  Vec2f *displacement = calloc(graph->node_count, sizeof(Vec2f));
+  if (!displacement) {
+    fprintf(stderr, "Failed to allocate memory for displacement calculation\n");
+    return;
   }
 
-  SDL_FreeSurface(surface);
-  SDL_DestroyTexture(texture);
-}
+  for (int iter = 0; iter < FORCE_ITERATIONS; iter++) {
+    memset(displacement, 0, graph->node_count * sizeof(Vec2f));
 
-static inline SDL_Rect render_scrollbar(SDL_Renderer *renderer, int x, int y,
-                                        int width, int height, int total_items,
-                                        int visible_items,
-                                        int scroll_position) {
-  int content_height = total_items * 20; // Assuming each item is 20 pixels high
-  float visible_ratio = (float)height / content_height;
-  int scrollbar_height = (int)(visible_ratio * height);
-  scrollbar_height = (scrollbar_height < 20)
-                         ? 20
-                         : scrollbar_height; // Minimum scrollbar height
+    // Calculate repulsive forces
+    for (int i = 0; i < graph->node_count; i++) {
+      for (int j = 0; j < graph->node_count; j++) {
+        if (i != j) {
+          float dx = graph->nodes[i].position.x - graph->nodes[j].position.x;
+          float dy = graph->nodes[i].position.y - graph->nodes[j].position.y;
+          float distance = sqrt(dx * dx + dy * dy);
+          if (distance > 0) {
+            float repulsive_force = (k * k) / distance;
+            displacement[i].x += dx / distance * repulsive_force;
+            displacement[i].y += dy / distance * repulsive_force;
+          }
+        }
+      }
+    }
 
-  int max_scroll = content_height - height;
-  float scroll_ratio =
-      (max_scroll > 0) ? (float)scroll_position / max_scroll : 0;
-  int scrollbar_y = y + (int)(scroll_ratio * (height - scrollbar_height));
+    // Calculate attractive forces
+    for (int e = 0; e < graph->edge_count; e++) {
+      int i = graph->edges[e].source;
+      int j = graph->edges[e].target;
+      float dx = graph->nodes[i].position.x - graph->nodes[j].position.x;
+      float dy = graph->nodes[i].position.y - graph->nodes[j].position.y;
+      float distance = sqrt(dx * dx + dy * dy);
+      float attractive_force = distance * distance / k;
+      if (distance > 0) {
+        displacement[i].x -= dx / distance * attractive_force;
+        displacement[i].y -= dy / distance * attractive_force;
+        displacement[j].x += dx / distance * attractive_force;
+        displacement[j].y += dy / distance * attractive_force;
+      }
+    }
 
-  SDL_Rect scrollbar_bg = {x, y, width, height};
-  if (renderer) {
-    SDL_SetRenderDrawColor(renderer, 70, 70, 70, 255);
-    SDL_RenderFillRect(renderer, &scrollbar_bg);
+    // Apply displacement
+    for (int i = 0; i < graph->node_count; i++) {
+      float disp_length = sqrt(displacement[i].x * displacement[i].x +
+                               displacement[i].y * displacement[i].y);
+      if (disp_length > 0) {
+        float capped_disp_length = fmin(disp_length, t);
+        graph->nodes[i].position.x +=
+            displacement[i].x / disp_length * capped_disp_length;
+        graph->nodes[i].position.y +=
+            displacement[i].y / disp_length * capped_disp_length;
+      }
 
-    SDL_Rect scrollbar_handle = {x, scrollbar_y, width, scrollbar_height};
-    SDL_SetRenderDrawColor(renderer, 150, 150, 150, 255);
-    SDL_RenderFillRect(renderer, &scrollbar_handle);
+      graph->nodes[i].position.x =
+          fmin((float)width / 2,
+               fmax(-(float)width / 2, graph->nodes[i].position.x));
+      graph->nodes[i].position.y =
+          fmin((float)height / 2,
+               fmax(-(float)height / 2, graph->nodes[i].position.y));
+    }
+
+    t *= FRUCHTERMAN_REINGOLD_COOLING;
   }
 
-  return scrollbar_bg; // Return the entire scrollbar area
+  free(displacement);
+  invalidate_layout(graph);
 }
 
-static inline void handle_menu_scroll(int *scroll_position, int scroll_amount,
-                                      int total_items, int visible_items,
-                                      int item_height) {
-  int max_scroll = fmax(0, (total_items - visible_items) * item_height);
-  *scroll_position =
-      fmax(0, fmin(*scroll_position - scroll_amount, max_scroll));
+static inline void invalidate_layout(GraphData *graph) {
+  graph->edge_directions_valid = 0;
+  graph->layout_version++;
+}
 
-  // Ensure we don't scroll past the end of the content
-  if (*scroll_position > max_scroll) {
-    *scroll_position = max_scroll;
+// Caches the normalized direction of every edge. The camera transform is a
+// uniform scale plus a translation, so the world-space direction is also the
+// screen-space direction and only changes when node positions do.
+static inline void update_edge_directions(GraphData *graph) {
+  if (graph->edge_directions_valid)
+    return;
+
+  if (!graph->edge_directions && graph->edge_count) {
+    graph->edge_directions = malloc(graph->edge_capacity * sizeof(Vec2f));
+    if (!graph->edge_directions) {
+      fprintf(stderr, "Failed to allocate memory for edge directions\n");
+      return;
+    }
+  }
+
+  GraphNode *nodes = graph->nodes;
+  GraphEdge *edges = graph->edges;
+  float *out = (float *)graph->edge_directions;
+  int i = 0;
+
+#if defined(__SSE2__)
+  __m128 zero = _mm_setzero_ps();
+  __m128 one = _mm_set1_ps(1.0f);
+  for (; i + 4 <= graph->edge_count; i += 4) {
+    float dx[4], dy[4];
+    for (int k = 0; k < 4; k++) {
+      dx[k] = nodes[edges[i + k].target].position.x -
+              nodes[edges[i + k].source].position.x;
+      dy[k] = nodes[edges[i + k].target].position.y -
+              nodes[edges[i + k].source].position.y;
+    }
+    __m128 vx = _mm_loadu_ps(dx);
+    __m128 vy = _mm_loadu_ps(dy);
+    __m128 len =
+        _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)));
+    // Zero-length edges point along +x, matching atan2(0, 0) == 0.
+    __m128 degenerate = _mm_cmpeq_ps(len, zero);
+    len = _mm_or_ps(_mm_andnot_ps(degenerate, len), _mm_and_ps(degenerate, one));
+    vx = _mm_or_ps(_mm_andnot_ps(degenerate, _mm_div_ps(vx, len)),
+                   _mm_and_ps(degenerate, one));
+    vy = _mm_andnot_ps(degenerate, _mm_div_ps(vy, len));
+    _mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(vx, vy));
+    _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(vx, vy));
+  }
+#endif
+
+  for (; i < graph->edge_count; i++) {
+    float dx = nodes[edges[i].target].position.x -
+               nodes[edges[i].source].position.x;
+    float dy = nodes[edges[i].target].position.y -
+               nodes[edges[i].source].position.y;
+    float len = sqrtf(dx * dx + dy * dy);
+    out[2 * i] = len > 0 ? dx / len : 1.0f;
+    out[2 * i + 1] = len > 0 ? dy / len : 0.0f;
   }
+
+  graph->edge_directions_valid = 1;
 }
 
-static inline int is_mouse_over_menu_item(int mouseX, int mouseY, int itemY,
-                                          int menuX, int menuWidth,
-                                          int itemHeight) {
-  return mouseX >= menuX && mouseX <= menuX + menuWidth && mouseY >= itemY &&
-         mouseY < itemY + itemHeight;
+// Direction of edge i, from the cache when update_edge_directions managed to
+// fill it and computed on the spot otherwise.
+static inline Vec2f edge_direction(const GraphData *graph, int i) {
+  if (graph->edge_directions_valid)
+    return graph->edge_directions[i];
+
+  const GraphEdge *edge = &graph->edges[i];
+  float dx = graph->nodes[edge->target].position.x -
+             graph->nodes[edge->source].position.x;
+  float dy = graph->nodes[edge->target].position.y -
+             graph->nodes[edge->source].position.y;
+  float len = sqrtf(dx * dx + dy * dy);
+  if (len > 0)
+    return (Vec2f){dx / len, dy / len};
+  return (Vec2f){1.0f, 0.0f};
 }
 
-static inline void render_menu_item(SDL_Renderer *renderer, const char *text,
-                                    int x, int y, int width, int height,
-                                    SDL_Color bg_color, SDL_Color text_color,
-                                    TTF_Font *font) {
-  SDL_Rect bg_rect = {x, y, width, height};
-  SDL_SetRenderDrawColor(renderer, bg_color.r, bg_color.g, bg_color.b,
-                         bg_color.a);
-  SDL_RenderFillRect(renderer, &bg_rect);
-  render_label(renderer, text, x + 5, y + (height - TTF_FontHeight(font)) / 2,
-               font, text_color, width - 10);
+static inline void update_node_visibility(AppState *app) {
+  app->visible_nodes_count = 0;
+  for (int i = 0; i < app->graph->node_count; i++) {
+    if (app->graph->nodes[i].removed) {
+      app->graph->nodes[i].visible = 0;
+      continue;
+    }
+    if (strlen(app->search_bar.text) == 0) {
+      app->graph->nodes[i].visible =
+          !app->filter_referenced || app->selected_nodes[i];
+    } else {
+      char id_str[20];
+      snprintf(id_str, sizeof(id_str), "%d", app->graph->nodes[i].id);
+      app->graph->nodes[i].visible =
+          ((strstr(app->graph->nodes[i].label, app->search_bar.text) != NULL) ||
+           (strstr(id_str, app->search_bar.text) != NULL)) &&
+          (!app->filter_referenced || app->selected_nodes[i]);
+    }
+    if (app->graph->nodes[i].visible) {
+      app->visible_nodes_count++;
+    }
+  }
+  app->types.valid = 0;
+  invalidate_graph_layer(app);
 }
 
-static inline void render_left_menu(SDL_Renderer *renderer, AppState *app) {
+// Transforms every node position into screen space once per frame:
+//   screen = (position + camera.position) * zoom + offset
+// Rendering and hit-testing read the result instead of redoing the math.
+// All nodes are transformed, visible or not, so the loop stays branch-free.
+static inline void update_screen_positions(AppState *app) {
   int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
-  int detail_area_height = app->window_height * 0.4;
-  int scrollbar_width = 15;
-  int title_height = 50;
-  int padding = 10;
-  int button_height = 30;
+  int graph_width = GRAPH_WIDTH(app->window_width);
+  float zoom = app->camera.zoom;
+  float bias_x = app->camera.position.x * zoom + left_menu_width +
+                 (float)graph_width / 2;
+  float bias_y =
+      app->camera.position.y * zoom + (float)app->window_height / 2;
+
+  GraphNode *nodes = app->graph->nodes;
+  float *out = (float *)app->screen_positions;
+  int n = app->graph->node_count;
+  int i = 0;
+
+#if defined(__AVX__)
+  __m256 zoom8 = _mm256_set1_ps(zoom);
+  __m256 bias8 = _mm256_setr_ps(bias_x, bias_y, bias_x, bias_y, bias_x,
+                                bias_y, bias_x, bias_y);
+  for (; i + 4 <= n; i += 4) {
+    __m128 lo = _mm_loadh_pi(
+        _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)&nodes[i].position),
+        (const __m64 *)&nodes[i + 1].position);
+    __m128 hi = _mm_loadh_pi(
+        _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)&nodes[i + 2].position),
+        (const __m64 *)&nodes[i + 3].position);
+    __m256 pos = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+    _mm256_storeu_ps(out + 2 * i,
+                     _mm256_add_ps(_mm256_mul_ps(pos, zoom8), bias8));
+  }
+#elif defined(__SSE2__)
+  __m128 zoom4 = _mm_set1_ps(zoom);
+  __m128 bias4 = _mm_setr_ps(bias_x, bias_y, bias_x, bias_y);
+  for (; i + 2 <= n; i += 2) {
+    __m128 pos = _mm_loadh_pi(
+        _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)&nodes[i].position),
+        (const __m64 *)&nodes[i + 1].position);
+    _mm_storeu_ps(out + 2 * i, _mm_add_ps(_mm_mul_ps(pos, zoom4), bias4));
+  }
+#endif
 
-  // Render left menu background
-  SDL_Rect left_menu_rect = {0, 0, left_menu_width, app->window_height};
-  SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
-  SDL_RenderFillRect(renderer, &left_menu_rect);
+  for (; i < n; i++) {
+    out[2 * i] = nodes[i].position.x * zoom + bias_x;
+    out[2 * i + 1] = nodes[i].position.y * zoom + bias_y;
+  }
+}
 
-  // Render mode button
-  SDL_Rect mode_button_rect = {10, 10, left_menu_width - 20, button_height};
-  SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
-  SDL_RenderFillRect(renderer, &mode_button_rect);
+// Replaces the label of a node with the full one from the graph's resolver,
+// asking at most once per node.
+static inline void resolve_full_label(GraphData *graph, int node_id) {
+  if (!graph->resolver.resolve || node_id < 0 ||
+      node_id >= graph->node_count || graph->nodes[node_id].label_resolved)
+    return;
+  GraphNode *node = &graph->nodes[node_id];
+  node->label_resolved = 1;
+  char *full = graph->resolver.resolve(graph->resolver.context, node_id);
+  if (!full)
+    return;
+  const char *label = store_label(graph, full, strlen(full));
+  if (label)
+    node->label = label;
+  free(full);
+}
 
-  const char *mode_names[] = {
-      "Single",
-      "References",
-      "Referenced By",
-      "References (Recursive)",
-      "Referenced By (Recursive)",
-  };
-  char mode_text[50];
-  snprintf(mode_text, sizeof(mode_text), "Mode: %s",
-           mode_names[app->selection_mode]);
-  render_label(renderer, mode_text, 15, 15, app->font_small, COLOR_WHITE,
-               left_menu_width - 30);
+static inline void cycle_selection_mode(AppState *app) {
+  app->selection_mode = (app->selection_mode + 1) % SELECT_MODE_COUNT;
+}
 
-  // Render filter referenced button
-  SDL_Rect filter_button_rect = {10, 50, left_menu_width - 20, button_height};
-  SDL_SetRenderDrawColor(renderer, app->filter_referenced ? 150 : 100, 100, 100,
-                         255);
-  SDL_RenderFillRect(renderer, &filter_button_rect);
-  render_label(renderer, "Show only selected", 15, 55, app->font_small,
-               COLOR_WHITE, left_menu_width - 30);
+// Selects node_id and its neighbours over the followed edges of index.
+static inline void select_neighbors(AppState *app, int node_id,
+                                    const EdgeIndex *index) {
+  GraphData *graph = app->graph;
+  app->selected_nodes[node_id] = 1;
+  if (!ensure_edge_index(graph)) {
+    fprintf(stderr, "Failed to allocate memory for the selection\n");
+    return;
+  }
+  for (int s = index->offsets[node_id]; s < index->offsets[node_id + 1]; s++)
+    if (edge_followed(graph, index->edges[s]))
+      app->selected_nodes[index->nodes[s]] = 1;
+}
 
-  // Render detail area
-  SDL_Rect detail_rect = {0, app->window_height - detail_area_height,
-                          left_menu_width, detail_area_height};
-  SDL_SetRenderDrawColor(renderer, 70, 70, 70, 255);
-  SDL_RenderFillRect(renderer, &detail_rect);
+// Selects node_id and everything it reaches breadth first over the followed
+// edges of index: the out edges for what it references, the in edges for
+// what refers to it.
+static inline void select_recursive(AppState *app, int node_id,
+                                    const EdgeIndex *index) {
+  GraphData *graph = app->graph;
+  int *queue = malloc(graph->node_count * sizeof(int));
+  app->selected_nodes[node_id] = 1;
+  if (!queue || !ensure_edge_index(graph)) {
+    fprintf(stderr, "Failed to allocate memory for the recursive selection\n");
+    free(queue);
+    return;
+  }
+  int head = 0, tail = 0;
+  queue[tail++] = node_id;
+  while (head < tail) {
+    int v = queue[head++];
+    for (int s = index->offsets[v]; s < index->offsets[v + 1]; s++) {
+      int w = index->nodes[s];
+      if (!app->selected_nodes[w] && edge_followed(graph, index->edges[s])) {
+        app->selected_nodes[w] = 1;
+        queue[tail++] = w;
+      }
+    }
+  }
+  free(queue);
+}
 
-  // Render "Selected Objects" title
-  SDL_Rect title_bg = {0, app->window_height - detail_area_height,
-                       left_menu_width, title_height};
-  SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
-  SDL_RenderFillRect(renderer, &title_bg);
-  render_label(renderer, "Selected Objects", padding,
-               app->window_height - detail_area_height + padding,
-               app->font_small, COLOR_WHITE, left_menu_width - 2 * padding);
+// Selects the shortest chain of references from any root to node_id. The
+// search runs backwards from the node over the in edges, so it stops at
+// the nearest root instead of exploring everything the roots reach.
+static inline void select_path_to_root(AppState *app, int node_id) {
+  GraphData *graph = app->graph;
+  int n = graph->node_count;
+  int *via = malloc(n * sizeof(int)); // Edge towards node_id, or -1
+  int *queue = malloc(n * sizeof(int));
+  char *is_root = calloc(n, 1);
+  int *path = realloc(app->path, n * sizeof(int));
+  if (path)
+    app->path = path;
+  int *path_edges = realloc(app->path_edges, n * sizeof(int));
+  if (path_edges)
+    app->path_edges = path_edges;
+  if (!via || !queue || !is_root || !path || !path_edges ||
+      !ensure_edge_index(graph)) {
+    fprintf(stderr, "Failed to allocate memory for the path to root\n");
+    app->selected_nodes[node_id] = 1;
+    goto done;
+  }
 
-  // Render selected nodes details
-  int y_offset = app->window_height - detail_area_height + title_height;
-  int total_content_height = 0;
-  int selected_count = 0;
-  int item_height = 20;
+  int root_count = graph_roots(graph, queue);
+  for (int i = 0; i < root_count; i++)
+    is_root[queue[i]] = 1;
+  for (int i = 0; i < n; i++)
+    via[i] = -1;
+
+  const int *offsets = graph->in_edges.offsets;
+  const int *in_edges = graph->in_edges.edges;
+  const int *sources = graph->in_edges.nodes;
+  int head = 0, tail = 0, found = -1;
+  via[node_id] = -2;
+  queue[tail++] = node_id;
+  while (head < tail && found < 0) {
+    int v = queue[head++];
+    if (is_root[v]) {
+      found = v;
+      break;
+    }
+    for (int e = offsets[v]; e < offsets[v + 1]; e++) {
+      int u = sources[e];
+      if (via[u] == -1 && edge_followed(graph, in_edges[e])) {
+        via[u] = in_edges[e];
+        queue[tail++] = u;
+      }
+    }
+  }
 
-  for (int i = 0; i < app->graph->node_count; i++) {
-    if (app->selected_nodes[i] && app->graph->nodes[i].visible) {
-      selected_count++;
-      char detail_text[MAX_LABEL_LENGTH * 2];
-      snprintf(detail_text, sizeof(detail_text), "%d: %s",
-               app->graph->nodes[i].id, app->graph->nodes[i].label);
+  if (found < 0) {
+    DEBUG_PRINT("No root reaches node %d\n", node_id);
+    app->selected_nodes[node_id] = 1;
+    goto done;
+  }
+  int length = 0;
+  for (int v = found;; v = graph->edges[via[v]].target) {
+    app->path[length++] = v;
+    app->selected_nodes[v] = 1;
+    if (via[v] == -2)
+      break;
+    app->path_edges[length - 1] = via[v];
+  }
+  app->path_length = length;
 
-      SDL_Surface *text_surface = TTF_RenderText_Blended_Wrapped(
-          app->font_small, detail_text, COLOR_WHITE,
-          left_menu_width - 2 * padding - scrollbar_width);
-      total_content_height += text_surface->h + padding;
-      SDL_FreeSurface(text_surface);
-    }
+done:
+  free(via);
+  free(queue);
+  free(is_root);
+}
+
+// Residual arc k of node v in the unit-capacity flow network: its out edges
+// first, then its in edges. A followed out edge can be used while it carries
+// no flow, an in edge while it does (sending that flow back). Returns the edge
+// and stores the node at the far end, or returns -1 if the arc is saturated.
+static inline int residual_arc(const GraphData *graph, const char *flow, int v,
+                               int k, int *w) {
+  int out_degree = graph->out_edges.offsets[v + 1] - graph->out_edges.offsets[v];
+  if (k < out_degree) {
+    int slot = graph->out_edges.offsets[v] + k;
+    int e = graph->out_edges.edges[slot];
+    *w = graph->out_edges.nodes[slot];
+    return flow[e] || !edge_followed(graph, e) ? -1 : e;
   }
+  int slot = graph->in_edges.offsets[v] + k - out_degree;
+  *w = graph->in_edges.nodes[slot];
+  return flow[graph->in_edges.edges[slot]] ? graph->in_edges.edges[slot] : -1;
+}
 
-  // Render scrollbar
-  int scroll_area_height = detail_area_height - title_height;
-  render_scrollbar(renderer, left_menu_width - scrollbar_width, y_offset,
-                   scrollbar_width, scroll_area_height, selected_count,
-                   scroll_area_height / item_height, app->left_scroll_position);
+// Selects node_id and the holders of the fewest references whose removal
+// would leave it unreachable from every root. Every edge has capacity 1 and
+// the roots act as one source, so Dinic's algorithm finds the maximum flow
+// in O(E sqrt(E)). Of the minimum cuts, the one nearest the node is
+// reported: the last references on the way, which are usually the ones
+// worth dropping.
+static inline void select_min_cut(AppState *app, int node_id) {
+  GraphData *graph = app->graph;
+  int n = graph->node_count;
+  int m = graph->edge_count;
+  Uint32 start = SDL_GetTicks();
+  char *flow = calloc(m ? m : 1, 1);
+  int *level = malloc(n * sizeof(int)); // BFS depth, -1 once a dead end
+  int *next = malloc(n * sizeof(int));  // First residual arc not yet tried
+  int *queue = malloc(n * sizeof(int));
+  int *roots = malloc(n * sizeof(int));
+  int *stack = malloc(n * sizeof(int)); // Edges of the path being advanced
+  int *cut = realloc(app->cut_edges, (m ? m : 1) * sizeof(int));
+  if (cut)
+    app->cut_edges = cut;
+  app->selected_nodes[node_id] = 1;
+  if (!flow || !level || !next || !queue || !roots || !stack || !cut ||
+      !ensure_edge_index(graph)) {
+    fprintf(stderr, "Failed to allocate memory for the minimum cut\n");
+    goto done;
+  }
 
-  // Render visible content
-  SDL_Rect content_area = {0, y_offset, left_menu_width - scrollbar_width,
-                           scroll_area_height};
-  SDL_RenderSetViewport(renderer, &content_area);
+  int root_count = graph_roots(graph, roots);
+  for (int i = 0; i < root_count; i++) {
+    if (roots[i] == node_id) {
+      DEBUG_PRINT("Node %d is a root\n", node_id);
+      goto done;
+    }
+  }
 
-  y_offset = -app->left_scroll_position;
-  for (int i = 0; i < app->graph->node_count; i++) {
-    if (app->selected_nodes[i] && app->graph->nodes[i].visible) {
-      char detail_text[MAX_LABEL_LENGTH * 2];
-      snprintf(detail_text, sizeof(detail_text), "%d: %s",
-               app->graph->nodes[i].id, app->graph->nodes[i].label);
+  int flow_value = 0;
+  for (;;) {
+    // Level graph over the residual arcs, breadth first from the roots
+    int head = 0, tail = 0;
+    for (int i = 0; i < n; i++)
+      level[i] = -1;
+    for (int i = 0; i < root_count; i++) {
+      level[roots[i]] = 0;
+      queue[tail++] = roots[i];
+    }
+    while (head < tail && level[node_id] < 0) {
+      int v = queue[head++];
+      int degree = graph->out_edges.offsets[v + 1] -
+                   graph->out_edges.offsets[v] + graph->in_edges.offsets[v + 1] -
+                   graph->in_edges.offsets[v];
+      for (int k = 0; k < degree; k++) {
+        int w;
+        if (residual_arc(graph, flow, v, k, &w) >= 0 && level[w] < 0) {
+          level[w] = level[v] + 1;
+          queue[tail++] = w;
+        }
+      }
+    }
+    if (level[node_id] < 0)
+      break;
 
-      // Calculate available width for text
-      int available_width = content_area.w - 10; // Subtract padding
+    // Blocking flow: advance along arcs one level deeper, retreat from dead
+    // ends, and flip the path's edges whenever it reaches the node.
+    for (int i = 0; i < n; i++)
+      next[i] = 0;
+    for (int i = 0; i < root_count; i++) {
+      int depth = 0, v = roots[i];
+      while (level[roots[i]] >= 0) {
+        if (v == node_id) {
+          for (int k = 0; k < depth; k++)
+            flow[stack[k]] ^= 1;
+          flow_value++;
+          depth = 0;
+          v = roots[i];
+          continue;
+        }
+        int degree = graph->out_edges.offsets[v + 1] -
+                     graph->out_edges.offsets[v] +
+                     graph->in_edges.offsets[v + 1] - graph->in_edges.offsets[v];
+        int e = -1, w = -1;
+        for (; next[v] < degree; next[v]++) {
+          e = residual_arc(graph, flow, v, next[v], &w);
+          if (e >= 0 && level[w] == level[v] + 1)
+            break;
+        }
+        if (next[v] < degree) {
+          stack[depth++] = e;
+          v = w;
+          continue;
+        }
+        level[v] = -1;
+        if (depth == 0)
+          break;
+        // Step back over the last edge; it ran backwards if it carries flow
+        e = stack[--depth];
+        v = flow[e] ? graph->edges[e].target : graph->edges[e].source;
+        next[v]++;
+      }
+    }
+  }
 
-      // Truncate the text if it's too long
-      char truncated_text[MAX_LABEL_LENGTH * 2];
-      int max_chars = available_width / (TTF_FontHeight(app->font_small) /
-                                         2); // More accurate estimate
-      if ((int)strlen(detail_text) > max_chars) {
-        strncpy(truncated_text, detail_text, max_chars);
-        truncated_text[max_chars] = '\0';
-      } else {
-        strcpy(truncated_text, detail_text);
+  if (flow_value == 0) {
+    DEBUG_PRINT("No root reaches node %d\n", node_id);
+    goto done;
+  }
+
+  // The nodes that can still reach node_id through residual arcs form the
+  // sink side. Walk the arcs backwards from the node to find them.
+  int head = 0, tail = 0;
+  for (int i = 0; i < n; i++)
+    level[i] = 0;
+  level[node_id] = 1;
+  queue[tail++] = node_id;
+  while (head < tail) {
+    int w = queue[head++];
+    for (int s = graph->in_edges.offsets[w]; s < graph->in_edges.offsets[w + 1];
+         s++) {
+      int u = graph->in_edges.nodes[s];
+      int e = graph->in_edges.edges[s];
+      if (!flow[e] && edge_followed(graph, e) && !level[u]) {
+        level[u] = 1;
+        queue[tail++] = u;
       }
+    }
+    for (int s = graph->out_edges.offsets[w];
+         s < graph->out_edges.offsets[w + 1]; s++) {
+      int u = graph->out_edges.nodes[s];
+      if (flow[graph->out_edges.edges[s]] && !level[u]) {
+        level[u] = 1;
+        queue[tail++] = u;
+      }
+    }
+  }
 
-      SDL_Color bg_color =
-          (selected_count % 2 == 0) ? COLOR_MENU_ITEM_1 : COLOR_MENU_ITEM_2;
-      render_menu_item(renderer, truncated_text, 0, y_offset, content_area.w,
-                       item_height, bg_color, COLOR_WHITE, app->font_small);
+  int length = 0;
+  for (int e = 0; e < m; e++) {
+    if (!level[graph->edges[e].source] && level[graph->edges[e].target] &&
+        edge_followed(graph, e)) {
+      app->cut_edges[length++] = e;
+      app->selected_nodes[graph->edges[e].source] = 1;
+    }
+  }
+  app->cut_length = length;
+  app->cut_node = node_id;
+  DEBUG_PRINT("Minimum cut: %d references separate node %d from %d roots, "
+              "%u ms\n",
+              length, node_id, root_count, SDL_GetTicks() - start);
+
+done:
+  free(flow);
+  free(level);
+  free(next);
+  free(queue);
+  free(roots);
+  free(stack);
+}
 
-      y_offset += item_height;
-      selected_count++;
+static inline void stop_cycle_search(CycleSearch *search) {
+  free(search->distance);
+  free(search->on_path);
+  free(search->path);
+  free(search->path_edges);
+  free(search->next);
+  free(search->cycle_edges);
+  free(search->cycle_starts);
+  memset(search, 0, sizeof(CycleSearch));
+  search->node = -1;
+}
+
+// Starts enumerating the cycles through node_id. Only the nodes that can
+// get back to it are worth entering, and those found by walking forward
+// from it make up its SCC, so one backwards breadth-first search bounds the
+// whole enumeration to the SCC. Its distances also let each pass prune any
+// branch that cannot close within the pass's length.
+static inline void start_cycle_search(AppState *app, int node_id) {
+  GraphData *graph = app->graph;
+  CycleSearch *search = &app->cycles;
+  int n = graph->node_count;
+  stop_cycle_search(search);
+  search->distance = malloc(n * sizeof(int));
+  search->on_path = calloc(n, 1);
+  search->path = malloc((MAX_CYCLE_LENGTH + 1) * sizeof(int));
+  search->path_edges = malloc((MAX_CYCLE_LENGTH + 1) * sizeof(int));
+  search->next = malloc((MAX_CYCLE_LENGTH + 1) * sizeof(int));
+  search->cycle_starts = malloc((MAX_CYCLES + 1) * sizeof(int));
+  int *queue = malloc(n * sizeof(int));
+  if (!search->distance || !search->on_path || !search->path ||
+      !search->path_edges || !search->next || !search->cycle_starts ||
+      !queue || !ensure_edge_index(graph)) {
+    fprintf(stderr, "Failed to allocate memory for the cycle search\n");
+    stop_cycle_search(search);
+    free(queue);
+    return;
+  }
+
+  for (int i = 0; i < n; i++)
+    search->distance[i] = -1;
+  int head = 0, tail = 0;
+  search->distance[node_id] = 0;
+  queue[tail++] = node_id;
+  while (head < tail) {
+    int v = queue[head++];
+    for (int s = graph->in_edges.offsets[v]; s < graph->in_edges.offsets[v + 1];
+         s++) {
+      int u = graph->in_edges.nodes[s];
+      if (search->distance[u] < 0 &&
+          edge_followed(graph, graph->in_edges.edges[s])) {
+        search->distance[u] = search->distance[v] + 1;
+        queue[tail++] = u;
+      }
     }
   }
+  free(queue);
+
+  search->node = node_id;
+  search->bound = 1;
+  search->path[0] = node_id;
+  search->next[0] = graph->out_edges.offsets[node_id];
+  search->on_path[node_id] = 1;
+  search->cycle_starts[0] = 0;
+}
 
-  SDL_RenderSetViewport(renderer, NULL);
+// Appends the current path, closed by edge, as a cycle and selects it.
+static inline int record_cycle(AppState *app, int edge) {
+  CycleSearch *search = &app->cycles;
+  int start = search->cycle_starts[search->cycle_count];
+  if (start + search->bound > search->cycle_edges_capacity) {
+    int capacity = search->cycle_edges_capacity
+                       ? 2 * search->cycle_edges_capacity
+                       : 64 * MAX_CYCLE_LENGTH;
+    int *cycle_edges = realloc(search->cycle_edges, capacity * sizeof(int));
+    if (!cycle_edges) {
+      fprintf(stderr, "Failed to allocate memory for cycles\n");
+      return 0;
+    }
+    search->cycle_edges = cycle_edges;
+    search->cycle_edges_capacity = capacity;
+  }
+  for (int d = 0; d < search->depth; d++) {
+    search->cycle_edges[start + d] = search->path_edges[d];
+    app->selected_nodes[search->path[d + 1]] = 1;
+  }
+  search->cycle_edges[start + search->depth] = edge;
+  search->cycle_starts[++search->cycle_count] = start + search->depth + 1;
+  return 1;
 }
 
-static inline void render_right_menu(SDL_Renderer *renderer, AppState *app) {
-  int right_menu_width = RIGHT_MENU_WIDTH(app->window_width);
-  int right_menu_x = app->window_width - right_menu_width;
-  int scrollbar_width = 15;
-  int search_icon_size = SEARCH_BAR_HEIGHT;
+// Runs the cycle search for about budget_ms. Each pass is a depth-first
+// search from the node that only enters nodes still able to close a cycle
+// of exactly the pass's length, so the cycles come out shortest first and
+// the search stops at MAX_CYCLE_LENGTH or after MAX_CYCLES cycles.
+static inline void advance_cycle_search(AppState *app, Uint32 budget_ms) {
+  CycleSearch *search = &app->cycles;
+  if (search->node < 0 || search->done)
+    return;
+  const int *offsets = app->graph->out_edges.offsets;
+  const int *edges = app->graph->out_edges.edges;
+  const int *targets = app->graph->out_edges.nodes;
+  Uint32 start = SDL_GetTicks();
+  int found = 0;
+
+  for (unsigned steps = 1;; steps++) {
+    if (!(steps & 1023) && SDL_GetTicks() - start >= budget_ms)
+      break;
+    int d = search->depth;
+    int v = search->path[d];
+    if (search->next[d] < offsets[v + 1]) {
+      int s = search->next[d]++;
+      int w = targets[s];
+      if (!edge_followed(app->graph, edges[s]))
+        continue;
+      if (w == search->node) {
+        if (d + 1 == search->bound && record_cycle(app, edges[s])) {
+          found = 1;
+          if (search->cycle_count == MAX_CYCLES) {
+            search->done = 1;
+            break;
+          }
+        }
+        continue;
+      }
+      if (search->on_path[w] || search->distance[w] < 0 ||
+          d + 1 + search->distance[w] > search->bound)
+        continue;
+      search->path_edges[d] = edges[s];
+      search->depth = ++d;
+      search->path[d] = w;
+      search->next[d] = offsets[w];
+      search->on_path[w] = 1;
+      continue;
+    }
+    if (d > 0) {
+      search->on_path[v] = 0;
+      search->depth--;
+      continue;
+    }
+    if (search->bound == MAX_CYCLE_LENGTH) {
+      search->done = 1;
+      break;
+    }
+    search->bound++;
+    search->next[0] = offsets[search->node];
+  }
 
-  // Render right menu background
-  SDL_Rect menu_rect = {right_menu_x, 0, right_menu_width, app->window_height};
-  SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
-  SDL_RenderFillRect(renderer, &menu_rect);
+  if (found)
+    update_node_visibility(app);
+  if (search->done)
+    DEBUG_PRINT("Found %d cycles of up to %d references through node %d\n",
+                search->cycle_count, search->bound, search->node);
+}
 
-  // Render search box
-  SDL_Rect search_rect = {right_menu_x + 5, 5,
-                          right_menu_width - 10 - search_icon_size,
-                          SEARCH_BAR_HEIGHT};
-  SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-  SDL_RenderFillRect(renderer, &search_rect);
+static inline void set_node_selection(AppState *app, int node_id) {
+  memset(app->selected_nodes, 0, app->graph->node_count * sizeof(int));
+  app->path_length = 0;
+  app->cut_length = 0;
+  stop_cycle_search(&app->cycles);
+  resolve_full_label(app->graph, node_id);
 
-  render_label(renderer, app->search_bar.text, right_menu_x + 10, 10,
-               app->font_small, COLOR_BLACK,
-               right_menu_width - 20 - search_icon_size);
+  switch (app->selection_mode) {
+  case SELECT_SINGLE:
+    app->selected_nodes[node_id] = 1;
+    break;
+  case SELECT_REFERENCES:
+    select_neighbors(app, node_id, &app->graph->out_edges);
+    break;
+  case SELECT_REFERENCED_BY:
+    select_neighbors(app, node_id, &app->graph->in_edges);
+    break;
+  case SELECT_REFERENCES_RECURSIVE:
+    select_recursive(app, node_id, &app->graph->out_edges);
+    break;
+  case SELECT_REFERENCED_BY_RECURSIVE:
+    select_recursive(app, node_id, &app->graph->in_edges);
+    break;
+  case SELECT_PATH_TO_ROOT:
+    select_path_to_root(app, node_id);
+    break;
+  case SELECT_MIN_CUT:
+    select_min_cut(app, node_id);
+    break;
+  case SELECT_CYCLES:
+    app->selected_nodes[node_id] = 1;
+    start_cycle_search(app, node_id);
+    break;
+  case SELECT_MODE_COUNT:
+    printf("This should never happen.\n");
+    exit(1);
+  }
+  update_node_visibility(app);
+  app->left_scroll_position = 0; // Reset left menu scroll position
+}
 
-  // Render search icon
-  SDL_Rect search_icon_rect = {app->window_width - search_icon_size, 5,
-                               search_icon_size, search_icon_size};
-  SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
-  SDL_RenderFillRect(renderer, &search_icon_rect);
+static inline void set_edge_selection(AppState *app, int edge_id) {
+  memset(app->selected_nodes, 0, app->graph->node_count * sizeof(int));
+  app->path_length = 0;
+  app->cut_length = 0;
+  stop_cycle_search(&app->cycles);
+  app->selected_nodes[app->graph->edges[edge_id].source] = 1;
+  app->selected_nodes[app->graph->edges[edge_id].target] = 1;
+  update_node_visibility(app);
+  app->left_scroll_position = 0; // Reset left menu scroll position
+}
 
-  // Draw a simple magnifying glass icon
-  int icon_center_x = search_icon_rect.x + search_icon_size / 2;
-  int icon_center_y = search_icon_rect.y + search_icon_size / 2;
-  int circle_radius = search_icon_size / 3;
-  circleRGBA(renderer, icon_center_x, icon_center_y, circle_radius, 100, 100,
-             100, 255);
-  thickLineRGBA(renderer, icon_center_x + circle_radius - 2,
-                icon_center_y + circle_radius - 2,
-                icon_center_x + search_icon_size / 2 - 2,
-                icon_center_y + search_icon_size / 2 - 2, 3, 100, 100, 100,
-                255);
+// Selects exactly the given nodes. Ids outside the graph are ignored.
+static inline void set_selection(AppState *app, const int *ids, int count) {
+  memset(app->selected_nodes, 0, app->graph->node_count * sizeof(int));
+  app->path_length = 0;
+  app->cut_length = 0;
+  stop_cycle_search(&app->cycles);
+  for (int i = 0; i < count; i++)
+    if (ids[i] >= 0 && ids[i] < app->graph->node_count)
+      app->selected_nodes[ids[i]] = 1;
+  update_node_visibility(app);
+  app->left_scroll_position = 0; // Reset left menu scroll position
+}
 
-  // Render node list
-  int y_offset = SEARCH_BAR_HEIGHT + 10;
-  int nodes_rendered = 0;
-  int item_height = 20;
+static inline int compare_type_counts(const void *a, const void *b) {
+  const TypeCount *x = a, *y = b;
+  if (x->count != y->count)
+    return y->count - x->count;
+  return x->type - y->type;
+}
 
-  // Render scrollbar
-  int scroll_area_height = app->window_height - SEARCH_BAR_HEIGHT - 20;
-  render_scrollbar(renderer, app->window_width - scrollbar_width,
-                   SEARCH_BAR_HEIGHT + 10, scrollbar_width, scroll_area_height,
-                   app->visible_nodes_count, scroll_area_height / item_height,
-                   app->right_scroll_position);
+// Drops the empty slots of a per-type tally and sorts the rest by count,
+// largest first. Returns how many are left.
+static inline int sort_type_counts(TypeCount *counts, int slots) {
+  int length = 0;
+  for (int t = 0; t < slots; t++)
+    if (counts[t].count)
+      counts[length++] = counts[t];
+  qsort(counts, length, sizeof(TypeCount), compare_type_counts);
+  return length;
+}
 
-  // Render visible content
-  SDL_Rect content_area = {right_menu_x, y_offset,
-                           right_menu_width - scrollbar_width,
-                           scroll_area_height};
-  SDL_RenderSetViewport(renderer, &content_area);
+// Selects every node the roots do not reach. With objgraph's root flags
+// that is the cyclic garbage the collector has yet to free. The right menu
+// switches to the type view over the selection, most common type first.
+static inline void select_unreachable(AppState *app) {
+  GraphData *graph = app->graph;
+  int n = graph->node_count;
+  Uint32 start = SDL_GetTicks();
+  Uint64 *reachable = reachable_from_roots(graph);
+  int *ids = malloc((n ? n : 1) * sizeof(int));
+  if (!reachable || !ids) {
+    fprintf(stderr, "Failed to allocate memory for unreachable objects\n");
+    goto done;
+  }
 
-  y_offset = -app->right_scroll_position;
-  for (int i = 0; i < app->graph->node_count; i++) {
-    if (app->graph->nodes[i].visible) {
-      char node_text[MAX_LABEL_LENGTH + 10];
-      snprintf(node_text, sizeof(node_text), "%d: %s", app->graph->nodes[i].id,
-               app->graph->nodes[i].label);
+  int count = 0;
+  for (int i = 0; i < n; i++)
+    if (!graph->nodes[i].removed && !(reachable[i >> 6] & (1ull << (i & 63))))
+      ids[count++] = i;
+  set_selection(app, ids, count);
+  app->group_by_type = 1;
+  app->types.selected_only = 1;
+  app->types.valid = 0;
+  app->right_scroll_position = 0;
+  DEBUG_PRINT("Unreachable: %d of %d nodes, %u ms\n", count, n,
+              SDL_GetTicks() - start);
 
-      SDL_Color bg_color =
-          (nodes_rendered % 2 == 0) ? COLOR_MENU_ITEM_1 : COLOR_MENU_ITEM_2;
+done:
+  free(reachable);
+  free(ids);
+}
 
-      // Highlight hovered item
-      if (nodes_rendered == app->right_menu_hovered_item) {
-        bg_color = (SDL_Color){100, 100, 100, 255}; // Lighter color for hover
-      }
+// Recounts the visible (or selected) instances of each type from the type ids
+// alone, and returns the number of rows.
+static inline int update_type_histogram(AppState *app) {
+  GraphData *graph = app->graph;
+  TypeHistogram *types = &app->types;
+  if (types->valid)
+    return types->length;
+  types->length = 0;
+  TypeCount *rows = ensure_type_ids(graph)
+                        ? realloc(types->rows, (graph->type_count + 1) *
+                                                   sizeof(TypeCount))
+                        : NULL;
+  if (!rows) {
+    fprintf(stderr, "Failed to allocate memory for the type histogram\n");
+    return 0;
+  }
+  types->rows = rows;
+  memset(rows, 0, (graph->type_count + 1) * sizeof(TypeCount));
+  for (int i = 0; i < graph->node_count; i++) {
+    int counted = types->selected_only
+                      ? !graph->nodes[i].removed && app->selected_nodes[i]
+                      : graph->nodes[i].visible;
+    if (!counted)
+      continue;
+    int slot = type_slot(graph, &graph->nodes[i]);
+    rows[slot].type = slot;
+    rows[slot].count++;
+    rows[slot].size += graph->nodes[i].size;
+  }
+  types->length = sort_type_counts(rows, graph->type_count + 1);
+  types->valid = 1;
+  return types->length;
+}
 
-      render_menu_item(renderer, node_text, 0, y_offset, content_area.w,
-                       item_height, bg_color, COLOR_WHITE, app->font_small);
+// Selects every instance of a type slot, visible or not.
+static inline void select_type(AppState *app, int slot) {
+  GraphData *graph = app->graph;
+  int *ids = malloc((graph->node_count ? graph->node_count : 1) * sizeof(int));
+  if (!ids || !ensure_type_ids(graph)) {
+    fprintf(stderr, "Failed to allocate memory for the selection\n");
+    free(ids);
+    return;
+  }
+  int count = 0;
+  for (int i = 0; i < graph->node_count; i++)
+    if (!graph->nodes[i].removed && type_slot(graph, &graph->nodes[i]) == slot)
+      ids[count++] = i;
+  app->types.selected_only = 0;
+  set_selection(app, ids, count);
+  free(ids);
+}
 
-      y_offset += item_height;
-      nodes_rendered++;
+// Adds label to a filter list, or removes it if it is already there.
+// Returns 1 if it was added, 0 if removed and -1 when out of memory.
+static inline int toggle_listed_label(char ***labels, int *count,
+                                      const char *label) {
+  for (int i = 0; i < *count; i++) {
+    if (!strcmp((*labels)[i], label)) {
+      free((*labels)[i]);
+      (*labels)[i] = (*labels)[--*count];
+      return 0;
     }
   }
+  char **grown = realloc(*labels, (*count + 1) * sizeof(char *));
+  if (!grown)
+    return -1;
+  *labels = grown;
+  if (!(grown[*count] = strdup(label)))
+    return -1;
+  (*count)++;
+  return 1;
+}
 
-  SDL_RenderSetViewport(renderer, NULL);
+static inline void free_edge_filter(EdgeFilter *filter) {
+  for (int i = 0; i < filter->follow_count; i++)
+    free(filter->follow[i]);
+  for (int i = 0; i < filter->skip_count; i++)
+    free(filter->skip[i]);
+  free(filter->follow);
+  free(filter->skip);
+  unsigned version = filter->version;
+  memset(filter, 0, sizeof(EdgeFilter));
+  filter->version = version + 1;
 }
 
-static inline void handle_input(SDL_Event *event, AppState *app) {
-  int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
-  int right_menu_width = RIGHT_MENU_WIDTH(app->window_width);
-  int graph_width = GRAPH_WIDTH(app->window_width);
+// Drops what was computed under the old filter. Retained sizes are redone
+// if they are shown; selections keep their nodes until the next click.
+static inline void edge_filter_changed(AppState *app) {
+  app->filter.version++;
+  app->graph->retained_valid = 0;
+  if (app->sort_by_retained)
+    app->sort_by_retained = compute_retained_sizes(app->graph);
+  stop_cycle_search(&app->cycles);
+  if (app->filter.follow_count)
+    DEBUG_PRINT("Traversals follow %d edge labels, less %d skipped\n",
+                app->filter.follow_count, app->filter.skip_count);
+  else
+    DEBUG_PRINT("Traversals follow every edge label but %d\n",
+                app->filter.skip_count);
+}
 
-  switch (event->type) {
-  case SDL_MOUSEMOTION:
-    app->mouse_position.x = event->motion.x;
-    app->mouse_position.y = event->motion.y;
+// Makes traversals skip the label of edge_id, or with follow set follow
+// only it and the other follow labels; doing it again undoes it.
+static inline void toggle_edge_label(AppState *app, int edge_id, int follow) {
+  EdgeFilter *filter = &app->filter;
+  const char *label = app->graph->edges[edge_id].label;
+  int added = follow ? toggle_listed_label(&filter->follow,
+                                           &filter->follow_count, label)
+                     : toggle_listed_label(&filter->skip, &filter->skip_count,
+                                           label);
+  if (added < 0) {
+    fprintf(stderr, "Failed to allocate memory for the edge filter\n");
+    return;
+  }
+  DEBUG_PRINT("%s edges labelled %s\n",
+              follow ? (added ? "Following" : "No longer only following")
+                     : (added ? "Skipping" : "No longer skipping"),
+              label);
+  edge_filter_changed(app);
+}
 
-    // Handle scrollbar dragging
-    if (app->is_dragging_left_scrollbar) {
-      int drag_distance = event->motion.y - app->drag_start_y;
-      int scroll_area_height = app->window_height * 0.4 - 50;
-      int max_scroll = app->visible_nodes_count * 20 - scroll_area_height;
-      app->left_scroll_position =
-          app->drag_start_scroll +
-          (drag_distance * max_scroll) / scroll_area_height;
-      app->left_scroll_position =
-          fmax(0, fmin(app->left_scroll_position, max_scroll));
-    } else if (app->is_dragging_right_scrollbar) {
-      int drag_distance = event->motion.y - app->drag_start_y;
-      int scroll_area_height = app->window_height - SEARCH_BAR_HEIGHT - 20;
-      int max_scroll = app->visible_nodes_count * 20 - scroll_area_height;
-      app->right_scroll_position =
-          app->drag_start_scroll +
-          (drag_distance * max_scroll) / scroll_area_height;
-      app->right_scroll_position =
-          fmax(0, fmin(app->right_scroll_position, max_scroll));
-    } else {
-      // Reset hover states
-      app->hovered_node = -1;
-      app->hovered_edge = -1;
-      app->right_menu_hovered_item = -1;
+// Sets the filter traversals start with: everything but weak references.
+static inline void reset_edge_filter(AppState *app) {
+  free_edge_filter(&app->filter);
+  if (toggle_listed_label(&app->filter.skip, &app->filter.skip_count,
+                          WEAKREF_EDGE_LABEL) < 0)
+    fprintf(stderr, "Failed to allocate memory for the edge filter\n");
+}
 
-      int right_menu_x = app->window_width - right_menu_width;
+// Ends the summary, if one is shown, and hands back the full graph.
+static inline GraphData *detach_summary(AppState *app) {
+  GraphSummary *summary = &app->summary;
+  GraphData *full = summary->full;
+  if (!full)
+    return NULL;
+  free(summary->groups);
+  free(summary->positions);
+  free(summary->chain_ends);
+  free(summary->expanded);
+  free(summary->origins);
+  free(summary->chain_edges);
+  key_table_free(&summary->node_keys);
+  free(summary->free_nodes);
+  memset(summary, 0, sizeof(GraphSummary));
+  return full;
+}
 
-      // Check for right menu hover
-      if (app->mouse_position.x >= right_menu_x) {
-        int y_offset = SEARCH_BAR_HEIGHT + 10 - app->right_scroll_position;
-        int item_height = 20;
-        int nodes_rendered = 0;
-        for (int i = 0; i < app->graph->node_count; i++) {
-          if (app->graph->nodes[i].visible) {
-            if (app->mouse_position.y >= y_offset &&
-                app->mouse_position.y < y_offset + item_height) {
-              app->right_menu_hovered_item = nodes_rendered;
-              break;
-            }
-            y_offset += item_height;
-            nodes_rendered++;
-          }
-        }
-      }
+// Groups the nodes of full for a summary of the given kind. Types and chains
+// start collapsed; components start collapsed unless they are a single node,
+// which leaves only the cycles folded in the condensation.
+static inline int group_summary(GraphSummary *summary, GraphData *full) {
+  int n = full->node_count;
+  summary->groups = malloc((n ? n : 1) * sizeof(int));
+  if (!summary->groups)
+    return 0;
+  if (summary->kind == SUMMARY_TYPES) {
+    if (!ensure_type_ids(full))
+      return 0;
+    for (int i = 0; i < n; i++)
+      summary->groups[i] = type_slot(full, &full->nodes[i]);
+    summary->group_count = full->type_count + 1;
+    summary->expanded = calloc(summary->group_count, 1);
+    return summary->expanded != NULL;
+  }
+  if (summary->kind == SUMMARY_CHAINS) {
+    // A chain has at least two of the n nodes
+    summary->chain_ends = malloc((n / 2 + 1) * 2 * sizeof(int));
+    if (!summary->chain_ends)
+      return 0;
+    summary->group_count =
+        find_chains(full, summary->groups, summary->chain_ends);
+    if (summary->group_count < 0)
+      return 0;
+    summary->expanded = calloc(summary->group_count + 1, 1);
+    if (!summary->expanded)
+      return 0;
+    summary->expanded[summary->group_count] = 1;
+    DEBUG_PRINT("Chains: %d\n", summary->group_count);
+    return 1;
+  }
+  summary->group_count = compute_components(full, summary->groups);
+  if (summary->group_count < 0)
+    return 0;
+  summary->positions =
+      layer_components(full, summary->groups, summary->group_count);
+  int *sizes = calloc(summary->group_count + 1, sizeof(int));
+  summary->expanded = calloc(summary->group_count + 1, 1);
+  if (!summary->positions || !sizes || !summary->expanded) {
+    free(sizes);
+    return 0;
+  }
+  for (int i = 0; i < n; i++) {
+    if (summary->groups[i] < 0)
+      summary->groups[i] = summary->group_count; // Removed, never shown
+    sizes[summary->groups[i]]++;
+  }
+  for (int c = 0; c < summary->group_count; c++)
+    summary->expanded[c] = sizes[c] == 1;
+  free(sizes);
+  return 1;
+}
 
-      // Check for node hover (in graph area)
-      if (app->right_menu_hovered_item == -1 &&
-          app->mouse_position.x >= left_menu_width &&
-          app->mouse_position.x < right_menu_x) {
-        for (int i = 0; i < app->graph->node_count; i++) {
-          if (!app->graph->nodes[i].visible)
-            continue;
+// Switches between the graph and its summary of the given kind, or from one
+// summary to the other.
+static inline void toggle_summary(AppState *app, SummaryKind kind) {
+  GraphSummary *summary = &app->summary;
+  if (summary->full) {
+    SummaryKind shown = summary->kind;
+    KeyTable node_keys = summary->node_keys;
+    int *free_nodes = summary->free_nodes;
+    int free_node_count = summary->free_node_count;
+    summary->node_keys = (KeyTable){0};
+    summary->free_nodes = NULL;
+    reinitialize_app(app, detach_summary(app));
+    app->node_keys = node_keys;
+    app->free_nodes = free_nodes;
+    app->free_node_count = free_node_count;
+    if (shown == kind)
+      return;
+  }
+  GraphData *full = app->graph;
+  GraphSummary next = {.kind = kind};
+  GraphData *view =
+      group_summary(&next, full) ? summarize_graph(full, &next) : NULL;
+  if (!view) {
+    free(next.groups);
+    free(next.positions);
+    free(next.chain_ends);
+    free(next.expanded);
+    return;
+  }
+  next.node_keys = app->node_keys;
+  next.free_nodes = app->free_nodes;
+  next.free_node_count = app->free_node_count;
+  app->node_keys = (KeyTable){0};
+  app->free_nodes = NULL;
+  app->graph = NULL; // Kept as the summary's full graph, not freed
+  reinitialize_app(app, view);
+  next.full = full;
+  *summary = next;
+}
 
-          int nx = (app->graph->nodes[i].position.x + app->camera.position.x) *
-                       app->camera.zoom +
-                   left_menu_width + (float)graph_width / 2;
-          int ny = (app->graph->nodes[i].position.y + app->camera.position.y) *
-                       app->camera.zoom +
-                   (float)app->window_height / 2;
+// Expands a collapsed group into its members, or collapses it back.
+static inline void toggle_group(AppState *app, int group) {
+  GraphSummary *summary = &app->summary;
+  GraphData *full = summary->full;
+  if (group < 0 || group >= summary->group_count)
+    return;
+  summary->expanded[group] = !summary->expanded[group];
+  GraphData *view = summarize_graph(full, summary);
+  if (!view) {
+    summary->expanded[group] = !summary->expanded[group];
+    return;
+  }
+  Camera camera = app->camera;
+  summary->full = NULL; // Keeps reinitialize_app from ending the summary
+  reinitialize_app(app, view);
+  summary->full = full;
+  app->camera = camera;
+}
 
-          if (sqrt(pow(app->mouse_position.x - nx, 2) +
-                   pow(app->mouse_position.y - ny, 2)) <=
-              5 * app->camera.zoom) {
-            app->hovered_node = i;
-            break;
-          }
-        }
-      }
+// Expands the supernode node_id into the members of its group, or collapses
+// the group of the member node_id.
+static inline void toggle_expansion(AppState *app, int node_id) {
+  int origin = app->summary.origins[node_id];
+  toggle_group(app, origin < 0 ? -1 - origin : app->summary.groups[origin]);
+}
 
-      // Check for edge hover (in graph area)
-      if (app->hovered_node == -1 && app->right_menu_hovered_item == -1 &&
-          app->mouse_position.x >= left_menu_width &&
-          app->mouse_position.x < right_menu_x) {
-        for (int i = 0; i < app->graph->edge_count; i++) {
-          GraphNode *source = &app->graph->nodes[app->graph->edges[i].source];
-          GraphNode *target = &app->graph->nodes[app->graph->edges[i].target];
+static inline void render_label_background(SDL_Renderer *renderer, int x, int y,
+                                           int width, int height) {
+  SDL_Rect bg_rect = {x - 2, y - 2, width + 4, height + 4};
+  SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
+  SDL_RenderFillRect(renderer, &bg_rect);
+}
 
-          if (!source->visible || !target->visible)
-            continue;
+static inline void render_hover_label(SDL_Renderer *renderer, AppState *app,
+                                      const char *label, int x, int y) {
+  if (label == NULL || strlen(label) == 0) {
+    return;
+  }
 
-          int x1 =
-              (source->position.x + app->camera.position.x) * app->camera.zoom +
-              left_menu_width + (float)graph_width / 2;
-          int y1 =
-              (source->position.y + app->camera.position.y) * app->camera.zoom +
-              (float)app->window_height / 2;
-          int x2 =
-              (target->position.x + app->camera.position.x) * app->camera.zoom +
-              left_menu_width + (float)graph_width / 2;
-          int y2 =
-              (target->position.y + app->camera.position.y) * app->camera.zoom +
-              (float)app->window_height / 2;
+  // Full labels can be arbitrarily long; show only their start.
+  char shortened[MAX_HOVER_LABEL_LENGTH];
+  snprintf(shortened, sizeof(shortened), "%s", label);
 
-          float d =
-              fabs((y2 - y1) * app->mouse_position.x -
-                   (x2 - x1) * app->mouse_position.y + x2 * y1 - y2 * x1) /
-              sqrt(pow(y2 - y1, 2) + pow(x2 - x1, 2));
+  int max_width = 300;
+  SDL_Surface *text_surface = TTF_RenderText_Blended_Wrapped(
+      app->font_small, shortened, COLOR_WHITE, max_width);
+  if (!text_surface) {
+    fprintf(stderr, "Failed to render text: %s\n", TTF_GetError());
+    return;
+  }
 
-          if (d <= 5 * app->camera.zoom &&
-              app->mouse_position.x >= fmin(x1, x2) - 5 * app->camera.zoom &&
-              app->mouse_position.x <= fmax(x1, x2) + 5 * app->camera.zoom &&
-              app->mouse_position.y >= fmin(y1, y2) - 5 * app->camera.zoom &&
-              app->mouse_position.y <= fmax(y1, y2) + 5 * app->camera.zoom) {
-            app->hovered_edge = i;
-            break;
-          }
-        }
-      }
+  SDL_Texture *text_texture =
+      SDL_CreateTextureFromSurface(renderer, text_surface);
+  if (!text_texture) {
+    fprintf(stderr, "Failed to create texture: %s\n", SDL_GetError());
+    SDL_FreeSurface(text_surface);
+    return;
+  }
 
-      if (event->motion.state & SDL_BUTTON_LMASK) {
-        // Only move the graph if the mouse is in the graph area
-        int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
-        int right_menu_width = RIGHT_MENU_WIDTH(app->window_width);
-        if (app->mouse_position.x > left_menu_width &&
-            app->mouse_position.x < app->window_width - right_menu_width &&
-            app->mouse_position.y > TOP_BAR_HEIGHT) {
-          app->camera.position.x += event->motion.xrel / app->camera.zoom;
-          app->camera.position.y += event->motion.yrel / app->camera.zoom;
-        }
-      }
+  int text_width = text_surface->w;
+  int text_height = text_surface->h;
+
+  // Use cursor position (stored in app->mouse_position)
+  x = app->mouse_position.x;
+  y = app->mouse_position.y;
+
+  // Adjust position to keep label on screen
+  if (x + text_width > app->window_width) {
+    x = app->window_width - text_width - 5;
+  }
+  if (y + text_height > app->window_height) {
+    y = app->window_height - text_height - 5;
+  }
+
+  render_label_background(renderer, x, y, text_width, text_height);
+
+  SDL_Rect text_rect = {x, y, text_width, text_height};
+  SDL_RenderCopy(renderer, text_texture, NULL, &text_rect);
+
+  SDL_FreeSurface(text_surface);
+  SDL_DestroyTexture(text_texture);
+}
+
+// Fill color of an unselected node: blue, or green/orange for objects a diff
+// found added/removed.
+static inline SDL_Color node_color(const GraphNode *node) {
+  switch (node->diff) {
+  case DIFF_ADDED:
+    return (SDL_Color){0, 200, 0, 255};
+  case DIFF_REMOVED:
+    return (SDL_Color){255, 140, 0, 255};
+  default:
+    return (SDL_Color){0, 0, 255, 255};
+  }
+}
+
+// Draws one edge from screen point p1 to the rim of the node at p2. The
+// arrowhead is the unit direction rotated by +-pi/12, i.e. two fixed 2x2
+// rotations folded into one 4-wide multiply-add, so no trig is evaluated.
+static inline void render_edge(SDL_Renderer *renderer, Vec2f p1, Vec2f p2,
+                               Vec2f dir, float zoom, Uint8 r, Uint8 g,
+                               Uint8 b, Uint8 a) {
+  float circle_radius = NODE_RADIUS * zoom;
+  float tip_x = p2.x - circle_radius * dir.x;
+  float tip_y = p2.y - circle_radius * dir.y;
+
+  lineRGBA(renderer, p1.x, p1.y, tip_x, tip_y, r, g, b, a);
+
+  if (zoom < ARROWHEAD_MIN_ZOOM)
+    return;
+
+  float arrow_size = ARROWHEAD_SIZE * zoom;
+  float wing[4]; // x3, y3, x4, y4
+#if defined(__SSE2__)
+  __m128 k1 = _mm_setr_ps(ARROWHEAD_COS, -ARROWHEAD_SIN, ARROWHEAD_COS,
+                          ARROWHEAD_SIN);
+  __m128 k2 = _mm_setr_ps(ARROWHEAD_SIN, ARROWHEAD_COS, -ARROWHEAD_SIN,
+                          ARROWHEAD_COS);
+  __m128 rotated = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dir.x), k1),
+                              _mm_mul_ps(_mm_set1_ps(dir.y), k2));
+  __m128 tip = _mm_setr_ps(tip_x, tip_y, tip_x, tip_y);
+  _mm_storeu_ps(wing, _mm_sub_ps(tip, _mm_mul_ps(_mm_set1_ps(arrow_size),
+                                                 rotated)));
+#else
+  wing[0] = tip_x - arrow_size * (dir.x * ARROWHEAD_COS + dir.y * ARROWHEAD_SIN);
+  wing[1] = tip_y - arrow_size * (dir.y * ARROWHEAD_COS - dir.x * ARROWHEAD_SIN);
+  wing[2] = tip_x - arrow_size * (dir.x * ARROWHEAD_COS - dir.y * ARROWHEAD_SIN);
+  wing[3] = tip_y - arrow_size * (dir.y * ARROWHEAD_COS + dir.x * ARROWHEAD_SIN);
+#endif
+
+  filledTrigonRGBA(renderer, tip_x, tip_y, wing[0], wing[1], wing[2], wing[3],
+                   r, g, b, a);
+}
+
+static inline void free_density_layer(DensityLayer *layer) {
+  if (layer->texture)
+    SDL_DestroyTexture(layer->texture);
+  free(layer->counts);
+  free(layer->selected_counts);
+  free(layer->pixels);
+  free(layer->bundle_keys);
+  free(layer->bundle_counts);
+  free(layer->bundle_stamps);
+  memset(layer, 0, sizeof(DensityLayer));
+}
+
+static inline int ensure_density_layer(SDL_Renderer *renderer,
+                                       DensityLayer *layer, int grid_width,
+                                       int grid_height, int edge_count) {
+  if (layer->grid_width != grid_width || layer->grid_height != grid_height) {
+    free_density_layer(layer);
+    size_t cells = (size_t)grid_width * grid_height;
+    layer->counts = malloc(cells * sizeof(Uint32));
+    layer->selected_counts = malloc(cells * sizeof(Uint32));
+    layer->pixels = malloc(cells * sizeof(Uint32));
+    layer->texture =
+        SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                          SDL_TEXTUREACCESS_STREAMING, grid_width, grid_height);
+    if (!layer->counts || !layer->selected_counts || !layer->pixels ||
+        !layer->texture) {
+      fprintf(stderr, "Failed to allocate density layer: %s\n",
+              SDL_GetError());
+      free_density_layer(layer);
+      return 0;
     }
-    break;
+    SDL_SetTextureBlendMode(layer->texture, SDL_BLENDMODE_BLEND);
+    layer->grid_width = grid_width;
+    layer->grid_height = grid_height;
+  }
 
-  case SDL_MOUSEWHEEL:
-    if (app->mouse_position.x > app->window_width - right_menu_width) {
-      handle_menu_scroll(&app->right_scroll_position, event->wheel.y * 20,
-                         app->visible_nodes_count, app->nodes_per_page, 20);
-    } else if (app->mouse_position.x < left_menu_width &&
-               app->mouse_position.y >
-                   app->window_height - app->window_height * 0.4) {
-      int selected_count = 0;
-      for (int i = 0; i < app->graph->node_count; i++) {
-        if (app->selected_nodes[i] && app->graph->nodes[i].visible) {
-          selected_count++;
-        }
-      }
-      int visible_items = (app->window_height * 0.4 - 50) / 20;
-      handle_menu_scroll(&app->left_scroll_position, event->wheel.y * 20,
-                         selected_count, visible_items, 20);
-    } else {
-      app->camera.zoom *= (event->wheel.y > 0) ? 1.1f : 0.9f;
+  int capacity = 64;
+  while (capacity < 2 * edge_count && capacity < (1 << 22))
+    capacity <<= 1;
+  if (layer->bundle_capacity != capacity) {
+    free(layer->bundle_keys);
+    free(layer->bundle_counts);
+    free(layer->bundle_stamps);
+    layer->bundle_keys = malloc(capacity * sizeof(Uint64));
+    layer->bundle_counts = malloc(capacity * sizeof(Uint32));
+    layer->bundle_stamps = calloc(capacity, sizeof(Uint32));
+    layer->bundle_capacity = capacity;
+    layer->frame = 0;
+    if (!layer->bundle_keys || !layer->bundle_counts ||
+        !layer->bundle_stamps) {
+      fprintf(stderr, "Failed to allocate memory for edge bundles\n");
+      free_density_layer(layer);
+      return 0;
     }
-    break;
+  }
+  return 1;
+}
 
-  case SDL_MOUSEBUTTONDOWN:
-    if (event->button.button == SDL_BUTTON_LEFT) {
-      int x = event->button.x;
-      int y = event->button.y;
+// Bins every visible node into its LOD_CELL_SIZE screen cell. Cell indices
+// are computed four nodes at a time from the shared screen-space buffer.
+static inline void splat_density(AppState *app, float origin_x) {
+  DensityLayer *layer = &app->density;
+  size_t cells = (size_t)layer->grid_width * layer->grid_height;
+  memset(layer->counts, 0, cells * sizeof(Uint32));
+  memset(layer->selected_counts, 0, cells * sizeof(Uint32));
+
+  const float *screen = (const float *)app->screen_positions;
+  int n = app->graph->node_count;
+  float inv_cell = 1.0f / LOD_CELL_SIZE;
+  int i = 0;
+
+#if defined(__SSE2__)
+  __m128 origin = _mm_setr_ps(origin_x, 0, origin_x, 0);
+  __m128 scale = _mm_set1_ps(inv_cell);
+  __m128 limit_x = _mm_set1_ps((float)layer->grid_width);
+  __m128 limit_y = _mm_set1_ps((float)layer->grid_height);
+  __m128 zero = _mm_setzero_ps();
+  __m128i width = _mm_set1_epi32(layer->grid_width);
+  for (; i + 4 <= n; i += 4) {
+    __m128 a =
+        _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(screen + 2 * i), origin), scale);
+    __m128 b = _mm_mul_ps(
+        _mm_sub_ps(_mm_loadu_ps(screen + 2 * i + 4), origin), scale);
+    __m128 cx = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 cy = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    __m128 inside = _mm_and_ps(
+        _mm_and_ps(_mm_cmpge_ps(cx, zero), _mm_cmplt_ps(cx, limit_x)),
+        _mm_and_ps(_mm_cmpge_ps(cy, zero), _mm_cmplt_ps(cy, limit_y)));
+    __m128i ix = _mm_cvttps_epi32(cx);
+    __m128i iy = _mm_cvttps_epi32(cy);
+    // Low 32 bits of iy * width using SSE2 only; the products fit in 32 bits.
+    __m128i even = _mm_mul_epu32(iy, width);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(iy, 4), width);
+    __m128i row =
+        _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                           _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    // Cells outside the grid become -1.
+    __m128i in_mask = _mm_castps_si128(inside);
+    __m128i cell = _mm_or_si128(_mm_and_si128(in_mask, _mm_add_epi32(row, ix)),
+                                _mm_andnot_si128(in_mask, _mm_set1_epi32(-1)));
+    int idx[4];
+    _mm_storeu_si128((__m128i *)idx, cell);
+    for (int k = 0; k < 4; k++) {
+      if (idx[k] < 0 || !app->graph->nodes[i + k].visible)
+        continue;
+      layer->counts[idx[k]]++;
+      layer->selected_counts[idx[k]] += app->selected_nodes[i + k] != 0;
+    }
+  }
+#endif
 
-      if (x >= app->open_button.x &&
-          x <= app->open_button.x + app->open_button.w &&
-          y >= app->open_button.y &&
-          y <= app->open_button.y + app->open_button.h) {
-        const char *selected_file = handle_open_button_click();
-        reinitialize_app(app, selected_file);
-      } else if (x >= 10 && x <= left_menu_width - 10 && y >= 10 && y <= 40) {
-        cycle_selection_mode(app);
-      } else if (x >= 10 && x <= left_menu_width - 10 && y >= 50 && y <= 80) {
-        app->filter_referenced = !app->filter_referenced;
-        update_node_visibility(app);
-      } else if (x >= app->window_width - right_menu_width) {
-        int scrollbar_width = 15;
-        // Check if clicking on right scrollbar
-        SDL_Rect right_scrollbar = render_scrollbar(
-            NULL, app->window_width - scrollbar_width, SEARCH_BAR_HEIGHT + 10,
-            scrollbar_width, app->window_height - SEARCH_BAR_HEIGHT - 20,
-            app->visible_nodes_count * 20,
-            app->window_height - SEARCH_BAR_HEIGHT - 20,
-            app->right_scroll_position);
-        if (x >= right_scrollbar.x &&
-            x <= right_scrollbar.x + right_scrollbar.w &&
-            y >= right_scrollbar.y &&
-            y <= right_scrollbar.y + right_scrollbar.h) {
-          app->is_dragging_right_scrollbar = 1;
-          app->drag_start_y = y;
-          app->drag_start_scroll = app->right_scroll_position;
-        } else if (x < app->window_width - scrollbar_width) {
-          // Clicking in the right menu
-          int y_offset = SEARCH_BAR_HEIGHT + 10 - app->right_scroll_position;
-          int nodes_rendered = 0;
-          for (int i = 0; i < app->graph->node_count; i++) {
-            if (app->graph->nodes[i].visible) {
-              if (y >= y_offset && y < y_offset + 20) {
-                set_node_selection(app, i);
-                break;
-              }
-              y_offset += 20;
-              nodes_rendered++;
-            }
-          }
-        }
-      } else if (x < left_menu_width &&
-                 y > app->window_height - app->window_height * 0.4) {
-        int scrollbar_width = 15;
-        // Check if clicking on left scrollbar
-        SDL_Rect left_scrollbar = render_scrollbar(
-            NULL, left_menu_width - scrollbar_width,
-            app->window_height - app->window_height * 0.4 + 50, scrollbar_width,
-            app->window_height * 0.4 - 50, app->visible_nodes_count * 20,
-            app->window_height * 0.4 - 50, app->left_scroll_position);
-        if (x >= left_scrollbar.x && x <= left_scrollbar.x + left_scrollbar.w &&
-            y >= left_scrollbar.y && y <= left_scrollbar.y + left_scrollbar.h) {
-          app->is_dragging_left_scrollbar = 1;
-          app->drag_start_y = y;
-          app->drag_start_scroll = app->left_scroll_position;
-        } else if (x < left_menu_width - scrollbar_width) {
-          // Clicking in the left menu's "Selected Objects" section
-          int y_offset = app->window_height - app->window_height * 0.4 + 50 -
-                         app->left_scroll_position;
-          for (int i = 0; i < app->graph->node_count; i++) {
-            if (app->selected_nodes[i] && app->graph->nodes[i].visible) {
-              if (y >= y_offset && y < y_offset + 20) {
-                set_node_selection(app, i);
-                break;
-              }
-              y_offset += 20;
-            }
-          }
-        }
-      } else {
-        // Clicking in the graph area
-        if (app->hovered_node != -1) {
-          set_node_selection(app, app->hovered_node);
-        } else if (app->hovered_edge != -1) {
-          set_edge_selection(app, app->hovered_edge);
-        }
+  for (; i < n; i++) {
+    if (!app->graph->nodes[i].visible)
+      continue;
+    float cx = (screen[2 * i] - origin_x) * inv_cell;
+    float cy = screen[2 * i + 1] * inv_cell;
+    if (cx < 0 || cy < 0 || cx >= layer->grid_width ||
+        cy >= layer->grid_height)
+      continue;
+    int idx = (int)cy * layer->grid_width + (int)cx;
+    layer->counts[idx]++;
+    layer->selected_counts[idx] += app->selected_nodes[i] != 0;
+  }
+}
+
+static inline Uint32 density_color(Uint32 count, Uint32 selected,
+                                   float log_max) {
+  if (count == 0)
+    return 0;
+  float v = log1pf((float)count) / log_max;
+  if (selected)
+    return 0xFF000000u | (255u << 16) | ((Uint32)(v * 160) << 8) |
+           (Uint32)(v * 160);
+  // Dark blue -> cyan -> white as density grows.
+  Uint32 r = v > 0.5f ? (Uint32)((v - 0.5f) * 2 * 255) : 0;
+  Uint32 g = (Uint32)(fminf(v * 2, 1.0f) * 255);
+  Uint32 b = 128 + (Uint32)(v * 127);
+  Uint32 a = 96 + (Uint32)(v * 159);
+  return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+static inline void render_edge_bundles(SDL_Renderer *renderer, AppState *app,
+                                       Uint8 alpha) {
+  DensityLayer *layer = &app->density;
+  Vec2f *screen = app->screen_positions;
+  Uint32 mask = layer->bundle_capacity - 1;
+  Uint32 max_count = 0;
+
+  if (++layer->frame == 0) {
+    memset(layer->bundle_stamps, 0, layer->bundle_capacity * sizeof(Uint32));
+    layer->frame = 1;
+  }
+
+  for (int i = 0; i < app->graph->edge_count; i++) {
+    int s = app->graph->edges[i].source;
+    int t = app->graph->edges[i].target;
+    if (!app->graph->nodes[s].visible || !app->graph->nodes[t].visible)
+      continue;
+    // Cell coordinates are biased by 32768 so off-screen cells stay positive.
+    Uint32 sx = (Uint32)(floorf(screen[s].x / LOD_BUNDLE_CELL_SIZE) + 32768);
+    Uint32 sy = (Uint32)(floorf(screen[s].y / LOD_BUNDLE_CELL_SIZE) + 32768);
+    Uint32 tx = (Uint32)(floorf(screen[t].x / LOD_BUNDLE_CELL_SIZE) + 32768);
+    Uint32 ty = (Uint32)(floorf(screen[t].y / LOD_BUNDLE_CELL_SIZE) + 32768);
+    if (sx == tx && sy == ty)
+      continue;
+    Uint64 key = ((Uint64)((sx & 0xFFFF) << 16 | (sy & 0xFFFF)) << 32) |
+                 ((tx & 0xFFFF) << 16 | (ty & 0xFFFF));
+    Uint32 slot = (Uint32)((key * 0x9E3779B97F4A7C15ull) >> 40) & mask;
+    // A full table drops the remaining edges; the bundle view is approximate.
+    for (Uint32 probe = 0; probe <= mask; probe++, slot = (slot + 1) & mask) {
+      if (layer->bundle_stamps[slot] != layer->frame) {
+        layer->bundle_stamps[slot] = layer->frame;
+        layer->bundle_keys[slot] = key;
+        layer->bundle_counts[slot] = 1;
+        break;
+      }
+      if (layer->bundle_keys[slot] == key) {
+        layer->bundle_counts[slot]++;
+        break;
       }
     }
-    break;
+  }
+
+  for (int i = 0; i < layer->bundle_capacity; i++)
+    if (layer->bundle_stamps[i] == layer->frame &&
+        layer->bundle_counts[i] > max_count)
+      max_count = layer->bundle_counts[i];
+  if (max_count == 0)
+    return;
+
+  float log_max = log1pf((float)max_count);
+  float half = LOD_BUNDLE_CELL_SIZE / 2.0f;
+  for (int i = 0; i < layer->bundle_capacity; i++) {
+    if (layer->bundle_stamps[i] != layer->frame)
+      continue;
+    Uint64 key = layer->bundle_keys[i];
+    float x1 = ((float)(key >> 48) - 32768) * LOD_BUNDLE_CELL_SIZE + half;
+    float y1 =
+        ((float)((key >> 32) & 0xFFFF) - 32768) * LOD_BUNDLE_CELL_SIZE + half;
+    float x2 =
+        ((float)((key >> 16) & 0xFFFF) - 32768) * LOD_BUNDLE_CELL_SIZE + half;
+    float y2 = ((float)(key & 0xFFFF) - 32768) * LOD_BUNDLE_CELL_SIZE + half;
+    float weight = log1pf((float)layer->bundle_counts[i]) / log_max;
+    lineRGBA(renderer, x1, y1, x2, y2, 200, 200, 200,
+             (Uint8)((24 + weight * 200) * alpha / 255));
+  }
+}
+
+// Low-zoom representation: a per-cell density texture for the nodes and one
+// line per pair of coarse cells for the edges.
+static inline void render_density_layer(SDL_Renderer *renderer, AppState *app,
+                                        Uint8 alpha) {
+  int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
+  int graph_width = GRAPH_WIDTH(app->window_width);
+  int grid_width = (graph_width + LOD_CELL_SIZE - 1) / LOD_CELL_SIZE;
+  int grid_height = (app->window_height + LOD_CELL_SIZE - 1) / LOD_CELL_SIZE;
+  if (grid_width <= 0 || grid_height <= 0)
+    return;
+
+  DensityLayer *layer = &app->density;
+  if (!ensure_density_layer(renderer, layer, grid_width, grid_height,
+                            app->graph->edge_count))
+    return;
+
+  render_edge_bundles(renderer, app, alpha);
+
+  splat_density(app, left_menu_width);
+
+  size_t cells = (size_t)grid_width * grid_height;
+  Uint32 max_count = 0;
+  for (size_t i = 0; i < cells; i++)
+    if (layer->counts[i] > max_count)
+      max_count = layer->counts[i];
+  float log_max = log1pf((float)(max_count ? max_count : 1));
+  for (size_t i = 0; i < cells; i++)
+    layer->pixels[i] = density_color(layer->counts[i],
+                                     layer->selected_counts[i], log_max);
+
+  SDL_UpdateTexture(layer->texture, NULL, layer->pixels,
+                    grid_width * sizeof(Uint32));
+  SDL_SetTextureAlphaMod(layer->texture, alpha);
+  SDL_Rect dest = {left_menu_width, 0, grid_width * LOD_CELL_SIZE,
+                   grid_height * LOD_CELL_SIZE};
+  SDL_RenderCopy(renderer, layer->texture, NULL, &dest);
+}
+
+// Draws everything that does not depend on hover or selection highlights:
+// the density layer at low zoom, then non-highlighted edges and nodes.
+static inline void render_graph_layer(SDL_Renderer *renderer, AppState *app,
+                                      Uint8 detail_alpha) {
+  Vec2f *screen = app->screen_positions;
+
+  if (detail_alpha < 255)
+    render_density_layer(renderer, app, 255 - detail_alpha);
+
+  // First pass: Render non-highlighted edges
+  for (int i = 0; detail_alpha && i < app->graph->edge_count; i++) {
+    GraphNode *source = &app->graph->nodes[app->graph->edges[i].source];
+    GraphNode *target = &app->graph->nodes[app->graph->edges[i].target];
+
+    if (!source->visible || !target->visible)
+      continue;
+
+    int both_selected = app->selected_nodes[app->graph->edges[i].source] &&
+                        app->selected_nodes[app->graph->edges[i].target];
+
+    if (both_selected)
+      continue; // Skip highlighted edges in this pass
+
+    render_edge(renderer, screen[app->graph->edges[i].source],
+                screen[app->graph->edges[i].target],
+                edge_direction(app->graph, i),
+                app->camera.zoom, 200, 200, 200, detail_alpha);
+  }
+
+  // Second pass: Render non-highlighted nodes
+  for (int i = 0; detail_alpha && i < app->graph->node_count; i++) {
+    if (!app->graph->nodes[i].visible || app->selected_nodes[i])
+      continue;
+
+    SDL_Color color = node_color(&app->graph->nodes[i]);
+    filledCircleRGBA(renderer, screen[i].x, screen[i].y,
+                     NODE_RADIUS * app->camera.zoom, color.r, color.g,
+                     color.b, detail_alpha);
+  }
+}
+
+static inline float tile_level_zoom(int level) {
+  return exp2f((float)level / TILE_LEVELS_PER_OCTAVE);
+}
+
+static inline int tile_level_for_zoom(float zoom) {
+  return (int)lroundf(log2f(zoom) * TILE_LEVELS_PER_OCTAVE);
+}
+
+static inline int floor_div(int a, int b) {
+  return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+static inline unsigned tile_hash(int level, int x, int y) {
+  unsigned h = (unsigned)level * 0x9E3779B1u;
+  h ^= (unsigned)x * 0x85EBCA77u + (h << 6) + (h >> 2);
+  h ^= (unsigned)y * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+  return h & (TILE_HASH_BUCKETS - 1);
+}
+
+static inline int find_tile(TileCache *cache, int level, int x, int y) {
+  for (int i = cache->buckets[tile_hash(level, x, y)]; i != -1;
+       i = cache->tiles[i].next) {
+    Tile *tile = &cache->tiles[i];
+    if (tile->level == level && tile->x == x && tile->y == y)
+      return i;
+  }
+  return -1;
+}
+
+static inline void unlink_tile(TileCache *cache, int index) {
+  Tile *tile = &cache->tiles[index];
+  int *link = &cache->buckets[tile_hash(tile->level, tile->x, tile->y)];
+  while (*link != -1 && *link != index)
+    link = &cache->tiles[*link].next;
+  if (*link == index)
+    *link = tile->next;
+  tile->next = -1;
+}
+
+// Releases a tile's pixels. A tile the worker is still rasterizing is left
+// alone; the worker notices the version change and frees it itself.
+static inline void release_tile(TileCache *cache, int index) {
+  Tile *tile = &cache->tiles[index];
+  if (tile->texture)
+    SDL_DestroyTexture(tile->texture);
+  if (tile->surface)
+    SDL_FreeSurface(tile->surface);
+  tile->texture = NULL;
+  tile->surface = NULL;
+  if (tile->state != TILE_RENDERING)
+    tile->state = TILE_FREE;
+}
+
+// Drops every tile. Caller holds cache->lock.
+static inline void clear_tiles(TileCache *cache) {
+  for (int i = 0; i < TILE_CACHE_MAX_TILES; i++) {
+    release_tile(cache, i);
+    cache->tiles[i].next = -1;
+  }
+  for (int i = 0; i < TILE_HASH_BUCKETS; i++)
+    cache->buckets[i] = -1;
+  cache->queue_length = 0;
+  cache->version++;
+}
+
+// Finds a slot for a new tile, evicting the least recently used tile that
+// is not needed this frame. Returns -1 when every slot is in use.
+static inline int allocate_tile(TileCache *cache, int level, int x, int y) {
+  int victim = -1;
+  for (int i = 0; i < TILE_CACHE_MAX_TILES; i++) {
+    Tile *tile = &cache->tiles[i];
+    if (tile->state == TILE_FREE) {
+      victim = i;
+      break;
+    }
+    if (tile->state == TILE_RENDERING || tile->state == TILE_QUEUED ||
+        tile->last_used == cache->frame)
+      continue;
+    if (victim == -1 || tile->last_used < cache->tiles[victim].last_used)
+      victim = i;
+  }
+  if (victim == -1)
+    return -1;
+
+  if (cache->tiles[victim].state != TILE_FREE) {
+    unlink_tile(cache, victim);
+    release_tile(cache, victim);
+  }
+  Tile *tile = &cache->tiles[victim];
+  tile->level = level;
+  tile->x = x;
+  tile->y = y;
+  unsigned bucket = tile_hash(level, x, y);
+  tile->next = cache->buckets[bucket];
+  cache->buckets[bucket] = victim;
+  return victim;
+}
+
+// The cell of level that holds world point (x, y), clamped to the grid.
+static inline int spatial_cell(const SpatialIndex *index, int level, float x,
+                               float y) {
+  float size = ldexpf(index->cell_size, level);
+  int column = (int)fminf(fmaxf((x - index->min_x) / size, 0),
+                          index->columns[level] - 1);
+  int row = (int)fminf(fmaxf((y - index->min_y) / size, 0),
+                       index->rows[level] - 1);
+  return index->first_cell[level] + row * index->columns[level] + column;
+}
+
+// Files every node and edge in graph->spatial for the current layout.
+// Returns 0 when out of memory, leaving the index invalid.
+static inline int ensure_spatial_index(GraphData *graph) {
+  SpatialIndex *index = &graph->spatial;
+  if (index->valid && index->layout_version == graph->layout_version)
+    return 1;
+  index->valid = 0;
+
+  int n = graph->node_count, m = graph->edge_count;
+  float min_x = INFINITY, min_y = INFINITY;
+  float max_x = -INFINITY, max_y = -INFINITY;
+  for (int i = 0; i < n; i++) {
+    if (graph->nodes[i].removed)
+      continue;
+    min_x = fminf(min_x, graph->nodes[i].position.x);
+    min_y = fminf(min_y, graph->nodes[i].position.y);
+    max_x = fmaxf(max_x, graph->nodes[i].position.x);
+    max_y = fmaxf(max_y, graph->nodes[i].position.y);
+  }
+  if (!(min_x <= max_x && min_y <= max_y))
+    min_x = min_y = max_x = max_y = 0;
+  float width = fmaxf(max_x - min_x, 1.0f);
+  float height = fmaxf(max_y - min_y, 1.0f);
+  float extent = fmaxf(width, height);
+  float cell = sqrtf(width * height * SPATIAL_NODES_PER_CELL / (n ? n : 1));
+  cell = fmaxf(cell, extent / SPATIAL_MAX_COLUMNS);
+
+  int cell_count = 0;
+  index->levels = 0;
+  do {
+    int l = index->levels++;
+    float size = ldexpf(cell, l);
+    index->columns[l] = (int)(width / size) + 1;
+    index->rows[l] = (int)(height / size) + 1;
+    index->first_cell[l] = cell_count;
+    cell_count += index->columns[l] * index->rows[l];
+  } while (index->levels < SPATIAL_MAX_LEVELS &&
+           ldexpf(cell, index->levels - 1) < extent);
+  index->min_x = min_x;
+  index->min_y = min_y;
+  index->cell_size = cell;
+
+  int level0_cells = index->columns[0] * index->rows[0];
+  int *node_cells = malloc((n ? n : 1) * sizeof(int));
+  int *edge_cells = malloc((m ? m : 1) * sizeof(int));
+  int *node_offsets =
+      realloc(index->node_offsets, (level0_cells + 1) * sizeof(int));
+  if (node_offsets)
+    index->node_offsets = node_offsets;
+  int *edge_offsets =
+      realloc(index->edge_offsets, (cell_count + 1) * sizeof(int));
+  if (edge_offsets)
+    index->edge_offsets = edge_offsets;
+  int *nodes = realloc(index->nodes, (n ? n : 1) * sizeof(int));
+  if (nodes)
+    index->nodes = nodes;
+  int *edges = realloc(index->edges, (m ? m : 1) * sizeof(int));
+  if (edges)
+    index->edges = edges;
+  if (!node_cells || !edge_cells || !node_offsets || !edge_offsets ||
+      !nodes || !edges) {
+    fprintf(stderr, "Failed to allocate memory for the spatial index\n");
+    free(node_cells);
+    free(edge_cells);
+    return 0;
+  }
+
+  // Counting sort of nodes and edges by cell, -1 for removed ones
+  memset(node_offsets, 0, (level0_cells + 1) * sizeof(int));
+  memset(edge_offsets, 0, (cell_count + 1) * sizeof(int));
+  for (int i = 0; i < n; i++) {
+    const GraphNode *node = &graph->nodes[i];
+    node_cells[i] = -1;
+    if (node->removed)
+      continue;
+    node_cells[i] = spatial_cell(index, 0, node->position.x, node->position.y);
+    node_offsets[node_cells[i]]++;
+  }
+  for (int i = 0; i < m; i++) {
+    const GraphNode *a = &graph->nodes[graph->edges[i].source];
+    const GraphNode *b = &graph->nodes[graph->edges[i].target];
+    edge_cells[i] = -1;
+    if (a->removed || b->removed)
+      continue;
+    float low_x = fminf(a->position.x, b->position.x);
+    float low_y = fminf(a->position.y, b->position.y);
+    float size = fmaxf(fabsf(a->position.x - b->position.x),
+                       fabsf(a->position.y - b->position.y));
+    int l = 0;
+    while (l < index->levels - 1 && ldexpf(cell, l) < size)
+      l++;
+    edge_cells[i] = spatial_cell(index, l, low_x, low_y);
+    edge_offsets[edge_cells[i]]++;
+  }
+  // Running totals make each offset the end of its cell; filling from the
+  // back then moves it to the start.
+  for (int c = 1; c <= level0_cells; c++)
+    node_offsets[c] += node_offsets[c - 1];
+  for (int c = 1; c <= cell_count; c++)
+    edge_offsets[c] += edge_offsets[c - 1];
+  for (int i = n - 1; i >= 0; i--)
+    if (node_cells[i] >= 0)
+      nodes[--node_offsets[node_cells[i]]] = i;
+  for (int i = m - 1; i >= 0; i--)
+    if (edge_cells[i] >= 0)
+      edges[--edge_offsets[edge_cells[i]]] = i;
+
+  free(node_cells);
+  free(edge_cells);
+  index->layout_version = graph->layout_version;
+  index->valid = 1;
+  return 1;
+}
+
+// Clips segment ab to the rectangle bounds = {min x, min y, max x, max y}
+// (Liang-Barsky). Returns 0 if nothing is left. Keeps coordinates inside the
+// Sint16 range SDL_gfx takes.
+static inline int clip_segment(Vec2f *a, Vec2f *b, const float bounds[4]) {
+  float t0 = 0, t1 = 1;
+  float dx = b->x - a->x, dy = b->y - a->y;
+  float p[4] = {-dx, dx, -dy, dy};
+  float q[4] = {a->x - bounds[0], bounds[2] - a->x, a->y - bounds[1],
+                bounds[3] - a->y};
+  for (int i = 0; i < 4; i++) {
+    if (p[i] == 0) {
+      if (q[i] < 0)
+        return 0;
+      continue;
+    }
+    float t = q[i] / p[i];
+    if (p[i] < 0)
+      t0 = fmaxf(t0, t);
+    else
+      t1 = fminf(t1, t);
+    if (t0 > t1)
+      return 0;
+  }
+  Vec2f start = {a->x + t0 * dx, a->y + t0 * dy};
+  Vec2f end = {a->x + t1 * dx, a->y + t1 * dy};
+  *a = start;
+  *b = end;
+  return 1;
+}
+
+// Copies edge i into batch if it is part of the unselected layer and
+// crosses bounds. World point p lands on pixel p * zoom - origin.
+static inline int gather_layer_edge(const AppState *app, int i, float zoom,
+                                    Vec2f origin, const float bounds[4],
+                                    LayerBatch *batch) {
+  const GraphData *graph = app->graph;
+  int s = graph->edges[i].source;
+  int t = graph->edges[i].target;
+  if (!graph->nodes[s].visible || !graph->nodes[t].visible ||
+      (app->selected_nodes[s] && app->selected_nodes[t]))
+    return 1;
+  Vec2f p1 = {graph->nodes[s].position.x * zoom - origin.x,
+              graph->nodes[s].position.y * zoom - origin.y};
+  Vec2f p2 = {graph->nodes[t].position.x * zoom - origin.x,
+              graph->nodes[t].position.y * zoom - origin.y};
+  if (fminf(p1.x, p2.x) > bounds[2] || fmaxf(p1.x, p2.x) < bounds[0] ||
+      fminf(p1.y, p2.y) > bounds[3] || fmaxf(p1.y, p2.y) < bounds[1])
+    return 1;
+  int arrowhead = p2.x >= bounds[0] && p2.x <= bounds[2] &&
+                  p2.y >= bounds[1] && p2.y <= bounds[3];
+  Vec2f end = p2;
+  if (!clip_segment(&p1, &end, bounds))
+    return 1;
+
+  if (batch->edge_count == batch->edge_capacity) {
+    int capacity = batch->edge_capacity ? 2 * batch->edge_capacity : 256;
+    LayerEdge *edges = realloc(batch->edges, capacity * sizeof(LayerEdge));
+    if (!edges)
+      return 0;
+    batch->edges = edges;
+    batch->edge_capacity = capacity;
+  }
+  batch->edges[batch->edge_count++] =
+      (LayerEdge){p1, arrowhead ? p2 : end, edge_direction(graph, i),
+                  arrowhead};
+  return 1;
+}
+
+static inline int gather_layer_node(const AppState *app, int i, float zoom,
+                                    Vec2f origin, const float bounds[4],
+                                    LayerBatch *batch) {
+  const GraphNode *node = &app->graph->nodes[i];
+  if (!node->visible || app->selected_nodes[i])
+    return 1;
+  Vec2f p = {node->position.x * zoom - origin.x,
+             node->position.y * zoom - origin.y};
+  if (p.x < bounds[0] || p.x > bounds[2] || p.y < bounds[1] ||
+      p.y > bounds[3])
+    return 1;
+
+  if (batch->node_count == batch->node_capacity) {
+    int capacity = batch->node_capacity ? 2 * batch->node_capacity : 256;
+    LayerNode *nodes = realloc(batch->nodes, capacity * sizeof(LayerNode));
+    if (!nodes)
+      return 0;
+    batch->nodes = nodes;
+    batch->node_capacity = capacity;
+  }
+  batch->nodes[batch->node_count++] = (LayerNode){p, node_color(node)};
+  return 1;
+}
+
+// Fills batch with the unselected edges and nodes within the pixel
+// rectangle bounds, where world point p lands on p * zoom - origin. Only
+// the cells of the spatial index near the rectangle are visited, or the
+// whole graph when the index is out of date. Returns 0 when out of memory.
+static inline int gather_layer_region(const AppState *app, float zoom,
+                                      Vec2f origin, const float bounds[4],
+                                      LayerBatch *batch) {
+  const GraphData *graph = app->graph;
+  const SpatialIndex *index = &graph->spatial;
+  batch->edge_count = batch->node_count = 0;
+
+  if (!index->valid || index->layout_version != graph->layout_version) {
+    for (int i = 0; i < graph->edge_count; i++)
+      if (!gather_layer_edge(app, i, zoom, origin, bounds, batch))
+        return 0;
+    for (int i = 0; i < graph->node_count; i++)
+      if (!gather_layer_node(app, i, zoom, origin, bounds, batch))
+        return 0;
+    return 1;
+  }
+
+  float x0 = (bounds[0] + origin.x) / zoom, y0 = (bounds[1] + origin.y) / zoom;
+  float x1 = (bounds[2] + origin.x) / zoom, y1 = (bounds[3] + origin.y) / zoom;
+  for (int l = 0; l < index->levels; l++) {
+    // Edges reach one cell past the one they are filed under.
+    float size = ldexpf(index->cell_size, l);
+    int first = spatial_cell(index, l, x0 - size, y0 - size);
+    int last = spatial_cell(index, l, x1, y1);
+    int columns = index->columns[l];
+    int width = (last - index->first_cell[l]) % columns -
+                (first - index->first_cell[l]) % columns;
+    for (int row = first; row <= last; row += columns)
+      for (int c = row; c <= row + width; c++)
+        for (int k = index->edge_offsets[c]; k < index->edge_offsets[c + 1];
+             k++)
+          if (!gather_layer_edge(app, index->edges[k], zoom, origin, bounds,
+                                 batch))
+            return 0;
+  }
+
+  int first = spatial_cell(index, 0, x0, y0);
+  int last = spatial_cell(index, 0, x1, y1);
+  int columns = index->columns[0];
+  int width = last % columns - first % columns;
+  for (int row = first; row <= last; row += columns)
+    for (int c = row; c <= row + width; c++)
+      for (int k = index->node_offsets[c]; k < index->node_offsets[c + 1]; k++)
+        if (!gather_layer_node(app, index->nodes[k], zoom, origin, bounds,
+                               batch))
+          return 0;
+  return 1;
+}
+
+static inline void draw_layer_batch(SDL_Renderer *renderer,
+                                    const LayerBatch *batch, float zoom) {
+  for (int i = 0; i < batch->edge_count; i++) {
+    const LayerEdge *edge = &batch->edges[i];
+    if (edge->arrowhead)
+      render_edge(renderer, edge->start, edge->end, edge->direction, zoom, 200,
+                  200, 200, 255);
+    else
+      lineRGBA(renderer, edge->start.x, edge->start.y, edge->end.x,
+               edge->end.y, 200, 200, 200, 255);
+  }
+  for (int i = 0; i < batch->node_count; i++) {
+    const LayerNode *node = &batch->nodes[i];
+    filledCircleRGBA(renderer, node->position.x, node->position.y,
+                     NODE_RADIUS * zoom, node->color.r, node->color.g,
+                     node->color.b, 255);
+  }
+}
+
+static inline void free_layer_batch(LayerBatch *batch) {
+  free(batch->edges);
+  free(batch->nodes);
+  memset(batch, 0, sizeof(LayerBatch));
+}
+
+// Background rasterizer. Each job copies the edges and nodes near its tile
+// out of the spatial index while holding graph_lock, which the main thread
+// holds while it mutates the graph, then draws them with a software
+// renderer into its own surface. Results from an older cache version are
+// thrown away.
+static int tile_worker(void *data) {
+  AppState *app = data;
+  TileCache *cache = &app->tiles;
+  LayerBatch batch = {0};
+
+  SDL_LockMutex(cache->lock);
+  while (!cache->quit) {
+    if (cache->queue_length == 0) {
+      SDL_CondWait(cache->wake, cache->lock);
+      continue;
+    }
+    int index = cache->queue[0];
+    memmove(cache->queue, cache->queue + 1,
+            --cache->queue_length * sizeof(int));
+    Tile *tile = &cache->tiles[index];
+    int level = tile->level, tile_x = tile->x, tile_y = tile->y;
+    unsigned version = cache->version;
+    tile->state = TILE_RENDERING;
+    SDL_UnlockMutex(cache->lock);
+
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(
+        0, TILE_SIZE, TILE_SIZE, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer *renderer =
+        surface ? SDL_CreateSoftwareRenderer(surface) : NULL;
+    int drawn = 0;
+    if (renderer) {
+      float zoom = tile_level_zoom(level);
+      float margin = (NODE_RADIUS + ARROWHEAD_SIZE) * zoom + 1;
+      float bounds[4] = {-margin, -margin, TILE_SIZE + margin,
+                         TILE_SIZE + margin};
+      Vec2f origin = {(float)tile_x * TILE_SIZE, (float)tile_y * TILE_SIZE};
+      SDL_LockMutex(cache->graph_lock);
+      drawn = gather_layer_region(app, zoom, origin, bounds, &batch);
+      SDL_UnlockMutex(cache->graph_lock);
+      if (drawn) {
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        draw_layer_batch(renderer, &batch, zoom);
+      } else {
+        fprintf(stderr, "Out of memory rasterizing tile\n");
+      }
+      SDL_DestroyRenderer(renderer);
+    }
+
+    SDL_LockMutex(cache->lock);
+    if (drawn && version == cache->version) {
+      tile->surface = surface;
+      tile->state = TILE_RASTERIZED;
+    } else {
+      if (surface)
+        SDL_FreeSurface(surface);
+      if (version == cache->version)
+        unlink_tile(cache, index);
+      tile->state = TILE_FREE;
+    }
+  }
+  SDL_UnlockMutex(cache->lock);
+  free_layer_batch(&batch);
+  return 0;
+}
+
+static inline void start_tile_renderer(AppState *app) {
+  TileCache *cache = &app->tiles;
+  memset(cache, 0, sizeof(TileCache));
+  for (int i = 0; i < TILE_CACHE_MAX_TILES; i++)
+    cache->tiles[i].next = -1;
+  for (int i = 0; i < TILE_HASH_BUCKETS; i++)
+    cache->buckets[i] = -1;
+
+  cache->lock = SDL_CreateMutex();
+  cache->graph_lock = SDL_CreateMutex();
+  cache->wake = SDL_CreateCond();
+  if (!cache->lock || !cache->graph_lock || !cache->wake) {
+    fprintf(stderr, "Failed to create tile renderer locks: %s\n",
+            SDL_GetError());
+    return;
+  }
+  cache->thread = SDL_CreateThread(tile_worker, "tile_worker", app);
+  if (!cache->thread)
+    fprintf(stderr, "Failed to start tile renderer: %s\n", SDL_GetError());
+}
+
+static inline void stop_tile_renderer(AppState *app) {
+  TileCache *cache = &app->tiles;
+  if (cache->thread) {
+    SDL_LockMutex(cache->lock);
+    cache->quit = 1;
+    SDL_CondSignal(cache->wake);
+    SDL_UnlockMutex(cache->lock);
+    SDL_WaitThread(cache->thread, NULL);
+    cache->thread = NULL;
+  }
+  for (int i = 0; i < TILE_CACHE_MAX_TILES; i++) {
+    cache->tiles[i].state = TILE_FREE;
+    release_tile(cache, i);
+  }
+  if (cache->wake)
+    SDL_DestroyCond(cache->wake);
+  if (cache->graph_lock)
+    SDL_DestroyMutex(cache->graph_lock);
+  if (cache->lock)
+    SDL_DestroyMutex(cache->lock);
+  cache->wake = NULL;
+  cache->graph_lock = NULL;
+  cache->lock = NULL;
+  free_layer_batch(&cache->holes);
+}
+
+// Uploads tiles the worker finished since the last frame. Returns the
+// number of new textures. Caller holds cache->lock.
+static inline int upload_finished_tiles(SDL_Renderer *renderer,
+                                        TileCache *cache) {
+  int uploaded = 0;
+  for (int i = 0; i < TILE_CACHE_MAX_TILES; i++) {
+    Tile *tile = &cache->tiles[i];
+    if (tile->state != TILE_RASTERIZED)
+      continue;
+    tile->texture = SDL_CreateTextureFromSurface(renderer, tile->surface);
+    SDL_FreeSurface(tile->surface);
+    tile->surface = NULL;
+    if (!tile->texture) {
+      unlink_tile(cache, i);
+      tile->state = TILE_FREE;
+      continue;
+    }
+    tile->state = TILE_READY;
+    uploaded++;
+  }
+  return uploaded;
+}
+
+static inline void request_tile(TileCache *cache, int level, int x, int y) {
+  int index = find_tile(cache, level, x, y);
+  if (index == -1)
+    index = allocate_tile(cache, level, x, y);
+  if (index == -1)
+    return;
+  cache->tiles[index].last_used = cache->frame;
+  if (cache->tiles[index].state == TILE_FREE) {
+    cache->tiles[index].state = TILE_QUEUED;
+    cache->queue[cache->queue_length++] = index;
+  }
+}
+
+// Composes the graph area from cached tiles at the level nearest to the
+// current zoom, scaled to the exact zoom. Missing tiles are queued for the
+// worker, along with a one-tile ring around the view so that panning mostly
+// hits the cache. Until they arrive a cached tile from a coarser level
+// stands in, and whatever is still uncovered is drawn directly.
+static inline void render_tiled_graph_layer(SDL_Renderer *renderer,
+                                            AppState *app) {
+  TileCache *cache = &app->tiles;
+  int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
+  int graph_width = GRAPH_WIDTH(app->window_width);
+  float zoom = app->camera.zoom;
+  float offset_x = left_menu_width + (float)graph_width / 2;
+  float offset_y = (float)app->window_height / 2;
+
+  int level = tile_level_for_zoom(zoom);
+  float level_zoom = tile_level_zoom(level);
+  float scale = zoom / level_zoom; // Screen pixels per tile pixel
+
+  // Tile range covering the graph area, in level pixel coordinates.
+  float min_x = ((left_menu_width - offset_x) / zoom - app->camera.position.x) *
+                level_zoom;
+  float max_x = ((left_menu_width + graph_width - offset_x) / zoom -
+                 app->camera.position.x) *
+                level_zoom;
+  float min_y = ((0 - offset_y) / zoom - app->camera.position.y) * level_zoom;
+  float max_y = ((app->window_height - offset_y) / zoom -
+                 app->camera.position.y) *
+                level_zoom;
+  int first_x = (int)floorf(min_x / TILE_SIZE);
+  int last_x = (int)floorf(max_x / TILE_SIZE);
+  int first_y = (int)floorf(min_y / TILE_SIZE);
+  int last_y = (int)floorf(max_y / TILE_SIZE);
+
+  SDL_LockMutex(cache->lock);
+  cache->frame++;
+
+  // Only tiles visible now are worth rasterizing; forget stale requests.
+  for (int i = 0; i < cache->queue_length; i++) {
+    unlink_tile(cache, cache->queue[i]);
+    cache->tiles[cache->queue[i]].state = TILE_FREE;
+  }
+  cache->queue_length = 0;
+
+  float hole_min_x = INFINITY, hole_min_y = INFINITY;
+  float hole_max_x = -INFINITY, hole_max_y = -INFINITY;
+
+  for (int ty = first_y; ty <= last_y; ty++) {
+    for (int tx = first_x; tx <= last_x; tx++) {
+      SDL_FRect dest = {
+          (tx * (float)TILE_SIZE / level_zoom + app->camera.position.x) *
+                  zoom +
+              offset_x,
+          (ty * (float)TILE_SIZE / level_zoom + app->camera.position.y) *
+                  zoom +
+              offset_y,
+          TILE_SIZE * scale, TILE_SIZE * scale};
+
+      int index = find_tile(cache, level, tx, ty);
+      if (index != -1 && cache->tiles[index].state == TILE_READY) {
+        cache->tiles[index].last_used = cache->frame;
+        SDL_RenderCopyF(renderer, cache->tiles[index].texture, NULL, &dest);
+        continue;
+      }
+
+      request_tile(cache, level, tx, ty);
+
+      // Cover the hole with the part of a coarser tile that contains it.
+      int covered = 0;
+      for (int octave = 1; octave <= TILE_FALLBACK_OCTAVES; octave++) {
+        int shift = 1 << octave;
+        int coarse =
+            find_tile(cache, level - octave * TILE_LEVELS_PER_OCTAVE,
+                      floor_div(tx, shift), floor_div(ty, shift));
+        if (coarse == -1 || cache->tiles[coarse].state != TILE_READY)
+          continue;
+        int part = TILE_SIZE / shift;
+        SDL_Rect src = {(tx - floor_div(tx, shift) * shift) * part,
+                        (ty - floor_div(ty, shift) * shift) * part, part,
+                        part};
+        cache->tiles[coarse].last_used = cache->frame;
+        SDL_RenderCopyF(renderer, cache->tiles[coarse].texture, &src, &dest);
+        covered = 1;
+        break;
+      }
+
+      if (!covered) {
+        hole_min_x = fminf(hole_min_x, dest.x);
+        hole_min_y = fminf(hole_min_y, dest.y);
+        hole_max_x = fmaxf(hole_max_x, dest.x + dest.w);
+        hole_max_y = fmaxf(hole_max_y, dest.y + dest.h);
+      }
+    }
+  }
+
+  for (int ty = first_y - 1; ty <= last_y + 1; ty++)
+    for (int tx = first_x - 1; tx <= last_x + 1; tx++)
+      if (ty < first_y || ty > last_y || tx < first_x || tx > last_x)
+        request_tile(cache, level, tx, ty);
+
+  if (cache->queue_length)
+    SDL_CondSignal(cache->wake);
+  SDL_UnlockMutex(cache->lock);
+
+  if (hole_min_x < hole_max_x) {
+    SDL_Rect hole = {(int)floorf(hole_min_x), (int)floorf(hole_min_y),
+                     (int)ceilf(hole_max_x - floorf(hole_min_x)),
+                     (int)ceilf(hole_max_y - floorf(hole_min_y))};
+    // Only the index cells under the hole are drawn, at the exact zoom.
+    float margin = (NODE_RADIUS + ARROWHEAD_SIZE) * zoom + 1;
+    float bounds[4] = {hole.x - margin, hole.y - margin,
+                       hole.x + hole.w + margin, hole.y + hole.h + margin};
+    Vec2f origin = {-(app->camera.position.x * zoom + offset_x),
+                    -(app->camera.position.y * zoom + offset_y)};
+    if (gather_layer_region(app, zoom, origin, bounds, &cache->holes)) {
+      SDL_RenderSetClipRect(renderer, &hole);
+      draw_layer_batch(renderer, &cache->holes, zoom);
+      SDL_RenderSetClipRect(renderer, NULL);
+    } else {
+      fprintf(stderr, "Out of memory drawing the graph layer\n");
+    }
+  }
+}
+
+static inline void invalidate_graph_layer(AppState *app) {
+  app->graph_layer.valid = 0;
+  if (app->tiles.lock) {
+    SDL_LockMutex(app->tiles.lock);
+    clear_tiles(&app->tiles);
+    SDL_UnlockMutex(app->tiles.lock);
+  }
+}
+
+static inline void free_graph_layer(GraphLayerCache *cache) {
+  if (cache->texture)
+    SDL_DestroyTexture(cache->texture);
+  memset(cache, 0, sizeof(GraphLayerCache));
+}
+
+// Copies the cached graph layer to the screen, re-rasterizing it first if
+// anything it depends on changed. Returns 0 if render targets are
+// unavailable, in which case the caller draws the layer directly.
+static inline int composite_graph_layer(SDL_Renderer *renderer, AppState *app,
+                                        Uint8 detail_alpha) {
+  GraphLayerCache *cache = &app->graph_layer;
+  TileCache *tiles = &app->tiles;
+  int tiled = tiles->thread && detail_alpha == 255;
+
+  if (!SDL_RenderTargetSupported(renderer))
+    return 0;
+
+  if (tiles->thread) {
+    SDL_LockMutex(tiles->lock);
+    if (tiles->layout_version != app->graph->layout_version) {
+      clear_tiles(tiles);
+      tiles->layout_version = app->graph->layout_version;
+    }
+    if (upload_finished_tiles(renderer, tiles) && tiled)
+      cache->valid = 0;
+    SDL_UnlockMutex(tiles->lock);
+  }
+
+  if (!cache->texture || cache->width != app->window_width ||
+      cache->height != app->window_height) {
+    free_graph_layer(cache);
+    cache->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                       SDL_TEXTUREACCESS_TARGET,
+                                       app->window_width, app->window_height);
+    if (!cache->texture) {
+      fprintf(stderr, "Failed to create graph layer texture: %s\n",
+              SDL_GetError());
+      return 0;
+    }
+    cache->width = app->window_width;
+    cache->height = app->window_height;
+  }
+
+  if (!cache->valid || cache->camera.zoom != app->camera.zoom ||
+      cache->camera.position.x != app->camera.position.x ||
+      cache->camera.position.y != app->camera.position.y ||
+      cache->layout_version != app->graph->layout_version) {
+    if (SDL_SetRenderTarget(renderer, cache->texture) != 0) {
+      fprintf(stderr, "Failed to set render target: %s\n", SDL_GetError());
+      return 0;
+    }
+    // The layer is the first thing drawn each frame, so an opaque black
+    // background composites exactly like drawing straight to the screen.
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    if (tiled)
+      render_tiled_graph_layer(renderer, app);
+    else
+      render_graph_layer(renderer, app, detail_alpha);
+    SDL_SetRenderTarget(renderer, NULL);
+
+    cache->valid = 1;
+    cache->camera = app->camera;
+    cache->layout_version = app->graph->layout_version;
+  }
+
+  SDL_RenderCopy(renderer, cache->texture, NULL, NULL);
+  return 1;
+}
+
+static inline void render_graph(SDL_Renderer *renderer, AppState *app) {
+  update_edge_directions(app->graph);
+  Vec2f *screen = app->screen_positions;
+
+  // 0 at or below LOD_ZOOM_THRESHOLD, 1 at or above LOD_FADE_ZOOM.
+  float detail = (app->camera.zoom - LOD_ZOOM_THRESHOLD) /
+                 (LOD_FADE_ZOOM - LOD_ZOOM_THRESHOLD);
+  detail = fmaxf(0.0f, fminf(1.0f, detail));
+  Uint8 detail_alpha = (Uint8)(detail * 255);
+
+  if (!composite_graph_layer(renderer, app, detail_alpha))
+    render_graph_layer(renderer, app, detail_alpha);
+
+  // Third pass: Render highlighted edges
+  for (int i = 0; detail_alpha && i < app->graph->edge_count; i++) {
+    GraphNode *source = &app->graph->nodes[app->graph->edges[i].source];
+    GraphNode *target = &app->graph->nodes[app->graph->edges[i].target];
+
+    if (!source->visible || !target->visible)
+      continue;
+
+    int both_selected = app->selected_nodes[app->graph->edges[i].source] &&
+                        app->selected_nodes[app->graph->edges[i].target];
+
+    if (!both_selected)
+      continue; // Skip non-highlighted edges in this pass
+
+    render_edge(renderer, screen[app->graph->edges[i].source],
+                screen[app->graph->edges[i].target],
+                edge_direction(app->graph, i),
+                app->camera.zoom, 255, 0, 0, detail_alpha);
+  }
+
+  // Minimum cut edges, with the attribute each reference is held by
+  for (int k = 0; detail_alpha && k < app->cut_length; k++) {
+    const GraphEdge *edge = &app->graph->edges[app->cut_edges[k]];
+    if (!app->graph->nodes[edge->source].visible ||
+        !app->graph->nodes[edge->target].visible)
+      continue;
+    Vec2f p1 = screen[edge->source];
+    Vec2f p2 = screen[edge->target];
+    thickLineRGBA(renderer, p1.x, p1.y, p2.x, p2.y, 3, 255, 200, 0,
+                  detail_alpha);
+    if (k < MAX_CUT_LABELS && edge->label && edge->label[0])
+      render_label(renderer, edge->label, (p1.x + p2.x) / 2,
+                   (p1.y + p2.y) / 2, app->font_small,
+                   (SDL_Color){255, 200, 0, 255}, 200);
+  }
+
+  // Fourth pass: Render highlighted nodes
+  for (int i = 0; detail_alpha && i < app->graph->node_count; i++) {
+    if (!app->graph->nodes[i].visible || !app->selected_nodes[i])
+      continue;
+
+    filledCircleRGBA(renderer, screen[i].x, screen[i].y,
+                     NODE_RADIUS * app->camera.zoom, 255, 0, 0,
+                     detail_alpha);
+  }
+
+  // Final pass: Render hover labels
+  if (app->hovered_node != -1) {
+    int x = screen[app->hovered_node].x;
+    int y = screen[app->hovered_node].y;
+    render_hover_label(renderer, app,
+                       app->graph->nodes[app->hovered_node].label, x + 10,
+                       y - 20);
+  } else if (app->hovered_edge != -1) {
+    Vec2f p1 = screen[app->graph->edges[app->hovered_edge].source];
+    Vec2f p2 = screen[app->graph->edges[app->hovered_edge].target];
+
+    int label_x = (p1.x + p2.x) / 2;
+    int label_y = (p1.y + p2.y) / 2;
+    render_hover_label(renderer, app,
+                       app->graph->edges[app->hovered_edge].label, label_x,
+                       label_y);
+  }
+}
+
+static inline void render_label(SDL_Renderer *renderer, const char *text, int x,
+                                int y, TTF_Font *font, SDL_Color color,
+                                int max_width) {
+  SDL_Surface *surface = TTF_RenderText_Solid(font, text, color);
+  SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+
+  SDL_Rect rect;
+  rect.x = x;
+  rect.y = y;
+  SDL_QueryTexture(texture, NULL, NULL, &rect.w, &rect.h);
+
+  if (rect.w > max_width) {
+    SDL_Rect src_rect = {0, 0, max_width, rect.h};
+    rect.w = max_width;
+    SDL_RenderCopy(renderer, texture, &src_rect, &rect);
+  } else {
+    SDL_RenderCopy(renderer, texture, NULL, &rect);
+  }
+
+  SDL_FreeSurface(surface);
+  SDL_DestroyTexture(texture);
+}
+
+static inline SDL_Rect render_scrollbar(SDL_Renderer *renderer, int x, int y,
+                                        int width, int height, int total_items,
+                                        int visible_items,
+                                        int scroll_position) {
+  int content_height = total_items * 20; // Assuming each item is 20 pixels high
+  float visible_ratio = (float)height / content_height;
+  int scrollbar_height = (int)(visible_ratio * height);
+  scrollbar_height = (scrollbar_height < 20)
+                         ? 20
+                         : scrollbar_height; // Minimum scrollbar height
+
+  int max_scroll = content_height - height;
+  float scroll_ratio =
+      (max_scroll > 0) ? (float)scroll_position / max_scroll : 0;
+  int scrollbar_y = y + (int)(scroll_ratio * (height - scrollbar_height));
+
+  SDL_Rect scrollbar_bg = {x, y, width, height};
+  if (renderer) {
+    SDL_SetRenderDrawColor(renderer, 70, 70, 70, 255);
+    SDL_RenderFillRect(renderer, &scrollbar_bg);
+
+    SDL_Rect scrollbar_handle = {x, scrollbar_y, width, scrollbar_height};
+    SDL_SetRenderDrawColor(renderer, 150, 150, 150, 255);
+    SDL_RenderFillRect(renderer, &scrollbar_handle);
+  }
+
+  return scrollbar_bg; // Return the entire scrollbar area
+}
+
+static inline void handle_menu_scroll(int *scroll_position, int scroll_amount,
+                                      int total_items, int visible_items,
+                                      int item_height) {
+  int max_scroll = fmax(0, (total_items - visible_items) * item_height);
+  *scroll_position =
+      fmax(0, fmin(*scroll_position - scroll_amount, max_scroll));
+
+  // Ensure we don't scroll past the end of the content
+  if (*scroll_position > max_scroll) {
+    *scroll_position = max_scroll;
+  }
+}
+
+static inline int is_mouse_over_menu_item(int mouseX, int mouseY, int itemY,
+                                          int menuX, int menuWidth,
+                                          int itemHeight) {
+  return mouseX >= menuX && mouseX <= menuX + menuWidth && mouseY >= itemY &&
+         mouseY < itemY + itemHeight;
+}
+
+static inline void render_menu_item(SDL_Renderer *renderer, const char *text,
+                                    int x, int y, int width, int height,
+                                    SDL_Color bg_color, SDL_Color text_color,
+                                    TTF_Font *font) {
+  SDL_Rect bg_rect = {x, y, width, height};
+  SDL_SetRenderDrawColor(renderer, bg_color.r, bg_color.g, bg_color.b,
+                         bg_color.a);
+  SDL_RenderFillRect(renderer, &bg_rect);
+  render_label(renderer, text, x + 5, y + (height - TTF_FontHeight(font)) / 2,
+               font, text_color, width - 10);
+}
+
+// Entry k of the left menu's "Selected Objects" list, or -1 past its end:
+// the node and then the holder of each cut edge when a cut is selected, the
+// node and then one entry per cycle (standing for the node after it) when
+// cycles are, the path in order when one is selected, otherwise every node
+// by id. Callers skip nodes that are unselected or hidden.
+static inline int left_menu_node(const AppState *app, int k) {
+  const CycleSearch *search = &app->cycles;
+  if (search->node >= 0) {
+    if (k == 0)
+      return search->node;
+    return k <= search->cycle_count
+               ? app->graph
+                     ->edges[search->cycle_edges[search->cycle_starts[k - 1]]]
+                     .target
+               : -1;
+  }
+  if (app->cut_length) {
+    if (k == 0)
+      return app->cut_node;
+    return k <= app->cut_length
+               ? app->graph->edges[app->cut_edges[k - 1]].source
+               : -1;
+  }
+  if (app->path_length)
+    return k < app->path_length ? app->path[k] : -1;
+  return k < app->graph->node_count ? k : -1;
+}
+
+// Path entries after the root also name the reference that leads to them;
+// cut entries name the reference they hold, cycle entries every reference
+// around the cycle.
+static inline void format_left_menu_entry(const AppState *app, int k,
+                                          char *buffer, size_t size) {
+  const GraphNode *node = &app->graph->nodes[left_menu_node(app, k)];
+  const CycleSearch *search = &app->cycles;
+  if (search->node >= 0 && k > 0) {
+    size_t used = snprintf(buffer, size, "%d", search->node);
+    for (int c = search->cycle_starts[k - 1];
+         c < search->cycle_starts[k] && used < size; c++) {
+      const GraphEdge *edge = &app->graph->edges[search->cycle_edges[c]];
+      used += snprintf(buffer + used, size - used, " -%s-> %d", edge->label,
+                       edge->target);
+    }
+  } else if (app->cut_length && k > 0) {
+    const GraphEdge *edge = &app->graph->edges[app->cut_edges[k - 1]];
+    snprintf(buffer, size, "%d: %s -%s-> %d", node->id, node->label,
+             edge->label, edge->target);
+  } else if (app->path_length && k > 0)
+    snprintf(buffer, size, "-%s-> %d: %s",
+             app->graph->edges[app->path_edges[k - 1]].label, node->id,
+             node->label);
+  else
+    snprintf(buffer, size, "%d: %s", node->id, node->label);
+}
+
+static inline void render_left_menu(SDL_Renderer *renderer, AppState *app) {
+  int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
+  int detail_area_height = app->window_height * 0.4;
+  int scrollbar_width = 15;
+  int title_height = 50;
+  int padding = 10;
+  int button_height = 30;
+
+  // Render left menu background
+  SDL_Rect left_menu_rect = {0, 0, left_menu_width, app->window_height};
+  SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
+  SDL_RenderFillRect(renderer, &left_menu_rect);
+
+  // Render mode button
+  SDL_Rect mode_button_rect = {10, 10, left_menu_width - 20, button_height};
+  SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
+  SDL_RenderFillRect(renderer, &mode_button_rect);
+
+  char mode_text[50];
+  snprintf(mode_text, sizeof(mode_text), "Mode: %s",
+           selection_mode_names[app->selection_mode]);
+  render_label(renderer, mode_text, 15, 15, app->font_small, COLOR_WHITE,
+               left_menu_width - 30);
+
+  // Render filter referenced button
+  SDL_Rect filter_button_rect = {10, 50, left_menu_width - 20, button_height};
+  SDL_SetRenderDrawColor(renderer, app->filter_referenced ? 150 : 100, 100, 100,
+                         255);
+  SDL_RenderFillRect(renderer, &filter_button_rect);
+  render_label(renderer, "Show only selected", 15, 55, app->font_small,
+               COLOR_WHITE, left_menu_width - 30);
+
+  // Render sort button
+  SDL_Rect sort_button_rect = {10, 90, left_menu_width - 20, button_height};
+  SDL_SetRenderDrawColor(renderer, app->sort_by_retained ? 150 : 100, 100, 100,
+                         255);
+  SDL_RenderFillRect(renderer, &sort_button_rect);
+  render_label(renderer, "Sort by retained size", 15, 95, app->font_small,
+               COLOR_WHITE, left_menu_width - 30);
+
+  // Render unreachable button
+  SDL_Rect unreachable_button_rect = {10, 130, left_menu_width - 20,
+                                      button_height};
+  SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
+  SDL_RenderFillRect(renderer, &unreachable_button_rect);
+  render_label(renderer, "Select unreachable", 15, 135, app->font_small,
+               COLOR_WHITE, left_menu_width - 30);
+
+  // Render group by type button
+  SDL_Rect group_button_rect = {10, 170, left_menu_width - 20, button_height};
+  SDL_SetRenderDrawColor(renderer, app->group_by_type ? 150 : 100, 100, 100,
+                         255);
+  SDL_RenderFillRect(renderer, &group_button_rect);
+  render_label(renderer,
+               app->types.selected_only && app->group_by_type
+                   ? "Group selection by type"
+                   : "Group by type",
+               15, 175, app->font_small,
+               COLOR_WHITE, left_menu_width - 30);
+
+  // Render type summary button
+  SDL_Rect summary_button_rect = {10, 210, left_menu_width - 20,
+                                  button_height};
+  int types_shown = app->summary.full && app->summary.kind == SUMMARY_TYPES;
+  int components_shown =
+      app->summary.full && app->summary.kind == SUMMARY_COMPONENTS;
+  int chains_shown = app->summary.full && app->summary.kind == SUMMARY_CHAINS;
+  SDL_SetRenderDrawColor(renderer, types_shown ? 150 : 100, 100, 100, 255);
+  SDL_RenderFillRect(renderer, &summary_button_rect);
+  render_label(renderer, "Type summary", 15, 215, app->font_small, COLOR_WHITE,
+               left_menu_width - 30);
+
+  // Render condensation button
+  SDL_Rect condense_button_rect = {10, 250, left_menu_width - 20,
+                                   button_height};
+  SDL_SetRenderDrawColor(renderer, components_shown ? 150 : 100, 100, 100,
+                         255);
+  SDL_RenderFillRect(renderer, &condense_button_rect);
+  render_label(renderer, "Condense cycles", 15, 255, app->font_small,
+               COLOR_WHITE, left_menu_width - 30);
+
+  // Render chain compression button
+  SDL_Rect chain_button_rect = {10, 290, left_menu_width - 20, button_height};
+  SDL_SetRenderDrawColor(renderer, chains_shown ? 150 : 100, 100, 100, 255);
+  SDL_RenderFillRect(renderer, &chain_button_rect);
+  render_label(renderer, "Compress chains", 15, 295, app->font_small,
+               COLOR_WHITE, left_menu_width - 30);
+
+  // Render edge filter button; right clicks on edges change the filter and
+  // this puts it back
+  SDL_Rect filter_reset_rect = {10, 330, left_menu_width - 20, button_height};
+  SDL_SetRenderDrawColor(renderer, app->filter.follow_count ? 150 : 100, 100,
+                         100, 255);
+  SDL_RenderFillRect(renderer, &filter_reset_rect);
+  char filter_text[64];
+  if (app->filter.follow_count)
+    snprintf(filter_text, sizeof(filter_text), "Following %d labels",
+             app->filter.follow_count);
+  else
+    snprintf(filter_text, sizeof(filter_text), "Skipping %d labels",
+             app->filter.skip_count);
+  render_label(renderer, filter_text, 15, 335, app->font_small, COLOR_WHITE,
+               left_menu_width - 30);
+
+  // Render detail area
+  SDL_Rect detail_rect = {0, app->window_height - detail_area_height,
+                          left_menu_width, detail_area_height};
+  SDL_SetRenderDrawColor(renderer, 70, 70, 70, 255);
+  SDL_RenderFillRect(renderer, &detail_rect);
+
+  // Render "Selected Objects" title
+  SDL_Rect title_bg = {0, app->window_height - detail_area_height,
+                       left_menu_width, title_height};
+  SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
+  SDL_RenderFillRect(renderer, &title_bg);
+  render_label(renderer, "Selected Objects", padding,
+               app->window_height - detail_area_height + padding,
+               app->font_small, COLOR_WHITE, left_menu_width - 2 * padding);
+
+  // Render selected nodes details
+  int y_offset = app->window_height - detail_area_height + title_height;
+  int total_content_height = 0;
+  int selected_count = 0;
+  int item_height = 20;
+
+  for (int k = 0, i; (i = left_menu_node(app, k)) >= 0; k++) {
+    if (app->selected_nodes[i] && app->graph->nodes[i].visible) {
+      selected_count++;
+      char detail_text[MAX_LABEL_LENGTH * 2];
+      format_left_menu_entry(app, k, detail_text, sizeof(detail_text));
+
+      SDL_Surface *text_surface = TTF_RenderText_Blended_Wrapped(
+          app->font_small, detail_text, COLOR_WHITE,
+          left_menu_width - 2 * padding - scrollbar_width);
+      total_content_height += text_surface->h + padding;
+      SDL_FreeSurface(text_surface);
+    }
+  }
+
+  // Render scrollbar
+  int scroll_area_height = detail_area_height - title_height;
+  render_scrollbar(renderer, left_menu_width - scrollbar_width, y_offset,
+                   scrollbar_width, scroll_area_height, selected_count,
+                   scroll_area_height / item_height, app->left_scroll_position);
+
+  // Render visible content
+  SDL_Rect content_area = {0, y_offset, left_menu_width - scrollbar_width,
+                           scroll_area_height};
+  SDL_RenderSetViewport(renderer, &content_area);
+
+  y_offset = -app->left_scroll_position;
+  for (int k = 0, i; (i = left_menu_node(app, k)) >= 0; k++) {
+    if (app->selected_nodes[i] && app->graph->nodes[i].visible) {
+      char detail_text[MAX_LABEL_LENGTH * 2];
+      format_left_menu_entry(app, k, detail_text, sizeof(detail_text));
+
+      // Calculate available width for text
+      int available_width = content_area.w - 10; // Subtract padding
+
+      // Truncate the text if it's too long
+      char truncated_text[MAX_LABEL_LENGTH * 2];
+      int max_chars = available_width / (TTF_FontHeight(app->font_small) /
+                                         2); // More accurate estimate
+      if ((int)strlen(detail_text) > max_chars) {
+        strncpy(truncated_text, detail_text, max_chars);
+        truncated_text[max_chars] = '\0';
+      } else {
+        strcpy(truncated_text, detail_text);
+      }
+
+      SDL_Color bg_color =
+          (selected_count % 2 == 0) ? COLOR_MENU_ITEM_1 : COLOR_MENU_ITEM_2;
+      render_menu_item(renderer, truncated_text, 0, y_offset, content_area.w,
+                       item_height, bg_color, COLOR_WHITE, app->font_small);
+
+      y_offset += item_height;
+      selected_count++;
+    }
+  }
+
+  SDL_RenderSetViewport(renderer, NULL);
+}
+
+// The node shown at position k of the right menu, before hiding invisible
+// ones.
+static inline int right_menu_node(const AppState *app, int k) {
+  return app->sort_by_retained && app->graph->retained_valid
+             ? app->graph->retained_order[k]
+             : k;
+}
+
+// Rows in the right menu: types when grouped by type, else visible nodes.
+static inline int right_menu_length(AppState *app) {
+  return app->group_by_type ? update_type_histogram(app)
+                            : app->visible_nodes_count;
+}
+
+static inline void format_size(char *buffer, size_t size, Uint64 bytes) {
+  const char *units[] = {"B", "KB", "MB", "GB", "TB"};
+  double value = bytes;
+  int unit = 0;
+  while (value >= 1024 && unit < 4) {
+    value /= 1024;
+    unit++;
+  }
+  snprintf(buffer, size, unit ? "%.1f %s" : "%.0f %s", value, units[unit]);
+}
+
+static inline void render_right_menu(SDL_Renderer *renderer, AppState *app) {
+  int right_menu_width = RIGHT_MENU_WIDTH(app->window_width);
+  int right_menu_x = app->window_width - right_menu_width;
+  int scrollbar_width = 15;
+  int search_icon_size = SEARCH_BAR_HEIGHT;
+
+  // Render right menu background
+  SDL_Rect menu_rect = {right_menu_x, 0, right_menu_width, app->window_height};
+  SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
+  SDL_RenderFillRect(renderer, &menu_rect);
+
+  // Render search box
+  SDL_Rect search_rect = {right_menu_x + 5, 5,
+                          right_menu_width - 10 - search_icon_size,
+                          SEARCH_BAR_HEIGHT};
+  SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+  SDL_RenderFillRect(renderer, &search_rect);
+
+  render_label(renderer, app->search_bar.text, right_menu_x + 10, 10,
+               app->font_small, COLOR_BLACK,
+               right_menu_width - 20 - search_icon_size);
+
+  // Render search icon
+  SDL_Rect search_icon_rect = {app->window_width - search_icon_size, 5,
+                               search_icon_size, search_icon_size};
+  SDL_SetRenderDrawColor(renderer, 200, 200, 200, 255);
+  SDL_RenderFillRect(renderer, &search_icon_rect);
+
+  // Draw a simple magnifying glass icon
+  int icon_center_x = search_icon_rect.x + search_icon_size / 2;
+  int icon_center_y = search_icon_rect.y + search_icon_size / 2;
+  int circle_radius = search_icon_size / 3;
+  circleRGBA(renderer, icon_center_x, icon_center_y, circle_radius, 100, 100,
+             100, 255);
+  thickLineRGBA(renderer, icon_center_x + circle_radius - 2,
+                icon_center_y + circle_radius - 2,
+                icon_center_x + search_icon_size / 2 - 2,
+                icon_center_y + search_icon_size / 2 - 2, 3, 100, 100, 100,
+                255);
+
+  // Render node list
+  int y_offset = SEARCH_BAR_HEIGHT + 10;
+  int nodes_rendered = 0;
+  int item_height = 20;
+
+  // Render scrollbar
+  int scroll_area_height = app->window_height - SEARCH_BAR_HEIGHT - 20;
+  render_scrollbar(renderer, app->window_width - scrollbar_width,
+                   SEARCH_BAR_HEIGHT + 10, scrollbar_width, scroll_area_height,
+                   right_menu_length(app), scroll_area_height / item_height,
+                   app->right_scroll_position);
+
+  // Render visible content
+  SDL_Rect content_area = {right_menu_x, y_offset,
+                           right_menu_width - scrollbar_width,
+                           scroll_area_height};
+  SDL_RenderSetViewport(renderer, &content_area);
+
+  if (app->group_by_type) {
+    const TypeHistogram *types = &app->types;
+    int type_sizes = 0;
+    for (int k = 0; k < types->length && !type_sizes; k++)
+      type_sizes = types->rows[k].size != 0;
+    y_offset = -app->right_scroll_position;
+    for (int k = 0; k < types->length; k++) {
+      const TypeCount *row = &types->rows[k];
+      char row_text[MAX_LABEL_LENGTH + 64];
+      char size[32] = "";
+      if (type_sizes)
+        format_size(size, sizeof(size), row->size);
+      snprintf(row_text, sizeof(row_text), "%d  %s%s%s", row->count, size,
+               type_sizes ? "  " : "", type_name(app->graph, row->type));
+
+      SDL_Color bg_color =
+          (k % 2 == 0) ? COLOR_MENU_ITEM_1 : COLOR_MENU_ITEM_2;
+      if (k == app->right_menu_hovered_item)
+        bg_color = (SDL_Color){100, 100, 100, 255};
+      render_menu_item(renderer, row_text, 0, y_offset, content_area.w,
+                       item_height, bg_color, COLOR_WHITE, app->font_small);
+      y_offset += item_height;
+    }
+    SDL_RenderSetViewport(renderer, NULL);
+    return;
+  }
+
+  int show_retained = app->sort_by_retained && app->graph->retained_valid;
+  int has_sizes = 0;
+  for (int i = 0; show_retained && i < app->graph->node_count && !has_sizes;
+       i++)
+    has_sizes = app->graph->nodes[i].size != 0;
+
+  y_offset = -app->right_scroll_position;
+  for (int k = 0; k < app->graph->node_count; k++) {
+    int i = right_menu_node(app, k);
+    if (app->graph->nodes[i].visible) {
+      char node_text[MAX_LABEL_LENGTH + 40];
+      if (show_retained) {
+        char retained[32];
+        if (has_sizes)
+          format_size(retained, sizeof(retained),
+                      app->graph->nodes[i].retained);
+        else
+          snprintf(retained, sizeof(retained), "%llu objects",
+                   (unsigned long long)app->graph->nodes[i].retained);
+        snprintf(node_text, sizeof(node_text), "%s  %d: %s", retained,
+                 app->graph->nodes[i].id, app->graph->nodes[i].label);
+      } else {
+        snprintf(node_text, sizeof(node_text), "%d: %s",
+                 app->graph->nodes[i].id, app->graph->nodes[i].label);
+      }
+
+      SDL_Color bg_color =
+          (nodes_rendered % 2 == 0) ? COLOR_MENU_ITEM_1 : COLOR_MENU_ITEM_2;
+
+      // Highlight hovered item
+      if (nodes_rendered == app->right_menu_hovered_item) {
+        bg_color = (SDL_Color){100, 100, 100, 255}; // Lighter color for hover
+      }
+
+      render_menu_item(renderer, node_text, 0, y_offset, content_area.w,
+                       item_height, bg_color, COLOR_WHITE, app->font_small);
+
+      y_offset += item_height;
+      nodes_rendered++;
+    }
+  }
+
+  SDL_RenderSetViewport(renderer, NULL);
+}
+
+static inline void handle_input(SDL_Event *event, AppState *app) {
+  int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
+  int right_menu_width = RIGHT_MENU_WIDTH(app->window_width);
+
+  switch (event->type) {
+  case SDL_MOUSEMOTION:
+    app->mouse_position.x = event->motion.x;
+    app->mouse_position.y = event->motion.y;
+
+    // Handle scrollbar dragging
+    if (app->is_dragging_left_scrollbar) {
+      int drag_distance = event->motion.y - app->drag_start_y;
+      int scroll_area_height = app->window_height * 0.4 - 50;
+      int max_scroll = app->visible_nodes_count * 20 - scroll_area_height;
+      app->left_scroll_position =
+          app->drag_start_scroll +
+          (drag_distance * max_scroll) / scroll_area_height;
+      app->left_scroll_position =
+          fmax(0, fmin(app->left_scroll_position, max_scroll));
+    } else if (app->is_dragging_right_scrollbar) {
+      int drag_distance = event->motion.y - app->drag_start_y;
+      int scroll_area_height = app->window_height - SEARCH_BAR_HEIGHT - 20;
+      int max_scroll = right_menu_length(app) * 20 - scroll_area_height;
+      app->right_scroll_position =
+          app->drag_start_scroll +
+          (drag_distance * max_scroll) / scroll_area_height;
+      app->right_scroll_position =
+          fmax(0, fmin(app->right_scroll_position, max_scroll));
+    } else {
+      // Reset hover states
+      app->hovered_node = -1;
+      app->hovered_edge = -1;
+      app->right_menu_hovered_item = -1;
+
+      int right_menu_x = app->window_width - right_menu_width;
+
+      // Check for right menu hover
+      if (app->mouse_position.x >= right_menu_x && app->group_by_type) {
+        int offset = app->mouse_position.y - (SEARCH_BAR_HEIGHT + 10) +
+                     app->right_scroll_position;
+        if (app->mouse_position.y >= SEARCH_BAR_HEIGHT + 10 &&
+            offset / 20 < update_type_histogram(app))
+          app->right_menu_hovered_item = offset / 20;
+      } else if (app->mouse_position.x >= right_menu_x) {
+        int y_offset = SEARCH_BAR_HEIGHT + 10 - app->right_scroll_position;
+        int item_height = 20;
+        int nodes_rendered = 0;
+        for (int k = 0; k < app->graph->node_count; k++) {
+          if (app->graph->nodes[right_menu_node(app, k)].visible) {
+            if (app->mouse_position.y >= y_offset &&
+                app->mouse_position.y < y_offset + item_height) {
+              app->right_menu_hovered_item = nodes_rendered;
+              break;
+            }
+            y_offset += item_height;
+            nodes_rendered++;
+          }
+        }
+      }
+
+      // Check for node hover (in graph area)
+      if (app->right_menu_hovered_item == -1 &&
+          app->mouse_position.x >= left_menu_width &&
+          app->mouse_position.x < right_menu_x) {
+        for (int i = 0; i < app->graph->node_count; i++) {
+          if (!app->graph->nodes[i].visible)
+            continue;
+
+          float nx = app->screen_positions[i].x;
+          float ny = app->screen_positions[i].y;
+
+          if (sqrt(pow(app->mouse_position.x - nx, 2) +
+                   pow(app->mouse_position.y - ny, 2)) <=
+              NODE_RADIUS * app->camera.zoom) {
+            app->hovered_node = i;
+            break;
+          }
+        }
+      }
+
+      // Check for edge hover (in graph area)
+      if (app->hovered_node == -1 && app->right_menu_hovered_item == -1 &&
+          app->mouse_position.x >= left_menu_width &&
+          app->mouse_position.x < right_menu_x) {
+        for (int i = 0; i < app->graph->edge_count; i++) {
+          GraphNode *source = &app->graph->nodes[app->graph->edges[i].source];
+          GraphNode *target = &app->graph->nodes[app->graph->edges[i].target];
+
+          if (!source->visible || !target->visible)
+            continue;
+
+          float x1 = app->screen_positions[app->graph->edges[i].source].x;
+          float y1 = app->screen_positions[app->graph->edges[i].source].y;
+          float x2 = app->screen_positions[app->graph->edges[i].target].x;
+          float y2 = app->screen_positions[app->graph->edges[i].target].y;
+
+          float d =
+              fabs((y2 - y1) * app->mouse_position.x -
+                   (x2 - x1) * app->mouse_position.y + x2 * y1 - y2 * x1) /
+              sqrt(pow(y2 - y1, 2) + pow(x2 - x1, 2));
+
+          if (d <= 5 * app->camera.zoom &&
+              app->mouse_position.x >= fmin(x1, x2) - 5 * app->camera.zoom &&
+              app->mouse_position.x <= fmax(x1, x2) + 5 * app->camera.zoom &&
+              app->mouse_position.y >= fmin(y1, y2) - 5 * app->camera.zoom &&
+              app->mouse_position.y <= fmax(y1, y2) + 5 * app->camera.zoom) {
+            app->hovered_edge = i;
+            break;
+          }
+        }
+      }
+
+      if (event->motion.state & SDL_BUTTON_LMASK) {
+        // Only move the graph if the mouse is in the graph area
+        int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
+        int right_menu_width = RIGHT_MENU_WIDTH(app->window_width);
+        if (app->mouse_position.x > left_menu_width &&
+            app->mouse_position.x < app->window_width - right_menu_width &&
+            app->mouse_position.y > TOP_BAR_HEIGHT) {
+          app->camera.position.x += event->motion.xrel / app->camera.zoom;
+          app->camera.position.y += event->motion.yrel / app->camera.zoom;
+        }
+      }
+    }
+    break;
+
+  case SDL_MOUSEWHEEL:
+    if (app->mouse_position.x > app->window_width - right_menu_width) {
+      handle_menu_scroll(&app->right_scroll_position, event->wheel.y * 20,
+                         right_menu_length(app), app->nodes_per_page, 20);
+    } else if (app->mouse_position.x < left_menu_width &&
+               app->mouse_position.y >
+                   app->window_height - app->window_height * 0.4) {
+      int selected_count = 0;
+      for (int i = 0; i < app->graph->node_count; i++) {
+        if (app->selected_nodes[i] && app->graph->nodes[i].visible) {
+          selected_count++;
+        }
+      }
+      int visible_items = (app->window_height * 0.4 - 50) / 20;
+      handle_menu_scroll(&app->left_scroll_position, event->wheel.y * 20,
+                         selected_count, visible_items, 20);
+    } else {
+      app->camera.zoom *= (event->wheel.y > 0) ? 1.1f : 0.9f;
+    }
+    break;
+
+  case SDL_MOUSEBUTTONDOWN:
+    if (event->button.button == SDL_BUTTON_LEFT) {
+      int x = event->button.x;
+      int y = event->button.y;
+
+      if (x >= app->open_button.x &&
+          x <= app->open_button.x + app->open_button.w &&
+          y >= app->open_button.y &&
+          y <= app->open_button.y + app->open_button.h) {
+        const char *selected_file = handle_open_button_click();
+        reinitialize_app(app, load_graph(selected_file));
+      } else if (x >= app->compare_button.x &&
+                 x <= app->compare_button.x + app->compare_button.w &&
+                 y >= app->compare_button.y &&
+                 y <= app->compare_button.y + app->compare_button.h) {
+        // Compare the current graph, not its summary, against a later
+        // snapshot.
+        const char *selected_file = handle_open_button_click();
+        GraphData *before =
+            app->summary.full ? app->summary.full : app->graph;
+        GraphData *after = selected_file ? load_graph(selected_file) : NULL;
+        GraphData *diff = after ? diff_graphs(before, after) : NULL;
+        free_graph(after);
+        if (diff)
+          reinitialize_app(app, diff);
+      } else if (x >= 10 && x <= left_menu_width - 10 && y >= 10 && y <= 40) {
+        cycle_selection_mode(app);
+      } else if (x >= 10 && x <= left_menu_width - 10 && y >= 50 && y <= 80) {
+        app->filter_referenced = !app->filter_referenced;
+        update_node_visibility(app);
+      } else if (x >= 10 && x <= left_menu_width - 10 && y >= 90 &&
+                 y <= 120) {
+        app->sort_by_retained = !app->sort_by_retained &&
+                                compute_retained_sizes(app->graph);
+        app->right_scroll_position = 0;
+      } else if (x >= 10 && x <= left_menu_width - 10 && y >= 130 &&
+                 y <= 160) {
+        select_unreachable(app);
+      } else if (x >= 10 && x <= left_menu_width - 10 && y >= 170 &&
+                 y <= 200) {
+        app->group_by_type = !app->group_by_type;
+        app->types.selected_only = 0;
+        app->types.valid = 0;
+        app->right_scroll_position = 0;
+      } else if (x >= 10 && x <= left_menu_width - 10 && y >= 210 &&
+                 y <= 240) {
+        toggle_summary(app, SUMMARY_TYPES);
+      } else if (x >= 10 && x <= left_menu_width - 10 && y >= 250 &&
+                 y <= 280) {
+        toggle_summary(app, SUMMARY_COMPONENTS);
+      } else if (x >= 10 && x <= left_menu_width - 10 && y >= 290 &&
+                 y <= 320) {
+        toggle_summary(app, SUMMARY_CHAINS);
+      } else if (x >= 10 && x <= left_menu_width - 10 && y >= 330 &&
+                 y <= 360) {
+        reset_edge_filter(app);
+        edge_filter_changed(app);
+      } else if (x >= app->window_width - right_menu_width) {
+        int scrollbar_width = 15;
+        // Check if clicking on right scrollbar
+        SDL_Rect right_scrollbar = render_scrollbar(
+            NULL, app->window_width - scrollbar_width, SEARCH_BAR_HEIGHT + 10,
+            scrollbar_width, app->window_height - SEARCH_BAR_HEIGHT - 20,
+            right_menu_length(app) * 20,
+            app->window_height - SEARCH_BAR_HEIGHT - 20,
+            app->right_scroll_position);
+        if (x >= right_scrollbar.x &&
+            x <= right_scrollbar.x + right_scrollbar.w &&
+            y >= right_scrollbar.y &&
+            y <= right_scrollbar.y + right_scrollbar.h) {
+          app->is_dragging_right_scrollbar = 1;
+          app->drag_start_y = y;
+          app->drag_start_scroll = app->right_scroll_position;
+        } else if (x < app->window_width - scrollbar_width &&
+                   app->group_by_type) {
+          // Clicking a type selects all of its instances
+          int offset = y - (SEARCH_BAR_HEIGHT + 10) + app->right_scroll_position;
+          if (y >= SEARCH_BAR_HEIGHT + 10 &&
+              offset / 20 < update_type_histogram(app))
+            select_type(app, app->types.rows[offset / 20].type);
+        } else if (x < app->window_width - scrollbar_width) {
+          // Clicking in the right menu
+          int y_offset = SEARCH_BAR_HEIGHT + 10 - app->right_scroll_position;
+          int nodes_rendered = 0;
+          for (int k = 0; k < app->graph->node_count; k++) {
+            int i = right_menu_node(app, k);
+            if (app->graph->nodes[i].visible) {
+              if (y >= y_offset && y < y_offset + 20) {
+                set_node_selection(app, i);
+                break;
+              }
+              y_offset += 20;
+              nodes_rendered++;
+            }
+          }
+        }
+      } else if (x < left_menu_width &&
+                 y > app->window_height - app->window_height * 0.4) {
+        int scrollbar_width = 15;
+        // Check if clicking on left scrollbar
+        SDL_Rect left_scrollbar = render_scrollbar(
+            NULL, left_menu_width - scrollbar_width,
+            app->window_height - app->window_height * 0.4 + 50, scrollbar_width,
+            app->window_height * 0.4 - 50, app->visible_nodes_count * 20,
+            app->window_height * 0.4 - 50, app->left_scroll_position);
+        if (x >= left_scrollbar.x && x <= left_scrollbar.x + left_scrollbar.w &&
+            y >= left_scrollbar.y && y <= left_scrollbar.y + left_scrollbar.h) {
+          app->is_dragging_left_scrollbar = 1;
+          app->drag_start_y = y;
+          app->drag_start_scroll = app->left_scroll_position;
+        } else if (x < left_menu_width - scrollbar_width) {
+          // Clicking in the left menu's "Selected Objects" section
+          int y_offset = app->window_height - app->window_height * 0.4 + 50 -
+                         app->left_scroll_position;
+          for (int k = 0, i; (i = left_menu_node(app, k)) >= 0; k++) {
+            if (app->selected_nodes[i] && app->graph->nodes[i].visible) {
+              if (y >= y_offset && y < y_offset + 20) {
+                set_node_selection(app, i);
+                break;
+              }
+              y_offset += 20;
+            }
+          }
+        }
+      } else {
+        // Clicking in the graph area; double clicks in a summary expand and
+        // collapse groups, and clicking a chain edge expands the chain
+        if (app->hovered_node != -1 && app->summary.full &&
+            event->button.clicks == 2) {
+          toggle_expansion(app, app->hovered_node);
+        } else if (app->hovered_edge != -1 && app->summary.full &&
+                   app->summary.chain_edges[app->hovered_edge] >= 0) {
+          toggle_group(app, app->summary.chain_edges[app->hovered_edge]);
+        } else if (app->hovered_node != -1) {
+          set_node_selection(app, app->hovered_node);
+        } else if (app->hovered_edge != -1) {
+          set_edge_selection(app, app->hovered_edge);
+        }
+      }
+    } else if (event->button.button == SDL_BUTTON_RIGHT &&
+               app->hovered_edge != -1) {
+      // Right clicking an edge makes traversals skip its label, or with
+      // shift follow only edges labelled like it
+      toggle_edge_label(app, app->hovered_edge,
+                        (SDL_GetModState() & KMOD_SHIFT) != 0);
+    }
+    break;
+
+  case SDL_MOUSEBUTTONUP:
+    if (event->button.button == SDL_BUTTON_LEFT) {
+      app->is_dragging_left_scrollbar = 0;
+      app->is_dragging_right_scrollbar = 0;
+    }
+    break;
+
+  case SDL_TEXTINPUT:
+    if (strlen(app->search_bar.text) < MAX_SEARCH_LENGTH - 1) {
+      strcat(app->search_bar.text, event->text.text);
+      update_node_visibility(app);
+    }
+    break;
+
+  case SDL_KEYDOWN:
+    switch (event->key.keysym.sym) {
+    case SDLK_BACKSPACE:
+      if (strlen(app->search_bar.text) > 0) {
+        app->search_bar.text[strlen(app->search_bar.text) - 1] = '\0';
+        update_node_visibility(app);
+      }
+      break;
+    case SDLK_TAB:
+      cycle_selection_mode(app);
+      break;
+    case SDLK_PAGEUP:
+    case SDLK_PAGEDOWN:
+    case SDLK_HOME:
+    case SDLK_END: {
+      int scroll_amount = 0;
+      int *scroll_position = NULL;
+      int total_items = 0;
+      int visible_items = 0;
+
+      if (app->mouse_position.x > app->window_width - right_menu_width) {
+        scroll_position = &app->right_scroll_position;
+        total_items = app->visible_nodes_count;
+        visible_items = app->nodes_per_page;
+      } else if (app->mouse_position.x < left_menu_width &&
+                 app->mouse_position.y >
+                     app->window_height - app->window_height * 0.4) {
+        scroll_position = &app->left_scroll_position;
+        // Count selected and visible nodes for the left menu
+        for (int i = 0; i < app->graph->node_count; i++) {
+          if (app->selected_nodes[i] && app->graph->nodes[i].visible) {
+            total_items++;
+          }
+        }
+        // Approximate number of visible items in left menu
+        visible_items = (app->window_height * 0.4 - 50) / 20;
+      }
+
+      if (scroll_position) {
+        switch (event->key.keysym.sym) {
+        case SDLK_PAGEUP:
+          scroll_amount = 1;
+          break;
+        case SDLK_PAGEDOWN:
+          scroll_amount = -1;
+          break;
+        case SDLK_HOME:
+          *scroll_position = 0;
+          break;
+        case SDLK_END:
+          *scroll_position = fmax(0, (total_items - visible_items) * 20);
+          break;
+        }
+
+        if (scroll_amount != 0) {
+          int scroll_pixels = scroll_amount * visible_items * 20;
+          handle_menu_scroll(scroll_position, scroll_pixels, total_items,
+                             visible_items, 20);
+        }
+      }
+    } break;
+    }
+    break;
+
+  case SDL_RENDER_TARGETS_RESET:
+    invalidate_graph_layer(app);
+    break;
+
+  case SDL_WINDOWEVENT:
+    if (event->window.event == SDL_WINDOWEVENT_RESIZED) {
+      app->window_width = event->window.data1;
+      app->window_height = event->window.data2;
+      app->nodes_per_page = (app->window_height - SEARCH_BAR_HEIGHT - 20) / 20;
+      update_open_button_position(app);
+    }
+    break;
+  }
+}
+
+static inline void initialize_app(AppState *app, GraphData *graph) {
+  DEBUG_PRINT("Initializing app\n");
+
+  app->graph = graph;
+  if (!app->graph) {
+    fprintf(stderr, "Failed to load graph\n");
+    exit(1);
+  }
+  DEBUG_PRINT("Graph loaded successfully. Node count: %d, Edge count: %d\n",
+              app->graph->node_count, app->graph->edge_count);
+
+  DEBUG_PRINT("Initializing camera\n");
+  app->camera.zoom = 1.0f;
+  app->camera.position = (Vec2f){0, 0};
+
+  DEBUG_PRINT("Getting display mode\n");
+  SDL_DisplayMode dm;
+  if (SDL_GetCurrentDisplayMode(0, &dm) != 0) {
+    fprintf(stderr, "SDL_GetCurrentDisplayMode failed: %s\n", SDL_GetError());
+    exit(1);
+  }
+  DEBUG_PRINT("Display mode: %dx%d\n", dm.w, dm.h);
+
+  app->window_width = dm.w / 2;
+  app->window_height = dm.h / 2;
+  app->nodes_per_page = (app->window_height - SEARCH_BAR_HEIGHT - 20) / 20;
+  DEBUG_PRINT("Window size set to %dx%d, Nodes per page: %d\n",
+              app->window_width, app->window_height, app->nodes_per_page);
+
+  DEBUG_PRINT("Allocating memory for selected nodes\n");
+  app->selected_nodes = calloc(app->graph->node_count, sizeof(int));
+  if (!app->selected_nodes) {
+    fprintf(stderr, "Failed to allocate memory for selected nodes\n");
+    exit(1);
+  }
+
+  DEBUG_PRINT("Allocating memory for screen positions\n");
+  app->screen_positions = malloc(app->graph->node_count * sizeof(Vec2f));
+  if (!app->screen_positions && app->graph->node_count) {
+    fprintf(stderr, "Failed to allocate memory for screen positions\n");
+    exit(1);
+  }
+
+  DEBUG_PRINT("Initializing app state variables\n");
+  app->selection_mode = SELECT_SINGLE;
+  app->right_scroll_position = 0;
+  app->left_scroll_position = 0;
+  app->visible_nodes_count = app->graph->node_count;
+  app->mouse_position = (Vec2f){0, 0};
+  app->filter_referenced = 0;
+  app->sort_by_retained = 0;
+  app->group_by_type = 0;
+  memset(&app->types, 0, sizeof(TypeHistogram));
+  memset(&app->summary, 0, sizeof(GraphSummary));
+  memset(&app->filter, 0, sizeof(EdgeFilter));
+  reset_edge_filter(app);
+  app->graph->filter = &app->filter;
+  app->hovered_edge = -1;
+  app->hovered_node = -1;
+  app->is_dragging_left_scrollbar = 0;
+  app->is_dragging_right_scrollbar = 0;
+  app->drag_start_y = 0;
+  app->drag_start_scroll = 0;
+  memset(&app->density, 0, sizeof(DensityLayer));
+  memset(&app->graph_layer, 0, sizeof(GraphLayerCache));
+  memset(&app->tiles, 0, sizeof(TileCache));
+  memset(&app->node_keys, 0, sizeof(KeyTable));
+  app->free_nodes = NULL;
+  app->free_node_count = 0;
+  seed_node_keys(app);
+  app->path = NULL;
+  app->path_edges = NULL;
+  app->path_length = 0;
+  app->cut_edges = NULL;
+  app->cut_length = 0;
+  app->cut_node = -1;
+  memset(&app->cycles, 0, sizeof(CycleSearch));
+  app->cycles.node = -1;
+
+  DEBUG_PRINT("Loading fonts\n");
+  SDL_RWops *font_rw = SDL_RWFromMem(lemon_ttf, lemon_ttf_len);
+  if (!font_rw) {
+    fprintf(stderr, "Failed to create RWops for font: %s\n", SDL_GetError());
+    exit(1);
+  }
+
+  app->font_small = TTF_OpenFontRW(font_rw, 0, 15);
+  SDL_RWseek(font_rw, 0, RW_SEEK_SET);
+  app->font_medium = TTF_OpenFontRW(font_rw, 0, 30);
+  SDL_RWseek(font_rw, 0, RW_SEEK_SET);
+  app->font_large = TTF_OpenFontRW(font_rw, 1, 45);
+
+  if (!app->font_small || !app->font_medium || !app->font_large) {
+    fprintf(stderr, "TTF_OpenFontRW: %s\n", TTF_GetError());
+    exit(1);
+  }
+
+  memset(app->search_bar.text, 0, MAX_SEARCH_LENGTH);
+
+  int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
+  app->open_button = (SDL_Rect){left_menu_width + 10, 5, OPEN_BUTTON_WIDTH,
+                                TOP_BAR_HEIGHT - 10};
+  update_open_button_position(app);
+  update_screen_positions(app);
+
+  DEBUG_PRINT("Starting tile renderer\n");
+  start_tile_renderer(app);
+
+  DEBUG_PRINT("App initialization complete\n");
+}
+
+static inline void render_top_bar(SDL_Renderer *renderer, AppState *app) {
+  int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
+  int graph_width = GRAPH_WIDTH(app->window_width);
+
+  // Render top bar background
+  SDL_Rect top_bar_rect = {left_menu_width, 0, graph_width, TOP_BAR_HEIGHT};
+  SDL_SetRenderDrawColor(renderer, 70, 70, 70, 255);
+  SDL_RenderFillRect(renderer, &top_bar_rect);
+
+  // Render open button
+  SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
+  SDL_RenderFillRect(renderer, &app->open_button);
+  render_label(renderer, "Open", app->open_button.x + 5, app->open_button.y + 5,
+               app->font_small, COLOR_WHITE, OPEN_BUTTON_WIDTH - 10);
+
+  // Render compare button
+  SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
+  SDL_RenderFillRect(renderer, &app->compare_button);
+  render_label(renderer, "Compare", app->compare_button.x + 5,
+               app->compare_button.y + 5, app->font_small, COLOR_WHITE,
+               COMPARE_BUTTON_WIDTH - 10);
+
+  // Render "apaz's heap viewer" text
+  render_label(renderer, "apaz's heap viewer",
+               left_menu_width + graph_width - 200, 10, app->font_small,
+               (SDL_Color){0, 255, 0, 255}, 190);
+}
+
+static inline void update_open_button_position(AppState *app) {
+  int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
+  app->open_button = (SDL_Rect){left_menu_width + 10, 5, OPEN_BUTTON_WIDTH,
+                                TOP_BAR_HEIGHT - 10};
+  app->compare_button =
+      (SDL_Rect){app->open_button.x + OPEN_BUTTON_WIDTH + 10, 5,
+                 COMPARE_BUTTON_WIDTH, TOP_BAR_HEIGHT - 10};
+}
+
+static inline char *handle_open_button_click(void) {
+  static char selected_file[4096] = {0};
+  FILE *fp;
+  char command[256];
+
+  // Construct the command to run the filepicker binary
+  snprintf(command, sizeof(command), "./filepicker");
+
+  fp = popen(command, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Failed to run filepicker command\n");
+    return NULL;
+  }
+
+  if (fgets(selected_file, sizeof(selected_file) - 1, fp) != NULL) {
+    // Remove newline character if present
+    size_t len = strlen(selected_file);
+    if (len > 0 && selected_file[len - 1] == '\n') {
+      selected_file[len - 1] = '\0';
+    }
+  } else {
+    // No file selected
+    selected_file[0] = '\0';
+  }
+
+  pclose(fp);
+
+  return selected_file[0] != '\0' ? selected_file : NULL;
+}
+
+static inline void cleanup_app(AppState *app) {
+  // The tile worker reads the graph and the selection; stop it first
+  stop_tile_renderer(app);
+  free_graph(app->graph);
+  free(app->selected_nodes);
+  free(app->screen_positions);
+  free_density_layer(&app->density);
+  free_graph_layer(&app->graph_layer);
+  key_table_free(&app->node_keys);
+  free(app->free_nodes);
+  free(app->path);
+  free(app->path_edges);
+  free(app->cut_edges);
+  stop_cycle_search(&app->cycles);
+  free(app->types.rows);
+  free_graph(detach_summary(app));
+  free_edge_filter(&app->filter);
+  TTF_CloseFont(app->font_small);
+  TTF_CloseFont(app->font_medium);
+  TTF_CloseFont(app->font_large);
+}
+
+static inline void reinitialize_app(AppState *app, GraphData *graph) {
+  // Clean up existing resources
+  free_graph(app->graph);
+  free_graph(detach_summary(app)); // A new graph ends the summary
+  free(app->selected_nodes);
+  free(app->screen_positions);
+  key_table_free(&app->node_keys);
+  free(app->free_nodes);
+  app->free_nodes = NULL;
+  app->free_node_count = 0;
+  app->path_length = 0;
+  app->cut_length = 0;
+  stop_cycle_search(&app->cycles);
+
+  // Reinitialize the application
+  app->graph = graph;
+  if (!app->graph) {
+    fprintf(stderr, "Failed to load graph\n");
+    exit(1);
+  }
+  app->graph->filter = &app->filter;
+
+  app->camera.zoom = 1.0f;
+  app->camera.position = (Vec2f){0, 0};
+
+  app->selected_nodes = calloc(app->graph->node_count, sizeof(int));
+  if (!app->selected_nodes) {
+    fprintf(stderr, "Failed to allocate memory for selected nodes\n");
+    exit(1);
+  }
+
+  app->screen_positions = malloc(app->graph->node_count * sizeof(Vec2f));
+  if (!app->screen_positions && app->graph->node_count) {
+    fprintf(stderr, "Failed to allocate memory for screen positions\n");
+    exit(1);
+  }
+
+  app->selection_mode = SELECT_SINGLE;
+  app->right_scroll_position = 0;
+  app->left_scroll_position = 0;
+  app->visible_nodes_count = app->graph->node_count;
+  app->filter_referenced = 0;
+  app->sort_by_retained = 0;
+  app->group_by_type = 0;
+  app->types.valid = 0;
+  app->types.selected_only = 0;
+
+  app->hovered_edge = -1;
+  app->hovered_node = -1;
+
+  app->is_dragging_left_scrollbar = 0;
+  app->is_dragging_right_scrollbar = 0;
+  app->drag_start_y = 0;
+  app->drag_start_scroll = 0;
+
+  memset(app->search_bar.text, 0, MAX_SEARCH_LENGTH);
+
+  update_node_visibility(app);
+  update_open_button_position(app);
+  update_screen_positions(app);
+}
+
+// Grows the graph, and the app arrays indexed by node, to hold at least
+// node_count nodes and edge_count edges.
+static inline int reserve_graph(AppState *app, int node_count,
+                                int edge_count) {
+  GraphData *graph = app->graph;
+  int old_capacity = graph->node_capacity;
+  if (!reserve_graph_storage(graph, node_count, edge_count))
+    return 0;
+  if (graph->node_capacity == old_capacity && app->free_nodes)
+    return 1;
+
+  size_t capacity = graph->node_capacity ? graph->node_capacity : 1;
+  int *selected = realloc(app->selected_nodes, capacity * sizeof(int));
+  if (!selected)
+    return 0;
+  app->selected_nodes = selected;
+  Vec2f *screen = realloc(app->screen_positions, capacity * sizeof(Vec2f));
+  if (!screen)
+    return 0;
+  app->screen_positions = screen;
+  int *free_nodes = realloc(app->free_nodes, capacity * sizeof(int));
+  if (!free_nodes)
+    return 0;
+  app->free_nodes = free_nodes;
+  return 1;
+}
+
+// Keys the nodes of a loaded file by address, which is what objgraph.monitor
+// keys objects by, so live updates can reach them.
+static inline void seed_node_keys(AppState *app) {
+  GraphData *graph = app->graph;
+  app->live_seeded = 0;
+  if (!key_table_reserve(&app->node_keys, graph->node_count)) {
+    fprintf(stderr, "Failed to allocate memory for the live update keys\n");
+    return;
+  }
+  for (int i = 0; i < graph->node_count; i++) {
+    Uint64 key = graph->nodes[i].address;
+    if (key && key_table_get(&app->node_keys, key) < 0) {
+      key_table_put(&app->node_keys, key, i);
+      app->live_seeded = 1;
+    }
+  }
+}
+
+// Tombstones a node whose key has already left node_keys.
+static inline void remove_live_node(AppState *app, int index) {
+  app->graph->nodes[index].removed = 1;
+  app->graph->nodes[index].visible = 0;
+  app->selected_nodes[index] = 0;
+  app->free_nodes[app->free_node_count++] = index;
+}
+
+// Applies one live update (see objgraph.monitor):
+//   {"remove_nodes": [key, ...],
+//    "add_nodes": [[key, label, type, size, root], ...],
+//    "remove_edges": [[key, key], ...], "add_edges": [[key, key, label], ...],
+//    "set_roots": [key, ...], "clear_roots": [key, ...]}
+// The root lists name the nodes already shown whose root flag changed.
+// Removed nodes become invisible tombstones whose slots later additions
+// reuse, so node ids stay equal to array indices. Edges touching a removed
+// node go with it. New nodes are placed next to a neighbour that already
+// has a position, which leaves the existing layout alone. The monitor's
+// first update lists every live object, so after seed_node_keys() it also
+// drops the file's nodes it leaves out and skips the edges already loaded.
+static inline void apply_graph_delta(AppState *app, yyjson_doc *doc) {
+  GraphData *graph = app->graph;
+  yyjson_val *root = yyjson_doc_get_root(doc);
+  yyjson_val *remove_nodes = yyjson_obj_get(root, "remove_nodes");
+  yyjson_val *add_nodes = yyjson_obj_get(root, "add_nodes");
+  yyjson_val *remove_edges = yyjson_obj_get(root, "remove_edges");
+  yyjson_val *add_edges = yyjson_obj_get(root, "add_edges");
+  yyjson_val *set_roots = yyjson_obj_get(root, "set_roots");
+  yyjson_val *clear_roots = yyjson_obj_get(root, "clear_roots");
+  size_t add_node_count = yyjson_arr_size(add_nodes);
+  size_t add_edge_count = yyjson_arr_size(add_edges);
+  size_t remove_edge_count = yyjson_arr_size(remove_edges);
+
+  if (!reserve_graph(app, graph->node_count + add_node_count,
+                     graph->edge_count + add_edge_count) ||
+      !key_table_reserve(&app->node_keys,
+                         app->node_keys.count + add_node_count)) {
+    fprintf(stderr, "Failed to allocate memory for a live update\n");
+    return;
+  }
+
+  yyjson_val *val;
+  yyjson_arr_iter iter;
+  int removed_any = 0;
+  KeyTable loaded_edges = {0};
+  if (app->live_seeded) {
+    app->live_seeded = 0;
+    char *listed = calloc(graph->node_count ? graph->node_count : 1, 1);
+    if (!listed || !key_table_reserve(&loaded_edges, graph->edge_count)) {
+      fprintf(stderr, "Failed to allocate memory for a live update\n");
+      free(listed);
+      key_table_free(&loaded_edges);
+      return;
+    }
+    yyjson_arr_iter_init(add_nodes, &iter);
+    while ((val = yyjson_arr_iter_next(&iter))) {
+      int index = key_table_get(&app->node_keys,
+                                yyjson_get_uint(yyjson_arr_get(val, 0)));
+      if (index >= 0)
+        listed[index] = 1;
+    }
+    for (int i = 0; i < graph->node_count; i++) {
+      Uint64 key = graph->nodes[i].address;
+      if (graph->nodes[i].removed || listed[i] || !key ||
+          key_table_get(&app->node_keys, key) != i)
+        continue;
+      key_table_remove(&app->node_keys, key);
+      remove_live_node(app, i);
+      removed_any = 1;
+    }
+    // Slots of dropped nodes may be reused below; their edges are gone
+    for (int i = 0; i < graph->edge_count; i++) {
+      const GraphEdge *edge = &graph->edges[i];
+      if (!graph->nodes[edge->source].removed &&
+          !graph->nodes[edge->target].removed)
+        key_table_put(&loaded_edges, edge_key(edge->source, edge->target), 1);
+    }
+    free(listed);
+  }
+
+  yyjson_arr_iter_init(remove_nodes, &iter);
+  while ((val = yyjson_arr_iter_next(&iter))) {
+    int index = key_table_remove(&app->node_keys, yyjson_get_uint(val));
+    if (index < 0)
+      continue;
+    remove_live_node(app, index);
+    removed_any = 1;
+  }
+
+  if (removed_any || remove_edge_count) {
+    KeyTable doomed = {0};
+    if (!key_table_reserve(&doomed, remove_edge_count)) {
+      fprintf(stderr, "Failed to allocate memory for a live update\n");
+      key_table_free(&loaded_edges);
+      return;
+    }
+    yyjson_arr_iter_init(remove_edges, &iter);
+    while ((val = yyjson_arr_iter_next(&iter))) {
+      int source = key_table_get(&app->node_keys,
+                                 yyjson_get_uint(yyjson_arr_get(val, 0)));
+      int target = key_table_get(&app->node_keys,
+                                 yyjson_get_uint(yyjson_arr_get(val, 1)));
+      if (source >= 0 && target >= 0)
+        key_table_put(&doomed, edge_key(source, target), 1);
+    }
+
+    int kept = 0;
+    for (int i = 0; i < graph->edge_count; i++) {
+      GraphEdge edge = graph->edges[i];
+      if (graph->nodes[edge.source].removed ||
+          graph->nodes[edge.target].removed ||
+          key_table_get(&doomed, edge_key(edge.source, edge.target)) >= 0)
+        continue;
+      graph->edges[kept++] = edge;
+    }
+    graph->edge_count = kept;
+    key_table_free(&doomed);
+  }
+
+  yyjson_arr_iter_init(add_nodes, &iter);
+  while ((val = yyjson_arr_iter_next(&iter))) {
+    Uint64 key = yyjson_get_uint(yyjson_arr_get(val, 0));
+    yyjson_val *label = yyjson_arr_get(val, 1);
+    yyjson_val *type = yyjson_arr_get(val, 2);
+    yyjson_val *is_root = yyjson_arr_get(val, 4);
+    int existing = key_table_get(&app->node_keys, key);
+    if (existing >= 0 && yyjson_is_bool(is_root))
+      graph->nodes[existing].root = yyjson_get_bool(is_root); // Seeded node
+    if (!key || !yyjson_is_str(label) || existing >= 0)
+      continue;
+    const char *text =
+        store_label(graph, yyjson_get_str(label), yyjson_get_len(label));
+    const char *type_text =
+        yyjson_is_str(type)
+            ? store_label(graph, yyjson_get_str(type), yyjson_get_len(type))
+            : "";
+    if (!text || !type_text)
+      break;
+
+    int index = app->free_node_count ? app->free_nodes[--app->free_node_count]
+                                     : graph->node_count++;
+    key_table_put(&app->node_keys, key, index);
+    GraphNode *node = &graph->nodes[index];
+    node->id = index;
+    node->visible = 1;
+    node->removed = 0;
+    node->position = (Vec2f){NAN, NAN}; // Placed below
+    node->label = text;
+    node->type = *type_text ? type_text : NULL;
+    node->address = key;
+    node->diff = DIFF_NONE;
+    node->label_resolved = 0;
+    node->root = yyjson_get_bool(is_root);
+    node->size = yyjson_get_uint(yyjson_arr_get(val, 3));
+    node->retained = 0;
+    app->selected_nodes[index] = 0;
+  }
+
+  int first_new_edge = graph->edge_count;
+  yyjson_arr_iter_init(add_edges, &iter);
+  while ((val = yyjson_arr_iter_next(&iter))) {
+    int source = key_table_get(&app->node_keys,
+                               yyjson_get_uint(yyjson_arr_get(val, 0)));
+    int target = key_table_get(&app->node_keys,
+                               yyjson_get_uint(yyjson_arr_get(val, 1)));
+    yyjson_val *label = yyjson_arr_get(val, 2);
+    if (source < 0 || target < 0 ||
+        key_table_get(&loaded_edges, edge_key(source, target)) >= 0)
+      continue;
+    const char *text = yyjson_is_str(label)
+                           ? store_label(graph, yyjson_get_str(label),
+                                         yyjson_get_len(label))
+                           : "";
+    if (!text)
+      break;
+    graph->edges[graph->edge_count++] = (GraphEdge){source, target, text, 0};
+  }
+  key_table_free(&loaded_edges);
+
+  yyjson_arr_iter_init(set_roots, &iter);
+  while ((val = yyjson_arr_iter_next(&iter))) {
+    int index = key_table_get(&app->node_keys, yyjson_get_uint(val));
+    if (index >= 0)
+      graph->nodes[index].root = 1;
+  }
+  yyjson_arr_iter_init(clear_roots, &iter);
+  while ((val = yyjson_arr_iter_next(&iter))) {
+    int index = key_table_get(&app->node_keys, yyjson_get_uint(val));
+    if (index >= 0)
+      graph->nodes[index].root = 0;
+  }
+
+  // A few passes let chains of new nodes grow out from placed ones.
+  GraphNode *nodes = graph->nodes;
+  for (int pass = 0; pass < 3; pass++) {
+    for (int i = first_new_edge; i < graph->edge_count; i++) {
+      GraphNode *a = &nodes[graph->edges[i].source];
+      GraphNode *b = &nodes[graph->edges[i].target];
+      if (isnan(a->position.x) == isnan(b->position.x))
+        continue;
+      if (isnan(a->position.x)) {
+        GraphNode *t = a;
+        a = b;
+        b = t;
+      }
+      b->position.x = a->position.x + (rand() % 41) - 20;
+      b->position.y = a->position.y + (rand() % 41) - 20;
+    }
+  }
+  for (int i = 0; i < graph->node_count; i++) {
+    if (isnan(nodes[i].position.x)) {
+      nodes[i].position.x =
+          (rand() % (2 * RAND_XY_INIT_RANGE)) - RAND_XY_INIT_RANGE;
+      nodes[i].position.y =
+          (rand() % (2 * RAND_XY_INIT_RANGE)) - RAND_XY_INIT_RANGE;
+    }
+  }
+
+  app->hovered_node = -1;
+  app->hovered_edge = -1;
+  app->path_length = 0;
+  app->cut_length = 0;
+  stop_cycle_search(&app->cycles);
+  graph->edge_index_valid = 0;
+  graph->retained_valid = 0;
+  graph->types_valid = 0;
+  graph->edge_labels_valid = 0;
+  if (app->sort_by_retained)
+    compute_retained_sizes(graph);
+  invalidate_layout(graph);
+  update_node_visibility(app);
+}
+
+static inline void post_graph_delta(ViewerControl *control, yyjson_doc *doc) {
+  DeltaMessage *message = malloc(sizeof(DeltaMessage));
+  if (!message) {
+    fprintf(stderr, "Failed to allocate memory for a live update\n");
+    yyjson_doc_free(doc);
+    return;
+  }
+  message->doc = doc;
+  message->next = NULL;
+  SDL_LockMutex(control->lock);
+  if (control->deltas_tail)
+    control->deltas_tail->next = message;
+  else
+    control->deltas = message;
+  control->deltas_tail = message;
+  SDL_UnlockMutex(control->lock);
+}
+
+// Frees whatever requests are still pending.
+static inline void clear_viewer_control(ViewerControl *control) {
+  free_graph(control->graph);
+  free(control->selection);
+  while (control->deltas) {
+    DeltaMessage *next = control->deltas->next;
+    yyjson_doc_free(control->deltas->doc);
+    free(control->deltas);
+    control->deltas = next;
+  }
+  control->graph = NULL;
+  control->selection = NULL;
+  control->deltas_tail = NULL;
+}
+
+// Applies the requests posted since the last frame. Returns nonzero once the
+// viewer has been asked to close.
+static inline int apply_viewer_control(AppState *app,
+                                       ViewerControl *control) {
+  SDL_LockMutex(control->lock);
+  GraphData *graph = control->graph;
+  int *selection = control->selection;
+  int selection_count = control->selection_count;
+  DeltaMessage *deltas = control->deltas;
+  int close = control->close;
+  control->graph = NULL;
+  control->selection = NULL;
+  control->deltas = NULL;
+  control->deltas_tail = NULL;
+  SDL_UnlockMutex(control->lock);
+
+  if (graph)
+    reinitialize_app(app, graph);
+  // Live updates and selections apply to the full graph, not its summary
+  if ((deltas || selection) && app->summary.full)
+    toggle_summary(app, app->summary.kind);
+  while (deltas) {
+    DeltaMessage *next = deltas->next;
+    apply_graph_delta(app, deltas->doc);
+    yyjson_doc_free(deltas->doc);
+    free(deltas);
+    deltas = next;
+  }
+  if (selection) {
+    set_selection(app, selection, selection_count);
+    free(selection);
+  }
+  return close;
+}
+
+// Runs the viewer until its window is closed. control may be NULL; when
+// given, requests posted to it are applied between frames.
+static inline int run_viewer(GraphData *graph, ViewerControl *control) {
+  DEBUG_PRINT("Starting run_viewer\n");
+
+  DEBUG_PRINT("Initializing SDL\n");
+  if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
+    fprintf(stderr, "SDL could not initialize! SDL_Error: %s\n",
+            SDL_GetError());
+    return 1;
+  }
+
+  DEBUG_PRINT("Initializing TTF\n");
+  if (TTF_Init() == -1) {
+    fprintf(stderr, "TTF_Init: %s\n", TTF_GetError());
+    return 1;
+  }
+
+  DEBUG_PRINT("Initializing app\n");
+  AppState app;
+  initialize_app(&app, graph);
+
+  DEBUG_PRINT("Creating window\n");
+  SDL_Window *window = SDL_CreateWindow(
+      "Graph Viewer", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+      app.window_width, app.window_height, SDL_WINDOW_RESIZABLE);
+  if (!window) {
+    fprintf(stderr, "Window could not be created! SDL_Error: %s\n",
+            SDL_GetError());
+    return 1;
+  }
+
+  DEBUG_PRINT("Creating renderer\n");
+  SDL_Renderer *renderer =
+      SDL_CreateRenderer(window, -1,
+                         SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE);
+  if (!renderer) {
+    fprintf(stderr, "Renderer could not be created! SDL_Error: %s\n",
+            SDL_GetError());
+    return 1;
+  }
+
+  DEBUG_PRINT("Initializing audio\n");
+  if (Mix_OpenAudio(44100, AUDIO_S16SYS, 2, 512) < 0) {
+    fprintf(stderr, "SDL_mixer could not initialize! SDL_mixer Error: %s\n",
+            Mix_GetError());
+    return 1;
+  }
+
+  DEBUG_PRINT("Loading sound\n");
+  SDL_RWops *rw = SDL_RWFromMem(bell_wav, bell_wav_len);
+  Mix_Chunk *sound = Mix_LoadWAV_RW(rw, 1);
+  if (!sound) {
+    fprintf(stderr, "Failed to load sound! SDL_mixer Error: %s\n",
+            Mix_GetError());
+    return 1;
+  }
+
+  SDL_Event event;
+  Uint32 frameStart;
+  int frameTime;
+  int quit = 0;
+
+  DEBUG_PRINT("Entering main loop\n");
+  while (1) {
+    frameStart = SDL_GetTicks();
+
+    // The tile worker reads the graph; keep it out while events mutate it.
+    SDL_LockMutex(app.tiles.graph_lock);
+
+    DEBUG_PRINT("Handling events\n");
+    while (SDL_PollEvent(&event))
+      if (event.type == SDL_QUIT)
+        quit = 1;
+      else
+        handle_input(&event, &app);
+
+    if (control && apply_viewer_control(&app, control))
+      quit = 1;
+    resolve_full_label(app.graph, app.hovered_node);
+    advance_cycle_search(&app, CYCLE_SEARCH_SLICE_MS);
+
+    update_edge_directions(app.graph);
+    update_screen_positions(&app);
+    if (app.tiles.thread)
+      ensure_spatial_index(app.graph);
+    SDL_UnlockMutex(app.tiles.graph_lock);
+
+    if (quit)
+      break;
+
+    DEBUG_PRINT("Clearing renderer\n");
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+
+    DEBUG_PRINT("Rendering graph\n");
+    render_graph(renderer, &app);
+    DEBUG_PRINT("Rendering left menu\n");
+    render_left_menu(renderer, &app);
+    DEBUG_PRINT("Rendering right menu\n");
+    render_right_menu(renderer, &app);
+    DEBUG_PRINT("Rendering top bar\n");
+    render_top_bar(renderer, &app);
 
-  case SDL_MOUSEBUTTONUP:
-    if (event->button.button == SDL_BUTTON_LEFT) {
-      app->is_dragging_left_scrollbar = 0;
-      app->is_dragging_right_scrollbar = 0;
-    }
-    break;
+    DEBUG_PRINT("Presenting renderer\n");
+    SDL_RenderPresent(renderer);
 
-  case SDL_TEXTINPUT:
-    if (strlen(app->search_bar.text) < MAX_SEARCH_LENGTH - 1) {
-      strcat(app->search_bar.text, event->text.text);
-      update_node_visibility(app);
+    frameTime = SDL_GetTicks() - frameStart;
+    if (frameTime < FRAME_DELAY) {
+      SDL_Delay(FRAME_DELAY - frameTime);
     }
-    break;
+  }
 
-  case SDL_KEYDOWN:
-    switch (event->key.keysym.sym) {
-    case SDLK_BACKSPACE:
-      if (strlen(app->search_bar.text) > 0) {
-        app->search_bar.text[strlen(app->search_bar.text) - 1] = '\0';
-        update_node_visibility(app);
-      }
-      break;
-    case SDLK_TAB:
-      cycle_selection_mode(app);
-      break;
-    case SDLK_PAGEUP:
-    case SDLK_PAGEDOWN:
-    case SDLK_HOME:
-    case SDLK_END: {
-      int scroll_amount = 0;
-      int *scroll_position = NULL;
-      int total_items = 0;
-      int visible_items = 0;
+  DEBUG_PRINT("Cleaning up.\n");
+  Mix_FreeChunk(sound);
+  Mix_CloseAudio();
+  cleanup_app(&app);
+  SDL_DestroyRenderer(renderer);
+  SDL_DestroyWindow(window);
+  TTF_Quit();
+  SDL_Quit();
 
-      if (app->mouse_position.x > app->window_width - right_menu_width) {
-        scroll_position = &app->right_scroll_position;
-        total_items = app->visible_nodes_count;
-        visible_items = app->nodes_per_page;
-      } else if (app->mouse_position.x < left_menu_width &&
-                 app->mouse_position.y >
-                     app->window_height - app->window_height * 0.4) {
-        scroll_position = &app->left_scroll_position;
-        // Count selected and visible nodes for the left menu
-        for (int i = 0; i < app->graph->node_count; i++) {
-          if (app->selected_nodes[i] && app->graph->nodes[i].visible) {
-            total_items++;
-          }
-        }
-        // Approximate number of visible items in left menu
-        visible_items = (app->window_height * 0.4 - 50) / 20;
-      }
+  DEBUG_PRINT("Exiting run_viewer\n");
+  return 0;
+}
 
-      if (scroll_position) {
-        switch (event->key.keysym.sym) {
-        case SDLK_PAGEUP:
-          scroll_amount = 1;
-          break;
-        case SDLK_PAGEDOWN:
-          scroll_amount = -1;
-          break;
-        case SDLK_HOME:
-          *scroll_position = 0;
-          break;
-        case SDLK_END:
-          *scroll_position = fmax(0, (total_items - visible_items) * 20);
+static inline int run_graph_viewer(const char *graph_file) {
+  DEBUG_PRINT("Loading graph from %s\n", graph_file);
+  return run_viewer(load_graph(graph_file), NULL);
+}
+
+static inline int run_diff_viewer(const char *before_file,
+                                  const char *after_file) {
+  GraphData *before = load_graph(before_file);
+  GraphData *after = load_graph(after_file);
+  GraphData *diff = before && after ? diff_graphs(before, after) : NULL;
+  free_graph(before);
+  free_graph(after);
+  if (!diff)
+    return 1;
+  return run_viewer(diff, NULL);
+}
+
+#ifndef PYTHON_MODULE
+
+// Accepts one connection at a time on a Unix socket and posts every line
+// received as a live update.
+typedef struct {
+  ViewerControl *control;
+  const char *path;
+  int listen_fd;
+  int client_fd; // Guarded by control->lock
+  int quit;      // Guarded by control->lock
+  SDL_Thread *thread;
+} DeltaListener;
+
+static int delta_listener_thread(void *data) {
+  DeltaListener *listener = data;
+  size_t capacity = DELTA_READ_SIZE;
+  char *buffer = malloc(capacity);
+  if (!buffer) {
+    fprintf(stderr, "Failed to allocate memory for the delta buffer\n");
+    return 1;
+  }
+
+  for (;;) {
+    int fd = accept(listener->listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR)
+        continue;
+      break; // stop_delta_listener shut the socket down
+    }
+    SDL_LockMutex(listener->control->lock);
+    int quit = listener->quit;
+    listener->client_fd = quit ? -1 : fd;
+    SDL_UnlockMutex(listener->control->lock);
+    if (quit) {
+      close(fd);
+      break;
+    }
+    DEBUG_PRINT("Live update client connected\n");
+
+    size_t length = 0, scanned = 0;
+    for (;;) {
+      if (capacity - length < DELTA_READ_SIZE) {
+        char *grown = realloc(buffer, capacity * 2);
+        if (!grown) {
+          fprintf(stderr, "Failed to allocate memory for the delta buffer\n");
           break;
         }
-
-        if (scroll_amount != 0) {
-          int scroll_pixels = scroll_amount * visible_items * 20;
-          handle_menu_scroll(scroll_position, scroll_pixels, total_items,
-                             visible_items, 20);
+        buffer = grown;
+        capacity *= 2;
+      }
+      ssize_t n = read(fd, buffer + length, capacity - length);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        break;
+      length += n;
+
+      size_t start = 0;
+      char *newline;
+      while ((newline = memchr(buffer + scanned, '\n', length - scanned))) {
+        size_t end = newline - buffer;
+        if (end > start) {
+          yyjson_read_err err;
+          yyjson_doc *doc =
+              yyjson_read_opts(buffer + start, end - start, 0, NULL, &err);
+          if (doc)
+            post_graph_delta(listener->control, doc);
+          else
+            fprintf(stderr, "Ignoring malformed update: %s at position %zu\n",
+                    err.msg, err.pos);
         }
+        start = scanned = end + 1;
       }
-    } break;
+      if (start) {
+        memmove(buffer, buffer + start, length - start);
+        length -= start;
+      }
+      scanned = length;
     }
-    break;
 
-  case SDL_WINDOWEVENT:
-    if (event->window.event == SDL_WINDOWEVENT_RESIZED) {
-      app->window_width = event->window.data1;
-      app->window_height = event->window.data2;
-      app->nodes_per_page = (app->window_height - SEARCH_BAR_HEIGHT - 20) / 20;
-      update_open_button_position(app);
-    }
-    break;
+    SDL_LockMutex(listener->control->lock);
+    listener->client_fd = -1;
+    SDL_UnlockMutex(listener->control->lock);
+    close(fd);
+    DEBUG_PRINT("Live update client disconnected\n");
   }
+
+  free(buffer);
+  return 0;
 }
 
-static inline void initialize_app(AppState *app, const char *graph_file) {
-  DEBUG_PRINT("Initializing app with graph file: %s\n", graph_file);
+static inline int start_delta_listener(DeltaListener *listener,
+                                       ViewerControl *control,
+                                       const char *path) {
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Socket path is too long: %s\n", path);
+    return 0;
+  }
+  strcpy(address.sun_path, path);
+
+  listener->control = control;
+  listener->path = path;
+  listener->client_fd = -1;
+  listener->quit = 0;
+  listener->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener->listen_fd < 0) {
+    perror("socket");
+    return 0;
+  }
+  unlink(path);
+  if (bind(listener->listen_fd, (struct sockaddr *)&address,
+           sizeof(address)) < 0 ||
+      listen(listener->listen_fd, 1) < 0) {
+    fprintf(stderr, "Failed to listen on %s: %s\n", path, strerror(errno));
+    close(listener->listen_fd);
+    return 0;
+  }
 
-  DEBUG_PRINT("Loading graph\n");
-  app->graph = load_graph(graph_file);
-  if (!app->graph) {
-    fprintf(stderr, "Failed to load graph\n");
-    exit(1);
+  listener->thread =
+      SDL_CreateThread(delta_listener_thread, "delta_listener", listener);
+  if (!listener->thread) {
+    fprintf(stderr, "Failed to start listener thread: %s\n", SDL_GetError());
+    close(listener->listen_fd);
+    unlink(path);
+    return 0;
   }
-  DEBUG_PRINT("Graph loaded successfully. Node count: %d, Edge count: %d\n",
-              app->graph->node_count, app->graph->edge_count);
+  printf("Listening for live updates on %s\n", path);
+  return 1;
+}
 
-  DEBUG_PRINT("Initializing camera\n");
-  app->camera.zoom = 1.0f;
-  app->camera.position = (Vec2f){0, 0};
+static inline void stop_delta_listener(DeltaListener *listener) {
+  SDL_LockMutex(listener->control->lock);
+  listener->quit = 1;
+  if (listener->client_fd >= 0)
+    shutdown(listener->client_fd, SHUT_RDWR);
+  SDL_UnlockMutex(listener->control->lock);
+  shutdown(listener->listen_fd, SHUT_RDWR);
+  SDL_WaitThread(listener->thread, NULL);
+  close(listener->listen_fd);
+  unlink(listener->path);
+}
 
-  DEBUG_PRINT("Getting display mode\n");
-  SDL_DisplayMode dm;
-  if (SDL_GetCurrentDisplayMode(0, &dm) != 0) {
-    fprintf(stderr, "SDL_GetCurrentDisplayMode failed: %s\n", SDL_GetError());
-    exit(1);
+int main(int argc, char **argv) {
+  const char *graph_file = NULL;
+  const char *listen_path = NULL;
+  const char *diff_before = NULL, *diff_after = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--listen") && i + 1 < argc) {
+      listen_path = argv[++i];
+    } else if (!strcmp(argv[i], "--diff") && i + 2 < argc) {
+      diff_before = argv[++i];
+      diff_after = argv[++i];
+    } else {
+      graph_file = argv[i];
+    }
   }
-  DEBUG_PRINT("Display mode: %dx%d\n", dm.w, dm.h);
 
-  app->window_width = dm.w / 2;
-  app->window_height = dm.h / 2;
-  app->nodes_per_page = (app->window_height - SEARCH_BAR_HEIGHT - 20) / 20;
-  DEBUG_PRINT("Window size set to %dx%d, Nodes per page: %d\n",
-              app->window_width, app->window_height, app->nodes_per_page);
+  if (diff_before)
+    return run_diff_viewer(diff_before, diff_after);
 
-  DEBUG_PRINT("Allocating memory for selected nodes\n");
-  app->selected_nodes = calloc(app->graph->node_count, sizeof(int));
-  if (!app->selected_nodes) {
-    fprintf(stderr, "Failed to allocate memory for selected nodes\n");
-    exit(1);
+  if (!graph_file && !listen_path) {
+    fprintf(stderr,
+            "Usage: %s [--listen <socket>] <graph_file.json>\n"
+            "       %s --diff <before.json> <after.json>\n",
+            argv[0], argv[0]);
+    return 1;
   }
 
-  DEBUG_PRINT("Initializing app state variables\n");
-  app->selection_mode = SELECT_SINGLE;
-  app->right_scroll_position = 0;
-  app->left_scroll_position = 0;
-  app->visible_nodes_count = app->graph->node_count;
-  app->mouse_position = (Vec2f){0, 0};
-  app->filter_referenced = 0;
-  app->hovered_edge = -1;
-  app->hovered_node = -1;
-  app->is_dragging_left_scrollbar = 0;
-  app->is_dragging_right_scrollbar = 0;
-  app->drag_start_y = 0;
-  app->drag_start_scroll = 0;
+  if (!listen_path)
+    return run_graph_viewer(graph_file);
 
-  DEBUG_PRINT("Loading fonts\n");
-  SDL_RWops *font_rw = SDL_RWFromMem(lemon_ttf, lemon_ttf_len);
-  if (!font_rw) {
-    fprintf(stderr, "Failed to create RWops for font: %s\n", SDL_GetError());
-    exit(1);
+  // Live mode: start from the file if one was given, otherwise empty, and
+  // apply the updates streamed to the socket.
+  ViewerControl control = {0};
+  DeltaListener listener;
+  control.lock = SDL_CreateMutex();
+  if (!control.lock || !start_delta_listener(&listener, &control, listen_path))
+    return 1;
+
+  int result = run_viewer(graph_file ? load_graph(graph_file)
+                                     : create_graph(0, 0),
+                          &control);
+
+  stop_delta_listener(&listener);
+  clear_viewer_control(&control);
+  SDL_DestroyMutex(control.lock);
+  return result;
+}
+
+#else
+
+// Native object-graph collector. Objects get dense ids through an
+// open-addressed table keyed by address; references are found with each
+// type's tp_traverse and written straight into CSR arrays.
+
+typedef struct {
+  PyObject **keys;
+  int32_t *values;
+  size_t mask;
+} ObjectIdTable;
+
+static inline size_t object_id_slot(const ObjectIdTable *table,
+                                    const void *key) {
+  return (size_t)(((uintptr_t)key >> 4) * 0x9E3779B97F4A7C15ull) &
+         table->mask;
+}
+
+static inline int object_id_table_init(ObjectIdTable *table, size_t count) {
+  size_t capacity = 16;
+  while (capacity < 2 * count)
+    capacity <<= 1;
+  table->keys = calloc(capacity, sizeof(PyObject *));
+  table->values = malloc(capacity * sizeof(int32_t));
+  table->mask = capacity - 1;
+  return table->keys && table->values;
+}
+
+static inline void object_id_table_free(ObjectIdTable *table) {
+  free(table->keys);
+  free(table->values);
+}
+
+// Returns the id already stored for key, or stores and returns id.
+static inline int32_t object_id_table_insert(ObjectIdTable *table,
+                                             PyObject *key, int32_t id) {
+  size_t slot = object_id_slot(table, key);
+  while (table->keys[slot]) {
+    if (table->keys[slot] == key)
+      return table->values[slot];
+    slot = (slot + 1) & table->mask;
   }
+  table->keys[slot] = key;
+  table->values[slot] = id;
+  return id;
+}
 
-  app->font_small = TTF_OpenFontRW(font_rw, 0, 15);
-  SDL_RWseek(font_rw, 0, RW_SEEK_SET);
-  app->font_medium = TTF_OpenFontRW(font_rw, 0, 30);
-  SDL_RWseek(font_rw, 0, RW_SEEK_SET);
-  app->font_large = TTF_OpenFontRW(font_rw, 1, 45);
+static inline int32_t object_id_table_get(const ObjectIdTable *table,
+                                          const void *key) {
+  size_t slot = object_id_slot(table, key);
+  while (table->keys[slot]) {
+    if (table->keys[slot] == key)
+      return table->values[slot];
+    slot = (slot + 1) & table->mask;
+  }
+  return -1;
+}
 
-  if (!app->font_small || !app->font_medium || !app->font_large) {
-    fprintf(stderr, "TTF_OpenFontRW: %s\n", TTF_GetError());
-    exit(1);
+#define MEMBER_NAME_CACHE_SIZE 1024
+
+typedef struct {
+  ObjectIdTable ids;
+  int32_t source;
+  int32_t *targets;
+  size_t target_count;
+  size_t target_capacity;
+  PyObject *labels;        // One str or None per target, or NULL
+  int32_t *edge_stamp;     // Last source that referenced each id
+  int32_t *label_stamp;    // Last source that named each id
+  PyObject **pending_label; // Name for the id, valid when label_stamp matches
+  const char *member_names[MEMBER_NAME_CACHE_SIZE];
+  PyObject *member_strings[MEMBER_NAME_CACHE_SIZE];
+  PyObject *class_string;
+  PyObject *dict_string;
+  PyObject *weakref_string;
+} Collector;
+
+static inline void collector_name(Collector *c, PyObject *referent,
+                                  PyObject *name) {
+  int32_t id = object_id_table_get(&c->ids, referent);
+  if (id < 0)
+    return;
+  c->label_stamp[id] = c->source;
+  c->pending_label[id] = name;
+}
+
+static inline PyObject *collector_member_string(Collector *c,
+                                                const char *name) {
+  size_t slot = ((uintptr_t)name >> 3) & (MEMBER_NAME_CACHE_SIZE - 1);
+  if (c->member_names[slot] != name) {
+    PyObject *string = PyUnicode_InternFromString(name);
+    if (!string)
+      return NULL;
+    Py_XDECREF(c->member_strings[slot]);
+    c->member_names[slot] = name;
+    c->member_strings[slot] = string;
   }
+  return c->member_strings[slot];
+}
 
-  memset(app->search_bar.text, 0, MAX_SEARCH_LENGTH);
+// Records attribute names for the referents of obj that can be named
+// without running Python code or allocating: dict keys, the instance
+// __dict__ when it lives at a fixed offset, object members (slots and
+// most builtin attributes) and the type.
+static inline void collector_name_referents(Collector *c, PyObject *obj) {
+  PyTypeObject *type = Py_TYPE(obj);
+
+  collector_name(c, (PyObject *)type, c->class_string);
+
+  if (PyDict_Check(obj)) {
+    Py_ssize_t pos = 0;
+    PyObject *key, *value;
+    while (PyDict_Next(obj, &pos, &key, &value))
+      if (PyUnicode_Check(key))
+        collector_name(c, value, key);
+  }
 
-  int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
-  app->open_button = (SDL_Rect){left_menu_width + 10, 5, OPEN_BUTTON_WIDTH,
-                                TOP_BAR_HEIGHT - 10};
-  update_open_button_position(app);
+  if (type->tp_dictoffset > 0) {
+    PyObject *dict = *(PyObject **)((char *)obj + type->tp_dictoffset);
+    if (dict)
+      collector_name(c, dict, c->dict_string);
+  }
 
-  DEBUG_PRINT("App initialization complete\n");
+  for (PyTypeObject *t = type; t; t = t->tp_base) {
+    for (PyMemberDef *m = t->tp_members; m && m->name; m++) {
+      if (m->type != T_OBJECT && m->type != T_OBJECT_EX)
+        continue;
+      PyObject *value = *(PyObject **)((char *)obj + m->offset);
+      PyObject *name = value ? collector_member_string(c, m->name) : NULL;
+      if (name)
+        collector_name(c, value, name);
+    }
+  }
 }
 
-static inline void render_top_bar(SDL_Renderer *renderer, AppState *app) {
-  int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
-  int graph_width = GRAPH_WIDTH(app->window_width);
+static inline int collector_append(Collector *c, int32_t id,
+                                   PyObject *label) {
+  if (c->target_count == c->target_capacity) {
+    size_t capacity = c->target_capacity ? 2 * c->target_capacity : 1024;
+    int32_t *targets = realloc(c->targets, capacity * sizeof(int32_t));
+    if (!targets) {
+      PyErr_NoMemory();
+      return -1;
+    }
+    c->targets = targets;
+    c->target_capacity = capacity;
+  }
+  c->targets[c->target_count++] = id;
 
-  // Render top bar background
-  SDL_Rect top_bar_rect = {left_menu_width, 0, graph_width, TOP_BAR_HEIGHT};
-  SDL_SetRenderDrawColor(renderer, 70, 70, 70, 255);
-  SDL_RenderFillRect(renderer, &top_bar_rect);
+  if (c->labels && PyList_Append(c->labels, label) < 0)
+    return -1;
+  return 0;
+}
 
-  // Render open button
-  SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
-  SDL_RenderFillRect(renderer, &app->open_button);
-  render_label(renderer, "Open", app->open_button.x + 5, app->open_button.y + 5,
-               app->font_small, COLOR_WHITE, OPEN_BUTTON_WIDTH - 10);
+static int collector_visit(PyObject *referent, void *arg) {
+  Collector *c = arg;
+  int32_t id = object_id_table_get(&c->ids, referent);
+  if (id < 0 || c->edge_stamp[id] == c->source)
+    return 0;
+  c->edge_stamp[id] = c->source;
+  return collector_append(
+      c, id, c->label_stamp[id] == c->source ? c->pending_label[id] : Py_None);
+}
 
-  // Render "apaz's heap viewer" text
-  render_label(renderer, "apaz's heap viewer",
-               left_menu_width + graph_width - 200, 10, app->font_small,
-               (SDL_Color){0, 255, 0, 255}, 190);
+// tp_traverse does not visit the referent of a weak reference, since it is
+// not kept alive by it. The reference is still recorded, labelled
+// WEAKREF_EDGE_LABEL, so the viewer can draw it and traversals can skip it.
+static inline int collector_visit_weakref(Collector *c, PyObject *ref) {
+#if PY_VERSION_HEX >= 0x030D0000
+  PyObject *referent;
+  if (PyWeakref_GetRef(ref, &referent) < 0)
+    return -1;
+  // The objects sequence keeps every referent we can find alive.
+  Py_XDECREF(referent);
+#else
+  PyObject *referent = PyWeakref_GET_OBJECT(ref);
+#endif
+  int32_t id = referent ? object_id_table_get(&c->ids, referent) : -1;
+  if (id < 0 || c->edge_stamp[id] == c->source)
+    return 0;
+  c->edge_stamp[id] = c->source;
+  return collector_append(c, id, c->weakref_string);
+}
+
+static inline PyObject *int32_memoryview(const int32_t *data, size_t count) {
+  PyObject *bytes = PyByteArray_FromStringAndSize((const char *)data,
+                                                  count * sizeof(int32_t));
+  if (!bytes)
+    return NULL;
+  PyObject *view = PyMemoryView_FromObject(bytes);
+  Py_DECREF(bytes);
+  if (!view)
+    return NULL;
+  PyObject *cast = PyObject_CallMethod(view, "cast", "s", "i");
+  Py_DECREF(view);
+  return cast;
+}
+
+static PyObject *py_collect_graph(PyObject *self, PyObject *args,
+                                  PyObject *kwargs) {
+  static char *kwlist[] = {"objects", "labels", NULL};
+  PyObject *objects;
+  int want_labels = 1;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|p", kwlist, &objects,
+                                   &want_labels))
+    return NULL;
+
+  PyObject *seq = PySequence_Fast(objects, "objects must be a sequence");
+  if (!seq)
+    return NULL;
+  Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+  PyObject **items = PySequence_Fast_ITEMS(seq);
+  if (n > INT32_MAX - 1) {
+    Py_DECREF(seq);
+    PyErr_SetString(PyExc_OverflowError, "too many objects");
+    return NULL;
+  }
+
+  PyObject *result = NULL;
+  int32_t *offsets = malloc((n + 1) * sizeof(int32_t));
+  Collector *c = calloc(1, sizeof(Collector));
+  if (!offsets || !c || !object_id_table_init(&c->ids, n)) {
+    PyErr_NoMemory();
+    goto done;
+  }
+  c->edge_stamp = malloc(n * sizeof(int32_t));
+  c->label_stamp = malloc(n * sizeof(int32_t));
+  c->pending_label = malloc(n * sizeof(PyObject *));
+  c->class_string = PyUnicode_InternFromString("__class__");
+  c->dict_string = PyUnicode_InternFromString("__dict__");
+  c->weakref_string = PyUnicode_InternFromString(WEAKREF_EDGE_LABEL);
+  c->labels = want_labels ? PyList_New(0) : NULL;
+  if ((n && (!c->edge_stamp || !c->label_stamp || !c->pending_label)) ||
+      !c->class_string || !c->dict_string || !c->weakref_string ||
+      (want_labels && !c->labels)) {
+    if (!PyErr_Occurred())
+      PyErr_NoMemory();
+    goto done;
+  }
+
+  // Duplicates keep the id of their first occurrence.
+  for (Py_ssize_t i = 0; i < n; i++) {
+    object_id_table_insert(&c->ids, items[i], (int32_t)i);
+    c->edge_stamp[i] = -1;
+    c->label_stamp[i] = -1;
+  }
+
+  for (Py_ssize_t i = 0; i < n; i++) {
+    PyObject *obj = items[i];
+    offsets[i] = (int32_t)c->target_count;
+    c->source = (int32_t)i;
+    if (object_id_table_get(&c->ids, obj) != i)
+      continue;
+    traverseproc traverse = Py_TYPE(obj)->tp_traverse;
+    if (!PyObject_IS_GC(obj) || !traverse)
+      continue;
+    if (c->labels)
+      collector_name_referents(c, obj);
+    if (PyErr_Occurred() || traverse(obj, collector_visit, c) < 0)
+      goto done;
+    // Without labels a weak reference could not be told from a strong one
+    if (c->labels && PyWeakref_Check(obj) &&
+        collector_visit_weakref(c, obj) < 0)
+      goto done;
+  }
+  offsets[n] = (int32_t)c->target_count;
+
+  PyObject *offsets_view = int32_memoryview(offsets, n + 1);
+  PyObject *targets_view = int32_memoryview(c->targets, c->target_count);
+  if (offsets_view && targets_view)
+    result = PyTuple_Pack(3, offsets_view, targets_view,
+                          c->labels ? c->labels : Py_None);
+  Py_XDECREF(offsets_view);
+  Py_XDECREF(targets_view);
+
+done:
+  if (c) {
+    object_id_table_free(&c->ids);
+    free(c->targets);
+    free(c->edge_stamp);
+    free(c->label_stamp);
+    free(c->pending_label);
+    Py_XDECREF(c->labels);
+    Py_XDECREF(c->class_string);
+    Py_XDECREF(c->dict_string);
+    Py_XDECREF(c->weakref_string);
+    for (int i = 0; i < MEMBER_NAME_CACHE_SIZE; i++)
+      Py_XDECREF(c->member_strings[i]);
+    free(c);
+  }
+  free(offsets);
+  Py_DECREF(seq);
+  return result;
+}
+
+// Borrows an int32 buffer (array('i'), numpy int32, memoryview cast to 'i').
+static inline int get_int32_buffer(PyObject *obj, Py_buffer *view,
+                                   const char *name) {
+  if (PyObject_GetBuffer(obj, view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0)
+    return -1;
+  const char *format = view->format ? view->format : "B";
+  char code = format[strlen(format) - 1];
+  if (view->itemsize != 4 || (code != 'i' && code != 'l')) {
+    PyErr_Format(PyExc_TypeError, "%s must be an int32 buffer, not '%s'",
+                 name, format);
+    PyBuffer_Release(view);
+    return -1;
+  }
+  return 0;
 }
 
-static inline void update_open_button_position(AppState *app) {
-  int left_menu_width = LEFT_MENU_WIDTH(app->window_width);
-  app->open_button = (SDL_Rect){left_menu_width + 10, 5, OPEN_BUTTON_WIDTH,
-                                TOP_BAR_HEIGHT - 10};
-}
+// Collects UTF-8 pointers for a label argument: either a sequence of str
+// (None counts as an empty label) or a buffer of packed NUL-terminated
+// strings. The pointers stay valid while *keep and *view are held.
+static inline const char **get_labels(PyObject *obj, Py_ssize_t *count,
+                                      PyObject **keep, Py_buffer *view,
+                                      const char *name) {
+  *keep = NULL;
+  view->obj = NULL;
+
+  if (PyObject_CheckBuffer(obj) && !PyUnicode_Check(obj)) {
+    if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS) < 0)
+      return NULL;
+    const char *data = view->buf;
+    Py_ssize_t n = 0;
+    for (Py_ssize_t i = 0; i < view->len; i++)
+      n += data[i] == '\0';
+    if (view->len && data[view->len - 1] != '\0') {
+      PyErr_Format(PyExc_ValueError, "%s must end with a NUL byte", name);
+      return NULL;
+    }
+    const char **labels = PyMem_Malloc((n ? n : 1) * sizeof(char *));
+    if (!labels) {
+      PyErr_NoMemory();
+      return NULL;
+    }
+    for (Py_ssize_t i = 0, offset = 0; i < n; i++) {
+      labels[i] = data + offset;
+      offset += strlen(labels[i]) + 1;
+    }
+    *count = n;
+    return labels;
+  }
 
-static inline char *handle_open_button_click(void) {
-  static char selected_file[4096] = {0};
-  FILE *fp;
-  char command[256];
+  *keep = PySequence_Fast(obj, "labels must be a sequence or a buffer");
+  if (!*keep)
+    return NULL;
+  Py_ssize_t n = PySequence_Fast_GET_SIZE(*keep);
+  PyObject **items = PySequence_Fast_ITEMS(*keep);
+  const char **labels = PyMem_Malloc((n ? n : 1) * sizeof(char *));
+  if (!labels) {
+    PyErr_NoMemory();
+    return NULL;
+  }
+  for (Py_ssize_t i = 0; i < n; i++) {
+    labels[i] = items[i] == Py_None ? "" : PyUnicode_AsUTF8(items[i]);
+    if (!labels[i]) {
+      PyMem_Free(labels);
+      return NULL;
+    }
+  }
+  *count = n;
+  return labels;
+}
 
-  // Construct the command to run the filepicker binary
-  snprintf(command, sizeof(command), "./filepicker");
+static inline void release_labels(const char **labels, PyObject *keep,
+                                  Py_buffer *view) {
+  PyMem_Free(labels);
+  Py_XDECREF(keep);
+  if (view->obj)
+    PyBuffer_Release(view);
+}
 
-  fp = popen(command, "r");
-  if (fp == NULL) {
-    fprintf(stderr, "Failed to run filepicker command\n");
+// Builds a GraphData from in-memory arrays, so collect_and_view does not
+// have to round-trip the graph through a JSON file.
+static inline GraphData *graph_from_python(PyObject *node_labels_obj,
+                                           PyObject *sources_obj,
+                                           PyObject *targets_obj,
+                                           PyObject *edge_labels_obj,
+                                           PyObject *node_sizes_obj) {
+  GraphData *graph = NULL;
+  Py_buffer sources = {0}, targets = {0}, node_view = {0}, edge_view = {0};
+  PyObject *node_keep = NULL, *edge_keep = NULL;
+  const char **node_labels = NULL, **edge_labels = NULL;
+  Py_ssize_t node_count = 0, edge_label_count = 0;
+
+  if (get_int32_buffer(sources_obj, &sources, "sources") < 0)
     return NULL;
+  if (get_int32_buffer(targets_obj, &targets, "targets") < 0)
+    goto done;
+  node_labels = get_labels(node_labels_obj, &node_count, &node_keep,
+                           &node_view, "node_labels");
+  if (!node_labels)
+    goto done;
+  if (edge_labels_obj != Py_None) {
+    edge_labels = get_labels(edge_labels_obj, &edge_label_count, &edge_keep,
+                             &edge_view, "edge_labels");
+    if (!edge_labels)
+      goto done;
   }
 
-  if (fgets(selected_file, sizeof(selected_file) - 1, fp) != NULL) {
-    // Remove newline character if present
-    size_t len = strlen(selected_file);
-    if (len > 0 && selected_file[len - 1] == '\n') {
-      selected_file[len - 1] = '\0';
+  Py_ssize_t edge_count = sources.len / 4;
+  if (targets.len / 4 != edge_count ||
+      (edge_labels && edge_label_count != edge_count)) {
+    PyErr_SetString(PyExc_ValueError,
+                    "sources, targets and edge_labels differ in length");
+    goto done;
+  }
+  if (node_count > INT_MAX || edge_count > INT_MAX) {
+    PyErr_SetString(PyExc_OverflowError, "graph is too large");
+    goto done;
+  }
+  const int32_t *source_ids = sources.buf, *target_ids = targets.buf;
+  for (Py_ssize_t i = 0; i < edge_count; i++) {
+    if (source_ids[i] < 0 || source_ids[i] >= node_count ||
+        target_ids[i] < 0 || target_ids[i] >= node_count) {
+      PyErr_Format(PyExc_IndexError, "edge %zd refers to a missing node", i);
+      goto done;
     }
-  } else {
-    // No file selected
-    selected_file[0] = '\0';
   }
 
-  pclose(fp);
+  graph = create_graph_from_arrays((int)node_count, (int)edge_count,
+                                   source_ids, target_ids, node_labels,
+                                   edge_labels);
+  if (!graph) {
+    PyErr_NoMemory();
+    goto done;
+  }
 
-  return selected_file[0] != '\0' ? selected_file : NULL;
+  if (node_sizes_obj != Py_None) {
+    PyObject *sizes =
+        PySequence_Fast(node_sizes_obj, "node_sizes must be a sequence");
+    if (sizes && PySequence_Fast_GET_SIZE(sizes) != node_count)
+      PyErr_SetString(PyExc_ValueError,
+                      "node_sizes and node_labels differ in length");
+    for (Py_ssize_t i = 0; sizes && !PyErr_Occurred() && i < node_count; i++)
+      graph->nodes[i].size =
+          PyLong_AsUnsignedLongLong(PySequence_Fast_GET_ITEM(sizes, i));
+    Py_XDECREF(sizes);
+    if (PyErr_Occurred()) {
+      free_graph(graph);
+      graph = NULL;
+    }
+  }
+
+done:
+  release_labels(node_labels, node_keep, &node_view);
+  release_labels(edge_labels, edge_keep, &edge_view);
+  if (targets.obj)
+    PyBuffer_Release(&targets);
+  PyBuffer_Release(&sources);
+  return graph;
 }
 
-static inline void cleanup_app(AppState *app) {
-  free_graph(app->graph);
-  free(app->selected_nodes);
-  TTF_CloseFont(app->font_small);
-  TTF_CloseFont(app->font_medium);
-  TTF_CloseFont(app->font_large);
+// Label resolver backed by a Python callable that takes a node id and
+// returns its full label, or None. Runs on the viewer thread, so it takes
+// the GIL itself.
+static char *resolve_python_label(void *context, int node_id) {
+  PyGILState_STATE state = PyGILState_Ensure();
+  char *full = NULL;
+  PyObject *result = PyObject_CallFunction(context, "i", node_id);
+  if (result && PyUnicode_Check(result)) {
+    const char *text = PyUnicode_AsUTF8(result);
+    if (text)
+      full = strdup(text);
+  }
+  if (PyErr_Occurred())
+    PyErr_Print();
+  Py_XDECREF(result);
+  PyGILState_Release(state);
+  return full;
 }
 
-static inline void reinitialize_app(AppState *app, const char *graph_file) {
-  // Clean up existing resources
-  free_graph(app->graph);
-  free(app->selected_nodes);
+static void release_python_resolver(void *context) {
+  PyGILState_STATE state = PyGILState_Ensure();
+  Py_DECREF((PyObject *)context);
+  PyGILState_Release(state);
+}
 
-  // Reinitialize the application
-  app->graph = load_graph(graph_file);
-  if (!app->graph) {
-    fprintf(stderr, "Failed to load graph\n");
-    exit(1);
+// Hands resolve_label, unless None, to the graph. If it is not callable the
+// graph is freed and -1 returned.
+static inline int attach_label_resolver(GraphData *graph,
+                                        PyObject *resolve_label) {
+  if (resolve_label == Py_None)
+    return 0;
+  if (!PyCallable_Check(resolve_label)) {
+    free_graph(graph);
+    PyErr_SetString(PyExc_TypeError, "resolve_label must be callable");
+    return -1;
   }
+  Py_INCREF(resolve_label);
+  graph->resolver = (LabelResolver){resolve_python_label,
+                                    release_python_resolver, resolve_label};
+  return 0;
+}
 
-  app->camera.zoom = 1.0f;
-  app->camera.position = (Vec2f){0, 0};
+// Only one SDL window can be open at a time. viewer_busy covers the blocking
+// entry points; active_viewer is the last handle returned by start_viewer.
+// Both are guarded by the GIL.
+static int viewer_busy;
 
-  app->selected_nodes = calloc(app->graph->node_count, sizeof(int));
-  if (!app->selected_nodes) {
-    fprintf(stderr, "Failed to allocate memory for selected nodes\n");
-    exit(1);
+typedef struct {
+  PyObject_HEAD
+  ViewerControl control;
+  GraphData *graph; // Initial graph, handed to the viewer thread
+  SDL_Thread *thread;
+  int result;
+} ViewerObject;
+
+static ViewerObject *active_viewer;
+
+static inline int viewer_finished(ViewerObject *viewer) {
+  SDL_LockMutex(viewer->control.lock);
+  int finished = viewer->control.finished;
+  SDL_UnlockMutex(viewer->control.lock);
+  return finished;
+}
+
+static inline int check_viewer_available(void) {
+  if (viewer_busy || (active_viewer && active_viewer->thread &&
+                      !viewer_finished(active_viewer))) {
+    PyErr_SetString(PyExc_RuntimeError, "a graph viewer is already open");
+    return -1;
   }
+  return 0;
+}
 
-  app->selection_mode = SELECT_SINGLE;
-  app->right_scroll_position = 0;
-  app->left_scroll_position = 0;
-  app->visible_nodes_count = app->graph->node_count;
-  app->filter_referenced = 0;
+// Runs a viewer on the calling thread with the GIL released.
+static inline PyObject *run_viewer_blocking(GraphData *graph) {
+  if (check_viewer_available() < 0) {
+    free_graph(graph);
+    return NULL;
+  }
+  int result;
+  viewer_busy = 1;
+  Py_BEGIN_ALLOW_THREADS
+  result = run_viewer(graph, NULL);
+  Py_END_ALLOW_THREADS
+  viewer_busy = 0;
+  return PyLong_FromLong(result);
+}
 
-  app->hovered_edge = -1;
-  app->hovered_node = -1;
+static PyObject *py_view_arrays(PyObject *self, PyObject *args,
+                                PyObject *kwargs) {
+  static char *kwlist[] = {"node_labels",   "sources",       "targets",
+                           "edge_labels",   "resolve_label", "node_sizes",
+                           NULL};
+  PyObject *node_labels, *sources, *targets, *edge_labels = Py_None;
+  PyObject *resolve_label = Py_None, *node_sizes = Py_None;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|OOO", kwlist,
+                                   &node_labels, &sources, &targets,
+                                   &edge_labels, &resolve_label, &node_sizes))
+    return NULL;
 
-  app->is_dragging_left_scrollbar = 0;
-  app->is_dragging_right_scrollbar = 0;
-  app->drag_start_y = 0;
-  app->drag_start_scroll = 0;
+  GraphData *graph =
+      graph_from_python(node_labels, sources, targets, edge_labels, node_sizes);
+  if (!graph || attach_label_resolver(graph, resolve_label) < 0)
+    return NULL;
 
-  memset(app->search_bar.text, 0, MAX_SEARCH_LENGTH);
+  return run_viewer_blocking(graph);
+}
 
-  update_node_visibility(app);
-  update_open_button_position(app);
+static int viewer_thread(void *data) {
+  ViewerObject *viewer = data;
+  int result = run_viewer(viewer->graph, &viewer->control);
+  SDL_LockMutex(viewer->control.lock);
+  viewer->control.finished = 1;
+  SDL_UnlockMutex(viewer->control.lock);
+  return result;
 }
 
-static inline int run_graph_viewer(const char *graph_file) {
-  DEBUG_PRINT("Starting run_graph_viewer\n");
+static PyObject *viewer_update(ViewerObject *self, PyObject *args,
+                               PyObject *kwargs) {
+  static char *kwlist[] = {"node_labels",   "sources",       "targets",
+                           "edge_labels",   "resolve_label", "node_sizes",
+                           NULL};
+  PyObject *node_labels, *sources, *targets, *edge_labels = Py_None;
+  PyObject *resolve_label = Py_None, *node_sizes = Py_None;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|OOO", kwlist,
+                                   &node_labels, &sources, &targets,
+                                   &edge_labels, &resolve_label, &node_sizes))
+    return NULL;
 
-  DEBUG_PRINT("Initializing SDL\n");
-  if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
-    fprintf(stderr, "SDL could not initialize! SDL_Error: %s\n",
-            SDL_GetError());
-    return 1;
+  GraphData *graph =
+      graph_from_python(node_labels, sources, targets, edge_labels, node_sizes);
+  if (!graph || attach_label_resolver(graph, resolve_label) < 0)
+    return NULL;
+
+  SDL_LockMutex(self->control.lock);
+  if (self->control.finished) {
+    SDL_UnlockMutex(self->control.lock);
+    free_graph(graph);
+    PyErr_SetString(PyExc_RuntimeError, "the viewer has been closed");
+    return NULL;
   }
+  GraphData *stale = self->control.graph;
+  self->control.graph = graph;
+  // A selection posted for the old graph would land on the new one.
+  free(self->control.selection);
+  self->control.selection = NULL;
+  SDL_UnlockMutex(self->control.lock);
+
+  free_graph(stale);
+  Py_RETURN_NONE;
+}
 
-  DEBUG_PRINT("Initializing TTF\n");
-  if (TTF_Init() == -1) {
-    fprintf(stderr, "TTF_Init: %s\n", TTF_GetError());
-    return 1;
+static PyObject *viewer_select(ViewerObject *self, PyObject *ids) {
+  PyObject *seq = PySequence_Fast(ids, "ids must be a sequence of node ids");
+  if (!seq)
+    return NULL;
+  Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+  if (count > INT_MAX) {
+    Py_DECREF(seq);
+    PyErr_SetString(PyExc_OverflowError, "too many node ids");
+    return NULL;
+  }
+  int *selection = malloc((count ? count : 1) * sizeof(int));
+  if (!selection) {
+    Py_DECREF(seq);
+    return PyErr_NoMemory();
+  }
+  for (Py_ssize_t i = 0; i < count; i++) {
+    selection[i] = PyLong_AsLong(PySequence_Fast_GET_ITEM(seq, i));
+    if (selection[i] == -1 && PyErr_Occurred()) {
+      free(selection);
+      Py_DECREF(seq);
+      return NULL;
+    }
   }
+  Py_DECREF(seq);
+
+  SDL_LockMutex(self->control.lock);
+  free(self->control.selection);
+  self->control.selection = selection;
+  self->control.selection_count = (int)count;
+  SDL_UnlockMutex(self->control.lock);
+  Py_RETURN_NONE;
+}
 
-  DEBUG_PRINT("Initializing app\n");
-  AppState app;
-  initialize_app(&app, graph_file);
+static PyObject *viewer_close(ViewerObject *self, PyObject *unused) {
+  SDL_LockMutex(self->control.lock);
+  self->control.close = 1;
+  SDL_UnlockMutex(self->control.lock);
+  Py_RETURN_NONE;
+}
 
-  DEBUG_PRINT("Creating window\n");
-  SDL_Window *window = SDL_CreateWindow(
-      "Graph Viewer", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-      app.window_width, app.window_height, SDL_WINDOW_RESIZABLE);
-  if (!window) {
-    fprintf(stderr, "Window could not be created! SDL_Error: %s\n",
-            SDL_GetError());
-    return 1;
+static PyObject *viewer_wait(ViewerObject *self, PyObject *unused) {
+  SDL_Thread *thread = self->thread;
+  if (thread) {
+    self->thread = NULL;
+    Py_BEGIN_ALLOW_THREADS
+    SDL_WaitThread(thread, &self->result);
+    Py_END_ALLOW_THREADS
   }
+  return PyLong_FromLong(self->result);
+}
 
-  DEBUG_PRINT("Creating renderer\n");
-  SDL_Renderer *renderer =
-      SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-  if (!renderer) {
-    fprintf(stderr, "Renderer could not be created! SDL_Error: %s\n",
-            SDL_GetError());
-    return 1;
+static void viewer_dealloc(ViewerObject *self) {
+  if (self->thread) {
+    viewer_close(self, NULL);
+    PyObject *result = viewer_wait(self, NULL);
+    Py_XDECREF(result);
   }
+  if (active_viewer == self)
+    active_viewer = NULL;
+  clear_viewer_control(&self->control);
+  if (self->control.lock)
+    SDL_DestroyMutex(self->control.lock);
+  Py_TYPE(self)->tp_free((PyObject *)self);
+}
 
-  DEBUG_PRINT("Initializing audio\n");
-  if (Mix_OpenAudio(44100, AUDIO_S16SYS, 2, 512) < 0) {
-    fprintf(stderr, "SDL_mixer could not initialize! SDL_mixer Error: %s\n",
-            Mix_GetError());
-    return 1;
-  }
+static PyMethodDef ViewerMethods[] = {
+    {"update", (PyCFunction)(void (*)(void))viewer_update,
+     METH_VARARGS | METH_KEYWORDS,
+     "update(node_labels, sources, targets, edge_labels=None,\n"
+     "       resolve_label=None, node_sizes=None)\n\n"
+     "Replace the displayed graph. Takes the same arguments as view_arrays."},
+    {"select", (PyCFunction)viewer_select, METH_O,
+     "select(ids)\n\nSelect exactly the given node ids."},
+    {"close", (PyCFunction)viewer_close, METH_NOARGS,
+     "Ask the viewer to close its window. Does not wait for it."},
+    {"wait", (PyCFunction)viewer_wait, METH_NOARGS,
+     "Wait for the viewer window to close and return its exit status."},
+    {NULL, NULL, 0, NULL}};
 
-  DEBUG_PRINT("Loading sound\n");
-  SDL_RWops *rw = SDL_RWFromMem(bell_wav, bell_wav_len);
-  Mix_Chunk *sound = Mix_LoadWAV_RW(rw, 1);
-  if (!sound) {
-    fprintf(stderr, "Failed to load sound! SDL_mixer Error: %s\n",
-            Mix_GetError());
-    return 1;
+static PyTypeObject ViewerType = {
+    PyVarObject_HEAD_INIT(NULL, 0).tp_name = "graph_viewer.Viewer",
+    .tp_basicsize = sizeof(ViewerObject),
+    .tp_dealloc = (destructor)viewer_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Handle to a viewer running on its own thread.",
+    .tp_methods = ViewerMethods,
+};
+
+static PyObject *py_start_viewer(PyObject *self, PyObject *args,
+                                 PyObject *kwargs) {
+  static char *kwlist[] = {"node_labels",   "sources",       "targets",
+                           "edge_labels",   "resolve_label", "node_sizes",
+                           NULL};
+  PyObject *node_labels, *sources, *targets, *edge_labels = Py_None;
+  PyObject *resolve_label = Py_None, *node_sizes = Py_None;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|OOO", kwlist,
+                                   &node_labels, &sources, &targets,
+                                   &edge_labels, &resolve_label, &node_sizes))
+    return NULL;
+  if (check_viewer_available() < 0)
+    return NULL;
+
+  ViewerObject *viewer = PyObject_New(ViewerObject, &ViewerType);
+  if (!viewer)
+    return NULL;
+  memset(&viewer->control, 0, sizeof(ViewerControl));
+  viewer->thread = NULL;
+  viewer->result = 0;
+  viewer->graph =
+      graph_from_python(node_labels, sources, targets, edge_labels, node_sizes);
+  if (!viewer->graph ||
+      attach_label_resolver(viewer->graph, resolve_label) < 0) {
+    Py_DECREF(viewer);
+    return NULL;
   }
 
-  SDL_Event event;
-  Uint32 frameStart;
-  int frameTime;
-  int quit = 0;
+  viewer->control.lock = SDL_CreateMutex();
+  if (viewer->control.lock)
+    viewer->thread = SDL_CreateThread(viewer_thread, "graph_viewer", viewer);
+  if (!viewer->thread) {
+    PyErr_Format(PyExc_RuntimeError, "Failed to start viewer thread: %s",
+                 SDL_GetError());
+    free_graph(viewer->graph);
+    Py_DECREF(viewer);
+    return NULL;
+  }
 
-  DEBUG_PRINT("Entering main loop\n");
-  while (1) {
-    frameStart = SDL_GetTicks();
+  active_viewer = viewer;
+  return (PyObject *)viewer;
+}
 
-    DEBUG_PRINT("Handling events\n");
-    while (SDL_PollEvent(&event))
-      if (event.type == SDL_QUIT)
-        quit = 1;
-      else
-        handle_input(&event, &app);
+static PyObject *py_run_graph_viewer(PyObject *self, PyObject *args) {
+  const char *filename;
+  PyObject *resolve_label = Py_None;
+  if (!PyArg_ParseTuple(args, "s|O", &filename, &resolve_label)) {
+    return NULL;
+  }
 
-    if (quit)
-      break;
+  printf("Running graph viewer with file: %s\n", filename);
+  fflush(stdout);
 
-    DEBUG_PRINT("Clearing renderer\n");
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
+  GraphData *graph = load_graph(filename);
+  if (graph && attach_label_resolver(graph, resolve_label) < 0)
+    return NULL;
+  return run_viewer_blocking(graph);
+}
 
-    DEBUG_PRINT("Rendering graph\n");
-    render_graph(renderer, &app);
-    DEBUG_PRINT("Rendering left menu\n");
-    render_left_menu(renderer, &app);
-    DEBUG_PRINT("Rendering right menu\n");
-    render_right_menu(renderer, &app);
-    DEBUG_PRINT("Rendering top bar\n");
-    render_top_bar(renderer, &app);
+static PyObject *graph_to_python(const GraphData *graph, int retained) {
+  static const char *diff_names[] = {NULL, "retained", "added", "removed"};
+  PyObject *nodes = PyList_New(graph->node_count);
+  PyObject *edges = PyList_New(graph->edge_count);
+  if (!nodes || !edges)
+    goto fail;
+  for (int i = 0; i < graph->node_count; i++) {
+    const GraphNode *node = &graph->nodes[i];
+    PyObject *item = Py_BuildValue(
+        "{s:i,s:z,s:z,s:K,s:K,s:O,s:z}", "id", i, "label", node->label,
+        "type", node->type, "address", (unsigned long long)node->address,
+        "size", (unsigned long long)node->size, "root",
+        node->root ? Py_True : Py_False, "diff", diff_names[node->diff]);
+    if (!item)
+      goto fail;
+    PyList_SET_ITEM(nodes, i, item);
+    if (retained) {
+      PyObject *size = PyLong_FromUnsignedLongLong(node->retained);
+      int failed = !size || PyDict_SetItemString(item, "retained", size) < 0;
+      Py_XDECREF(size);
+      if (failed)
+        goto fail;
+    }
+  }
+  for (int i = 0; i < graph->edge_count; i++) {
+    const GraphEdge *edge = &graph->edges[i];
+    PyObject *item = Py_BuildValue("{s:i,s:i,s:z}", "source", edge->source,
+                                   "target", edge->target, "label",
+                                   edge->label);
+    if (!item)
+      goto fail;
+    PyList_SET_ITEM(edges, i, item);
+  }
+  return Py_BuildValue("{s:N,s:N}", "nodes", nodes, "edges", edges);
 
-    DEBUG_PRINT("Presenting renderer\n");
-    SDL_RenderPresent(renderer);
+fail:
+  Py_XDECREF(nodes);
+  Py_XDECREF(edges);
+  return NULL;
+}
 
-    frameTime = SDL_GetTicks() - frameStart;
-    if (frameTime < FRAME_DELAY) {
-      SDL_Delay(FRAME_DELAY - frameTime);
+// Points graph at filter, made to skip the labels in the sequence skip, or
+// only weak references when it is None, as the viewer starts out. Returns
+// -1 with an exception set on failure.
+static int edge_filter_from_python(GraphData *graph, EdgeFilter *filter,
+                                   PyObject *skip) {
+  graph->filter = filter;
+  if (skip == Py_None) {
+    if (toggle_listed_label(&filter->skip, &filter->skip_count,
+                            WEAKREF_EDGE_LABEL) < 0) {
+      PyErr_NoMemory();
+      return -1;
+    }
+    return 0;
+  }
+  PyObject *seq = PySequence_Fast(skip, "skip must be a sequence of str");
+  if (!seq)
+    return -1;
+  for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(seq); i++) {
+    const char *label = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(seq, i));
+    if (!label || (!label_listed(filter->skip, filter->skip_count, label) &&
+                   toggle_listed_label(&filter->skip, &filter->skip_count,
+                                       label) < 0)) {
+      if (!PyErr_Occurred())
+        PyErr_NoMemory();
+      Py_DECREF(seq);
+      return -1;
     }
   }
+  Py_DECREF(seq);
+  return 0;
+}
 
-  DEBUG_PRINT("Cleaning up.\n");
-  Mix_FreeChunk(sound);
-  Mix_CloseAudio();
-  cleanup_app(&app);
-  SDL_DestroyRenderer(renderer);
-  SDL_DestroyWindow(window);
-  TTF_Quit();
-  SDL_Quit();
+// Adds key: value, which is stolen, to node i of a graph_to_python()
+// result. Returns -1 with an exception set on failure.
+static int set_node_item(PyObject *result, int i, const char *key,
+                         PyObject *value) {
+  PyObject *nodes = PyDict_GetItemString(result, "nodes");
+  int failed = !value || PyDict_SetItemString(PyList_GET_ITEM(nodes, i), key,
+                                              value) < 0;
+  Py_XDECREF(value);
+  return failed ? -1 : 0;
+}
 
-  DEBUG_PRINT("Exiting run_graph_viewer\n");
-  return 0;
+// value as an int, or None when it is negative.
+static PyObject *int_or_none(long value) {
+  if (value >= 0)
+    return PyLong_FromLong(value);
+  Py_INCREF(Py_None);
+  return Py_None;
 }
 
-#ifndef PYTHON_MODULE
+// Gives every node of result whether the roots reach it over the followed
+// edges, as "reachable".
+static int add_reachable(PyObject *result, GraphData *graph) {
+  Uint64 *reachable = reachable_from_roots(graph);
+  int status = reachable ? 0 : -1;
+  if (!reachable)
+    PyErr_NoMemory();
+  for (int i = 0; !status && i < graph->node_count; i++)
+    if (set_node_item(result, i, "reachable",
+                      PyBool_FromLong(reachable[i >> 6] >> (i & 63) & 1)) < 0)
+      status = -1;
+  free(reachable);
+  return status;
+}
 
-int main(int argc, char **argv) {
-  if (argc < 2) {
-    fprintf(stderr, "Usage: %s <graph_file.json>\n", argv[0]);
-    return 1;
+// Gives every node of result the "chain" find_chains() puts it in, or None,
+// and result the "chain_ends" of each chain: the nodes before and after.
+static int add_chains(PyObject *result, GraphData *graph) {
+  int n = graph->node_count;
+  int *groups = malloc((n ? n : 1) * sizeof(int));
+  int *ends = malloc((n / 2 + 1) * 2 * sizeof(int)); // As in group_summary
+  int count = groups && ends ? find_chains(graph, groups, ends) : -1;
+  PyObject *chain_ends = count >= 0 ? PyList_New(count) : NULL;
+  int status = chain_ends ? 0 : -1;
+  if (count < 0)
+    PyErr_NoMemory();
+  for (int c = 0; !status && c < count; c++) {
+    PyObject *pair = Py_BuildValue("[ii]", ends[2 * c], ends[2 * c + 1]);
+    if (!pair)
+      status = -1;
+    else
+      PyList_SET_ITEM(chain_ends, c, pair);
   }
+  for (int i = 0; !status && i < n; i++)
+    if (set_node_item(result, i, "chain",
+                      int_or_none(groups[i] < count ? groups[i] : -1)) < 0)
+      status = -1;
+  if (!status && PyDict_SetItemString(result, "chain_ends", chain_ends) < 0)
+    status = -1;
+  Py_XDECREF(chain_ends);
+  free(groups);
+  free(ends);
+  return status;
+}
 
-  return run_graph_viewer(argv[1]);
+// Gives every node of result its "component" number from
+// compute_components() and the "layer" layer_components() puts it in.
+static int add_components(PyObject *result, GraphData *graph) {
+  int n = graph->node_count;
+  int *component = malloc((n ? n : 1) * sizeof(int));
+  int count = component ? compute_components(graph, component) : -1;
+  Vec2f *positions =
+      count >= 0 ? layer_components(graph, component, count) : NULL;
+  int status = positions ? 0 : -1;
+  if (!positions)
+    PyErr_NoMemory();
+  for (int i = 0; !status && i < n; i++) {
+    int c = component[i];
+    long layer = c < 0 ? -1 : lroundf(positions[c].y / COMPONENT_LAYER_SPACING);
+    if (set_node_item(result, i, "component", int_or_none(c)) < 0 ||
+        set_node_item(result, i, "layer", int_or_none(layer)) < 0)
+      status = -1;
+  }
+  free(component);
+  free(positions);
+  return status;
 }
 
-#else
+static PyObject *py_read_graph(PyObject *self, PyObject *args,
+                               PyObject *kwargs) {
+  static char *kwlist[] = {"filename",  "before",     "retained", "skip",
+                           "reachable", "components", "chains",   NULL};
+  const char *filename, *before_file = NULL;
+  PyObject *skip = Py_None;
+  int retained = 0, reachable = 0, components = 0, chains = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|zpOppp", kwlist, &filename,
+                                   &before_file, &retained, &skip, &reachable,
+                                   &components, &chains))
+    return NULL;
+  // The loader falls back to an empty graph when it cannot open a file
+  if (access(filename, R_OK) != 0)
+    return PyErr_SetFromErrnoWithFilename(PyExc_OSError, filename);
+  if (before_file && access(before_file, R_OK) != 0)
+    return PyErr_SetFromErrnoWithFilename(PyExc_OSError, before_file);
+
+  GraphData *graph = load_graph(filename);
+  if (graph && before_file) {
+    GraphData *before = load_graph(before_file);
+    GraphData *diff = before ? diff_graphs(before, graph) : NULL;
+    free_graph(before);
+    free_graph(graph);
+    graph = diff;
+  }
+  if (!graph)
+    return PyErr_NoMemory();
+  EdgeFilter filter = {0};
+  PyObject *result = NULL;
+  if (edge_filter_from_python(graph, &filter, skip) < 0)
+    goto done;
+  if (retained && !compute_retained_sizes(graph)) {
+    PyErr_NoMemory();
+    goto done;
+  }
+  result = graph_to_python(graph, retained);
+  if (result && ((reachable && add_reachable(result, graph) < 0) ||
+                 (components && add_components(result, graph) < 0) ||
+                 (chains && add_chains(result, graph) < 0)))
+    Py_CLEAR(result);
+
+done:
+  free_graph(graph);
+  free_edge_filter(&filter);
+  return result;
+}
 
-static PyObject *py_run_graph_viewer(PyObject *self, PyObject *args) {
-  const char *filename;
-  if (!PyArg_ParseTuple(args, "s", &filename)) {
+static PyObject *int_list(const int *values, int count) {
+  PyObject *list = PyList_New(count);
+  for (int i = 0; list && i < count; i++) {
+    PyObject *item = PyLong_FromLong(values[i]);
+    if (!item) {
+      Py_CLEAR(list);
+      break;
+    }
+    PyList_SET_ITEM(list, i, item);
+  }
+  return list;
+}
+
+// Runs a selection mode on node the way a click in the viewer does, with
+// no window, and returns what it selected.
+static PyObject *py_select_nodes(PyObject *self, PyObject *args,
+                                 PyObject *kwargs) {
+  static char *kwlist[] = {"filename", "node", "mode", "skip", NULL};
+  const char *filename, *mode_name;
+  int node_id;
+  PyObject *skip = Py_None;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sis|O", kwlist, &filename,
+                                   &node_id, &mode_name, &skip))
+    return NULL;
+  int mode = 0;
+  while (mode < SELECT_MODE_COUNT &&
+         strcasecmp(selection_mode_names[mode], mode_name))
+    mode++;
+  if (mode == SELECT_MODE_COUNT) {
+    PyErr_Format(PyExc_ValueError, "unknown selection mode '%s'", mode_name);
     return NULL;
   }
+  if (access(filename, R_OK) != 0)
+    return PyErr_SetFromErrnoWithFilename(PyExc_OSError, filename);
 
-  printf("Running graph viewer with file: %s\n", filename);
-  fflush(stdout);
+  PyObject *result = NULL;
+  AppState *app = calloc(1, sizeof(AppState));
+  GraphData *graph = app ? load_graph(filename) : NULL;
+  if (!graph) {
+    PyErr_NoMemory();
+    goto done;
+  }
+  app->graph = graph;
+  app->cycles.node = -1;
+  app->hovered_node = -1;
+  app->hovered_edge = -1;
+  app->selection_mode = mode;
+  if (node_id < 0 || node_id >= graph->node_count) {
+    PyErr_SetString(PyExc_IndexError, "node out of range");
+    goto done;
+  }
+  app->selected_nodes = calloc(graph->node_count, sizeof(int));
+  if (!app->selected_nodes) {
+    PyErr_NoMemory();
+    goto done;
+  }
+  if (edge_filter_from_python(graph, &app->filter, skip) < 0)
+    goto done;
 
-  int result = run_graph_viewer(filename);
-  return PyLong_FromLong(result);
+  set_node_selection(app, node_id);
+  while (app->cycles.node >= 0 && !app->cycles.done)
+    advance_cycle_search(app, CYCLE_SEARCH_SLICE_MS);
+
+  int *selected = malloc(graph->node_count * sizeof(int));
+  int selected_count = 0;
+  for (int i = 0; selected && i < graph->node_count; i++)
+    if (app->selected_nodes[i])
+      selected[selected_count++] = i;
+  CycleSearch *search = &app->cycles;
+  PyObject *selected_list =
+      selected ? int_list(selected, selected_count) : NULL;
+  PyObject *path = int_list(app->path_edges,
+                            app->path_length ? app->path_length - 1 : 0);
+  PyObject *cut = int_list(app->cut_edges, app->cut_length);
+  PyObject *cycles = PyList_New(search->cycle_count);
+  for (int c = 0; cycles && c < search->cycle_count; c++) {
+    PyObject *cycle =
+        int_list(search->cycle_edges + search->cycle_starts[c],
+                 search->cycle_starts[c + 1] - search->cycle_starts[c]);
+    if (!cycle) {
+      Py_CLEAR(cycles);
+      break;
+    }
+    PyList_SET_ITEM(cycles, c, cycle);
+  }
+  free(selected);
+  if (selected_list && path && cut && cycles) {
+    result = Py_BuildValue("{s:N,s:N,s:N,s:N}", "selected", selected_list,
+                           "path", path, "cut", cut, "cycles", cycles);
+  } else {
+    Py_XDECREF(selected_list);
+    Py_XDECREF(path);
+    Py_XDECREF(cut);
+    Py_XDECREF(cycles);
+    if (!PyErr_Occurred())
+      PyErr_NoMemory();
+  }
+
+done:
+  if (app) {
+    stop_cycle_search(&app->cycles);
+    free(app->path);
+    free(app->path_edges);
+    free(app->cut_edges);
+    free(app->selected_nodes);
+    free_edge_filter(&app->filter);
+    free(app);
+  }
+  free_graph(graph);
+  return result;
 }
 
 static PyMethodDef GraphViewerMethods[] = {
     {"run_graph_viewer", py_run_graph_viewer, METH_VARARGS,
+     "run_graph_viewer(filename, resolve_label=None)\n\n"
      "Run the graph viewer with the given JSON file."},
+    {"read_graph", (PyCFunction)(void (*)(void))py_read_graph,
+     METH_VARARGS | METH_KEYWORDS,
+     "read_graph(filename, before=None, retained=False, skip=None,\n"
+     "           reachable=False, components=False, chains=False) -> dict\n\n"
+     "Load a graph file the way the viewer does, without opening a window,\n"
+     "and return {\"nodes\": [...], \"edges\": [...]} with node ids\n"
+     "renumbered from 0. With before, return the diff of the two\n"
+     "snapshots instead, each node's \"diff\" being \"retained\", \"added\"\n"
+     "or \"removed\". Traversals skip the edge labels in skip, or only\n"
+     "'" WEAKREF_EDGE_LABEL "' when it is None, as the viewer does.\n"
+     "With retained=True, nodes also get the \"retained\" size the viewer\n"
+     "computes from the dominator tree. With reachable=True, they get\n"
+     "whether the roots reach them as \"reachable\". With\n"
+     "components=True, they get the number of their strongly connected\n"
+     "\"component\", edges between components pointing to lower numbers,\n"
+     "and the \"layer\" of the component summary it is drawn in. With\n"
+     "chains=True, they get the number of the \"chain\" the chain summary\n"
+     "folds them into, or None, and the result gets the \"chain_ends\":\n"
+     "the nodes before and after each chain."},
+    {"select_nodes", (PyCFunction)(void (*)(void))py_select_nodes,
+     METH_VARARGS | METH_KEYWORDS,
+     "select_nodes(filename, node, mode, skip=None) -> dict\n\n"
+     "Load a graph file like read_graph and click node in the given\n"
+     "selection mode, e.g. \"Path to Root\", \"Min Cut\" or \"Cycles\",\n"
+     "without opening a window. Traversals skip the edge labels in skip,\n"
+     "or only '" WEAKREF_EDGE_LABEL "' when it is None. Returns\n"
+     "{\"selected\": [...], \"path\": [...], \"cut\": [...],\n"
+     "\"cycles\": [[...], ...]}: the selected node ids, the edge ids of the\n"
+     "path from the root, those of the cut, and those of each cycle,\n"
+     "shortest first."},
+    {"view_arrays", (PyCFunction)(void (*)(void))py_view_arrays,
+     METH_VARARGS | METH_KEYWORDS,
+     "view_arrays(node_labels, sources, targets, edge_labels=None,\n"
+     "            resolve_label=None, node_sizes=None)\n\n"
+     "Run the graph viewer on an in-memory graph. Node ids are indices into\n"
+     "node_labels; edge i goes from sources[i] to targets[i], both int32\n"
+     "buffers. Labels are sequences of str or buffers of packed\n"
+     "NUL-terminated UTF-8 strings. resolve_label(node_id) is called the\n"
+     "first time a node is hovered or selected and may return its full\n"
+     "label in place of a shortened one, or None. node_sizes holds the\n"
+     "shallow size of each node in bytes, for retained sizes."},
+    {"start_viewer", (PyCFunction)(void (*)(void))py_start_viewer,
+     METH_VARARGS | METH_KEYWORDS,
+     "start_viewer(node_labels, sources, targets, edge_labels=None,\n"
+     "             resolve_label=None, node_sizes=None) -> Viewer\n\nLike view_arrays, but runs the viewer on its own thread and\n"
+     "returns immediately with a handle to it."},
+    {"collect_graph", (PyCFunction)(void (*)(void))py_collect_graph,
+     METH_VARARGS | METH_KEYWORDS,
+     "collect_graph(objects, labels=True) -> (offsets, targets, labels)\n\n"
+     "Find the references between the given objects with tp_traverse.\n"
+     "Object i references targets[offsets[i]:offsets[i + 1]]; offsets and\n"
+     "targets are int32 memoryviews. labels holds the attribute name of\n"
+     "each reference when it is cheap to find, otherwise None. With labels,\n"
+     "weak references are included too, labelled '" WEAKREF_EDGE_LABEL "'."},
     {NULL, NULL, 0, NULL}};
 
 static struct PyModuleDef graphviewermodule = {
@@ -1688,6 +7380,24 @@ static struct PyModuleDef graphviewermodule = {
     GraphViewerMethods};
 
 PyMODINIT_FUNC PyInit_graph_viewer(void) {
-  return PyModule_Create(&graphviewermodule);
+  if (PyType_Ready(&ViewerType) < 0)
+    return NULL;
+  PyObject *module = PyModule_Create(&graphviewermodule);
+  if (!module)
+    return NULL;
+  // Limits of select_nodes() and read_graph(), for checking their results
+  if (PyModule_AddIntMacro(module, MAX_CYCLE_LENGTH) < 0 ||
+      PyModule_AddIntMacro(module, MAX_CYCLES) < 0 ||
+      PyModule_AddIntMacro(module, MIN_CHAIN_LENGTH) < 0) {
+    Py_DECREF(module);
+    return NULL;
+  }
+  Py_INCREF(&ViewerType);
+  if (PyModule_AddObject(module, "Viewer", (PyObject *)&ViewerType) < 0) {
+    Py_DECREF(&ViewerType);
+    Py_DECREF(module);
+    return NULL;
+  }
+  return module;
 }
 #endif
@@ -6,8 +6,31 @@ from weakref import ReferenceType
 
 TargetType = Union[ReferenceType, Literal["pytorch"], None]
 
+# Label of the edge from a weak reference to its referent. The viewer skips
+# these edges in traversals by default, since they keep nothing alive.
+WEAKREF_EDGE_LABEL = "weak reference"
 
-def generate_object_graph(gc_objects: list[object]) -> dict:
+
+def native_collector():
+    """
+    Return graph_viewer.collect_graph, or None when the extension module
+    is not available and the graph has to be built in Python.
+    """
+    try:
+        import graph_viewer
+    except ImportError:
+        return None
+    return getattr(graph_viewer, "collect_graph", None)
+
+
+def make_object_to_string(max_length: Union[int, None] = 200):
+    """
+    Return object_to_string(obj, _id), which builds the node label for the
+    object whose id() is _id. Containers are shown with a bounded reprlib
+    repr and every label is cut to max_length characters, so one large dict
+    costs no more to label than a small one. Pass max_length=None for full
+    labels.
+    """
 
     import inspect
     import sys
@@ -22,6 +45,11 @@ def generate_object_graph(gc_objects: list[object]) -> dict:
 
     _not_found = object()
 
+    short_repr = reprlib.Repr()
+    short_repr.maxlevel = 2
+    if max_length is not None:
+        short_repr.maxstring = short_repr.maxother = max_length
+
     def module_types(module: types.ModuleType) -> set[int]:
         return {id(value) for value in vars(module).values() if type(value) is type}
 
@@ -35,6 +63,29 @@ def generate_object_graph(gc_objects: list[object]) -> dict:
     }
 
     def object_to_string(obj, _id):
+        label = full_label(obj, _id)
+        if max_length is not None and len(label) > max_length:
+            label = label[: max_length - 3] + "..."
+        return label
+
+    scalar_types = {int, float, bool, types.NoneType}
+
+    def container_to_string(obj):
+        if max_length is None:
+            return str(obj)
+        # reprlib bounds every nested element but is pure Python. Sequences
+        # that start with plain numbers are common, and their head can be
+        # printed in C with the same result.
+        if isinstance(obj, (list, tuple)):
+            head = obj[: short_repr.maxlist]
+            if all(type(x) in scalar_types for x in head):
+                text = str(head)
+                if len(head) < len(obj):
+                    text = f"{text[:-1]}, ...{text[-1]}"
+                return text
+        return short_repr.repr(obj)
+
+    def full_label(obj, _id):
 
         if isinstance(obj, (int, float, str, bool, types.NoneType, inspect.Signature)):
             return str(obj)
@@ -81,7 +132,7 @@ def generate_object_graph(gc_objects: list[object]) -> dict:
                 return f"<empty cell>"
 
         if isinstance(obj, (list, tuple)):
-            return str(obj)
+            return container_to_string(obj)
 
         if isinstance(obj, types.CodeType):
             return f"<code for {obj.co_name} at {obj.co_filename}:{obj.co_firstlineno}>"
@@ -89,7 +140,7 @@ def generate_object_graph(gc_objects: list[object]) -> dict:
         if isinstance(obj, (dict, types.MappingProxyType)):
             if (mod_name := globals_id_to_name.get(_id, _not_found)) is not _not_found:
                 return f"<module_globals {mod_name}>"
-            return str(obj)
+            return container_to_string(obj)
 
         if isinstance(obj, ReferenceType):
             return f"<weakref to {object_to_string(obj(), id(obj()))}>"
@@ -112,11 +163,6 @@ def generate_object_graph(gc_objects: list[object]) -> dict:
         if hasattr(obj, "__qualname__"):
             return obj.__qualname__
 
-        if hasattr(obj, "__call__") and not hasattr(obj, "__code__"):
-            print(obj)
-            print(type(obj))
-            print()
-
         if hasattr(obj, "__name__"):
             if obj.__name__ in dir(__builtins__) and obj is getattr(
                 __builtins__, obj.__name__
@@ -126,35 +172,154 @@ def generate_object_graph(gc_objects: list[object]) -> dict:
 
         return f"Object of type: {str(type(obj))}"
 
-    n_obj = 0
-    objids = {}
+    return object_to_string
 
-    nodes = []
-    edges = []
 
-    class _CM:
-        @classmethod
-        def foo(cls):
-            pass
-
-    classmethodtype = type(_CM.foo)
+def external_roots(gc_objects: list[object]) -> set[int]:
+    """
+    Return the indices of the objects that something besides gc_objects
+    refers to: the stack, C globals, objects the collector does not track,
+    or the rest of the heap when gc_objects is a subset. This is how the
+    collector finds its own roots, so whatever they cannot reach is garbage
+    waiting for the next collection.
+    """
+    import sys
 
+    objids = {id(obj): obj_id for obj_id, obj in enumerate(gc_objects)}
+    internal = [0] * len(gc_objects)
     for obj in gc_objects:
-        objids[id(obj)] = obj_id = n_obj
-        n_obj += 1
-        nodes.append(
-            {
-                "id": obj_id,
-                "label": object_to_string(obj, obj_id),
-                "type": type(obj).__qualname__,
-            }
-        )
+        for referent in gc.get_referents(obj):
+            obj_id = objids.get(id(referent))
+            if obj_id is not None:
+                internal[obj_id] += 1
+    obj = referent = None  # The loop variables would count as references
+    del objids
+
+    roots = set()
+    for obj_id in range(len(gc_objects)):
+        obj = gc_objects[obj_id]
+        # Minus the references from gc_objects, obj and getrefcount() itself
+        if sys.getrefcount(obj) - 3 > internal[obj_id]:
+            roots.add(obj_id)
+    return roots
+
+
+class _ClassMethodHolder:
+    @classmethod
+    def method(cls):
+        pass
+
+
+_classmethod_type = type(_ClassMethodHolder.method)
+
+
+def indirect_label(indirect) -> str:
+    """Label of a reference to indirect that has no attribute name."""
+    # type() rather than isinstance(), which would ask indirect.__class__
+    if issubclass(
+        type(indirect),
+        (
+            types.MemberDescriptorType,
+            types.FunctionType,
+            types.MethodType,
+            types.BuiltinFunctionType,
+            types.CellType,
+            _classmethod_type,
+        ),
+    ):
+        return str(indirect)
+    return f"Indirect Reference to {type(indirect)}"
+
+
+def fill_edge_labels(
+    gc_objects: list[object],
+    collected: tuple,
+    start: int = 0,
+    stop: Union[int, None] = None,
+):
+    """
+    Name the edges of gc_objects[start:stop] that
+    graph_viewer.collect_graph(gc_objects), whose result is collected, left
+    as None, replacing them in its label list.
+    """
+    offsets, targets, labels = collected
+    if stop is None:
+        stop = len(gc_objects)
+    for obj_id in range(start, stop):
+        attr_names = None
+        for k in range(offsets[obj_id], offsets[obj_id + 1]):
+            if labels[k] is not None:
+                continue
+            # Instance dicts that live inline in the object are only
+            # reachable by name from Python.
+            if attr_names is None:
+                obj = gc_objects[obj_id]
+                attr_names = {}
+                # Bypass __getattr__ and __getattribute__ overrides, which
+                # may run arbitrary code or hand back something else.
+                try:
+                    d = object.__getattribute__(obj, "__dict__")
+                except Exception:
+                    d = None
+                if type(d) is dict and not issubclass(type(obj), type):
+                    attr_names = {id(v): name for name, v in d.items()}
+            target = gc_objects[targets[k]]
+            labels[k] = attr_names.get(id(target)) or indirect_label(target)
+
+
+def iter_object_graph(
+    gc_objects: list[object],
+    start: int = 0,
+    stop: Union[int, None] = None,
+    collected: Union[tuple, None] = None,
+    roots: Union[set[int], None] = None,
+):
+    """
+    Yield the graph one record at a time: every node dict first, then every
+    edge dict. Nodes carry "id", edges carry "source". Only the nodes in
+    gc_objects[start:stop] and the edges leaving them are yielded, with ids
+    that index the whole list. collected is the result of
+    graph_viewer.collect_graph(gc_objects), and roots that of
+    external_roots(gc_objects), if they are already at hand.
+    """
 
-        if n_obj == 1:
-            nodes[0]["root"] = True
+    import inspect
+    import sys
 
-    for obj in gc_objects:
-        obj_id = objids[id(obj)]
+    object_to_string = make_object_to_string()
+    if stop is None:
+        stop = len(gc_objects)
+    if roots is None:
+        roots = external_roots(gc_objects)
+
+    for obj_id in range(start, stop):
+        obj = gc_objects[obj_id]
+        node = {
+            "id": obj_id,
+            "label": object_to_string(obj, id(obj)),
+            "type": type(obj).__qualname__,
+            "address": id(obj),
+            "size": sys.getsizeof(obj, 0),
+        }
+
+        if obj_id in roots:
+            node["root"] = True
+        yield node
+
+    collect_graph = native_collector()
+    if collected is None and collect_graph is not None:
+        collected = collect_graph(gc_objects)
+    if collected is not None:
+        offsets, targets, labels = collected
+        fill_edge_labels(gc_objects, collected, start, stop)
+        for obj_id in range(start, stop):
+            for k in range(offsets[obj_id], offsets[obj_id + 1]):
+                yield {"source": obj_id, "target": targets[k], "label": labels[k]}
+        return
+
+    objids = {id(obj): obj_id for obj_id, obj in enumerate(gc_objects)}
+    for obj_id in range(start, stop):
+        obj = gc_objects[obj_id]
 
         # Calling getmembers() instead raises ValueError for empty cell objects.
         members = inspect.getmembers_static(obj)  # (name, value)
@@ -168,9 +333,7 @@ def generate_object_graph(gc_objects: list[object]) -> dict:
                 continue
             if not id(attr_value) in objids:
                 continue
-            edges.append(
-                {"source": obj_id, "target": objids[id(attr_value)], "label": attr_name}
-            )
+            yield {"source": obj_id, "target": objids[id(attr_value)], "label": attr_name}
 
         # An indirect reference is a reference that's tracked by
         # the garbage collector, but doesn't show up as an attribute.
@@ -180,38 +343,143 @@ def generate_object_graph(gc_objects: list[object]) -> dict:
             if not id(indirect) in objids:
                 continue
 
-            label = f"Indirect Reference to {type(indirect)}"
-            if isinstance(
-                indirect,
-                (
-                    types.MemberDescriptorType,
-                    types.FunctionType,
-                    types.MethodType,
-                    types.BuiltinFunctionType,
-                    types.CellType,
-                    classmethodtype,
-                ),
-            ):
-                label = str(indirect)
-            edges.append(
-                {
-                    "source": objids[id(obj)],
-                    "target": objids[id(indirect)],
-                    "label": label,
+            label = indirect_label(indirect)
+            yield {
+                "source": objids[id(obj)],
+                "target": objids[id(indirect)],
+                "label": label,
+            }
+
+        # gc.get_referents() does not report the referent of a weak reference.
+        if isinstance(obj, ReferenceType) and id(referent := obj()) in objids:
+            if id(referent) not in referent_ids:
+                yield {
+                    "source": obj_id,
+                    "target": objids[id(referent)],
+                    "label": WEAKREF_EDGE_LABEL,
                 }
-            )
 
+
+def label_resolver(gc_objects: list[object]):
+    """
+    Return resolve_label(node_id) for graph_viewer, which builds the full,
+    unshortened label of gc_objects[node_id] when the node is first hovered
+    or selected. It keeps gc_objects alive for as long as the viewer holds
+    on to it.
+    """
+    full_label = make_object_to_string(max_length=None)
+
+    def resolve_label(node_id: int) -> str:
+        obj = gc_objects[node_id]
+        return full_label(obj, id(obj))
+
+    return resolve_label
+
+
+def generate_object_graph(gc_objects: list[object]) -> dict:
+    nodes = []
+    edges = []
+    for record in iter_object_graph(gc_objects):
+        (edges if "source" in record else nodes).append(record)
     return {"nodes": nodes, "edges": edges}
 
 
-def collect_to_json(target: TargetType = None, filename: Union[str, None] = None):
+def write_graph_jsonl(
+    gc_objects: list[object],
+    f,
+    start: int = 0,
+    stop: Union[int, None] = None,
+    collected: Union[tuple, None] = None,
+    roots: Union[set[int], None] = None,
+):
+    """
+    Stream the graph to a text file as compact JSON lines, writing each
+    record as soon as it is generated instead of building the whole graph
+    first. The first line is a header so the viewer can tell the format
+    apart from a plain {"nodes": ..., "edges": ...} document. start, stop,
+    collected and roots are passed on to iter_object_graph().
+    """
+    import json
+
+    encoder = json.JSONEncoder(separators=(",", ":"))
+    f.write('{"format":"graph-jsonl","version":1}\n')
+    for record in iter_object_graph(gc_objects, start, stop, collected, roots):
+        f.write(encoder.encode(record))
+        f.write("\n")
+
+
+def write_graph_shards(
+    gc_objects: list[object], filename: str, workers: Union[int, None] = None
+):
+    """
+    Write the graph with several fork()ed workers, since labeling is
+    single-threaded Python. Worker i writes the nodes of its slice of
+    gc_objects, and the edges leaving them, to "<name>.<i><ext>"; filename
+    gets a manifest listing the shards in order, which the viewer loads as
+    one graph. workers defaults to the number of CPUs.
+    """
+    import json
+    import os
+
+    if workers is None:
+        workers = os.cpu_count() or 1
+    workers = max(1, min(workers, len(gc_objects)))
+
+    # References and roots are found once, here, and shared with the workers
+    # through copy-on-write.
+    collect_graph = native_collector()
+    collected = collect_graph(gc_objects) if collect_graph is not None else None
+    roots = external_roots(gc_objects)
+
+    root, ext = os.path.splitext(filename)
+    shards = [f"{root}.{i}{ext}" for i in range(workers)]
+    pids = []
+    for i, shard in enumerate(shards):
+        pid = os.fork()
+        if pid == 0:
+            status = 1
+            try:
+                with open(shard, "w") as f:
+                    write_graph_jsonl(
+                        gc_objects,
+                        f,
+                        len(gc_objects) * i // workers,
+                        len(gc_objects) * (i + 1) // workers,
+                        collected,
+                        roots,
+                    )
+                status = 0
+            except BaseException:
+                import traceback
+
+                os.write(2, traceback.format_exc().encode())
+            finally:
+                os._exit(status)
+        pids.append(pid)
+
+    failed = [
+        pid for pid in pids if os.waitstatus_to_exitcode(os.waitpid(pid, 0)[1]) != 0
+    ]
+    if failed:
+        raise RuntimeError(f"shard workers {failed} failed")
+
+    with open(filename, "w") as f:
+        manifest = {
+            "format": "graph-shards",
+            "version": 1,
+            "shards": [os.path.basename(shard) for shard in shards],
+        }
+        f.write(json.dumps(manifest, separators=(",", ":")) + "\n")
+
+
+def collect_objects(target: TargetType = None) -> list[object]:
     all_objects = gc.get_objects()
 
     if target is None:
         gc_objects = all_objects
     else:
         # Get all objects which reference the target object, directly or indirectly.
-        assert not isinstance(target, ReferenceType), (
+        assert isinstance(target, ReferenceType), (
             "target must be None (for a full dump of the GC) or a ReferenceType "
             "object. Create one with weakref.ref(), and make sure not to keep "
             "any extra references around. Be very careful about not creating "
@@ -220,69 +488,355 @@ def collect_to_json(target: TargetType = None, filename: Union[str, None] = None
 
         gc_objects = []
         if target() is not None:
-            objects_to_check = [target()]
-            checked_objects = set()
-            all_object_ids = {id(obj) for obj in all_objects}
+            # gc.get_referrers() scans the whole heap on every call, so
+            # invert the references once and walk the index instead.
+            referrers: dict[int, list[object]] = {}
+            for obj in all_objects:
+                for referent in gc.get_referents(obj):
+                    referrers.setdefault(id(referent), []).append(obj)
 
+            import collections
+
+            objects_to_check = collections.deque([target()])
+            checked_objects = {id(target())}
             while objects_to_check:
-                obj = objects_to_check.pop()
-                if id(obj) not in checked_objects:
-                    checked_objects.add(id(obj))
-                    gc_objects.append(obj)
-                    referrers = [
-                        r for r in gc.get_referrers(obj) if id(r) in all_object_ids
-                    ]
-                    objects_to_check.extend(referrers)
+                obj = objects_to_check.popleft()
+                gc_objects.append(obj)
+                for r in referrers.get(id(obj), ()):
+                    if id(r) not in checked_objects:
+                        checked_objects.add(id(r))
+                        objects_to_check.append(r)
+            del referrers
 
-    import json
+    return gc_objects
+
+
+def collect_to_json(
+    target: TargetType = None,
+    filename: Union[str, None] = None,
+    workers: int = 1,
+):
+    """
+    Write the object graph to filename, or to a temporary file, and return
+    the file name. With workers > 1 the labels are built in parallel and
+    filename is a manifest of shards; see write_graph_shards().
+    """
     import tempfile
 
-    graph = generate_object_graph(gc_objects)
+    gc_objects = collect_objects(target)
 
     if filename is None:
-        temp_file = tempfile.NamedTemporaryFile(delete=False, suffix=".json")
+        temp_file = tempfile.NamedTemporaryFile(delete=False, suffix=".jsonl")
         filename = temp_file.name
         temp_file.close()
 
     assert isinstance(filename, str), "filename must be a string."
-    with open(filename, "w") as f:
-        json.dump(graph, f, indent=2)
+    if workers > 1:
+        write_graph_shards(gc_objects, filename, workers)
+    else:
+        with open(filename, "w") as f:
+            write_graph_jsonl(gc_objects, f)
 
     print(f"Object graph has been saved to {filename}")
     return filename
 
 
+def fork_snapshot(
+    target: TargetType = None,
+    filename: Union[str, None] = None,
+    wait: bool = False,
+    workers: int = 1,
+) -> tuple[int, str]:
+    """
+    Like collect_to_json(), but the collection runs in a fork()ed child
+    against its copy-on-write view of the heap, so the calling process only
+    pauses for the fork itself. Returns (pid, filename). Unless wait=True,
+    the graph is still being written when this returns; reap the child with
+    os.waitpid(pid, 0) to know when the file is complete.
+
+    The child touches reference counts as it walks the heap, so pages it
+    visits get copied: expect up to one extra heap's worth of memory while
+    it runs. workers is passed on to collect_to_json().
+    """
+    import os
+    import tempfile
+    import time
+
+    if filename is None:
+        temp_file = tempfile.NamedTemporaryFile(delete=False, suffix=".jsonl")
+        filename = temp_file.name
+        temp_file.close()
+    assert isinstance(filename, str), "filename must be a string."
+
+    start = time.perf_counter()
+    pid = os.fork()
+    if pid == 0:
+        # Only this thread survives the fork. Locks held by the others stay
+        # locked, so do nothing here beyond collecting and writing.
+        status = 1
+        try:
+            gc.disable()
+            gc_objects = collect_objects(target)
+            if workers > 1:
+                write_graph_shards(gc_objects, filename, workers)
+            else:
+                with open(filename, "w") as f:
+                    write_graph_jsonl(gc_objects, f)
+            status = 0
+        except BaseException:
+            import traceback
+
+            os.write(2, traceback.format_exc().encode())
+        finally:
+            os._exit(status)
+
+    pause = time.perf_counter() - start
+    print(f"Paused for {pause * 1000:.1f} ms to fork snapshot process {pid}.")
+
+    if wait:
+        _, status = os.waitpid(pid, 0)
+        if os.waitstatus_to_exitcode(status) != 0:
+            raise RuntimeError(f"snapshot process {pid} failed")
+        print(f"Object graph has been saved to {filename}")
+    return pid, filename
+
+
+def monitor(
+    socket_path: str,
+    interval: float = 5.0,
+    target: TargetType = None,
+    snapshots: Union[int, None] = None,
+):
+    """
+    Stream heap changes into a viewer started with
+    `graph_viewer --listen socket_path`. Every interval seconds the heap is
+    collected again, and only the nodes and edges that appeared or went away
+    since the previous snapshot are sent, one JSON object per line:
+
+        {"add_nodes": [[key, label, type, size, root], ...],
+         "remove_nodes": [key, ...],
+         "add_edges": [[source key, target key, label], ...],
+         "remove_edges": [[source key, target key], ...],
+         "set_roots": [key, ...], "clear_roots": [key, ...]}
+
+    Nodes are keyed by address. An address that now holds an object of a
+    different type is sent as a removal followed by an addition. root is
+    the external_roots() flag; the root lists carry its changes for nodes
+    that were sent before.
+    """
+    import json
+    import socket
+    import sys
+    import time
+
+    object_to_string = make_object_to_string()
+    collect_graph = native_collector()
+
+    # Only ids are kept between snapshots, so the monitor itself does not
+    # keep anything alive.
+    node_types: dict[int, int] = {}
+    edges: set[tuple[int, int]] = set()
+    roots: set[int] = set()
+
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sock:
+        sock.connect(socket_path)
+        taken = 0
+        while snapshots is None or taken < snapshots:
+            objects = collect_objects(target)
+            # Before anything else refers to the objects
+            roots_now = {id(objects[i]) for i in external_roots(objects)}
+            keys = [id(obj) for obj in objects]
+            types_now = {key: id(type(obj)) for key, obj in zip(keys, objects)}
+
+            removed = {
+                key for key, t in node_types.items() if types_now.get(key) != t
+            }
+            added = {key for key, t in types_now.items() if node_types.get(key) != t}
+
+            edge_labels: dict[tuple[int, int], str] = {}
+            if collect_graph is not None:
+                offsets, targets, labels = collect_graph(objects)
+                for i, source in enumerate(keys):
+                    for k in range(offsets[i], offsets[i + 1]):
+                        edge_labels[(source, keys[targets[k]])] = labels[k] or ""
+            else:
+                for source, obj in zip(keys, objects):
+                    for referent in gc.get_referents(obj):
+                        if id(referent) in types_now:
+                            edge_labels[(source, id(referent))] = ""
+
+            # The viewer drops the edges of removed nodes by itself, and
+            # edges of re-added nodes have to be sent again.
+            delta = {
+                "remove_nodes": list(removed),
+                "add_nodes": [
+                    [
+                        key,
+                        object_to_string(obj, key),
+                        type(obj).__qualname__,
+                        sys.getsizeof(obj, 0),
+                        key in roots_now,
+                    ]
+                    for key, obj in zip(keys, objects)
+                    if key in added
+                ],
+                "remove_edges": [
+                    list(edge)
+                    for edge in edges
+                    if edge not in edge_labels
+                    and edge[0] not in removed
+                    and edge[1] not in removed
+                ],
+                "add_edges": [
+                    [source, target, label]
+                    for (source, target), label in edge_labels.items()
+                    if (source, target) not in edges
+                    or source in added
+                    or target in added
+                ],
+                "set_roots": [key for key in roots_now - roots if key not in added],
+                "clear_roots": [
+                    key
+                    for key in roots - roots_now
+                    if key in types_now and key not in added
+                ],
+            }
+            node_types = types_now
+            edges = set(edge_labels)
+            roots = roots_now
+            del objects, keys, edge_labels
+
+            try:
+                sock.sendall((json.dumps(delta) + "\n").encode())
+            except BrokenPipeError:
+                print("The viewer has closed.")
+                return
+            del delta
+
+            taken += 1
+            if snapshots is None or taken < snapshots:
+                time.sleep(interval)
+
+
 def view_json(filename: str):
     import graph_viewer
 
     graph_viewer.run_graph_viewer(filename)
 
 
+def graph_to_arrays(graph: dict) -> tuple:
+    """
+    Convert a graph from generate_object_graph() into the arguments of
+    graph_viewer.view_arrays(), start_viewer() and Viewer.update().
+    """
+    import array
+
+    nodes, edges = graph["nodes"], graph["edges"]
+    return (
+        [node["label"] for node in nodes],
+        array.array("i", [edge["source"] for edge in edges]),
+        array.array("i", [edge["target"] for edge in edges]),
+        [edge["label"] for edge in edges],
+    )
+
+
+def objects_to_arrays(gc_objects: list[object], collected: tuple) -> tuple:
+    """
+    Build the arguments of graph_viewer.view_arrays() and start_viewer()
+    from graph_viewer.collect_graph(gc_objects), whose result is collected,
+    without going through a dict per node and edge. Returns them together
+    with the node sizes.
+    """
+    import array
+    import itertools
+    import sys
+
+    object_to_string = make_object_to_string()
+    offsets, targets, labels = collected
+    fill_edge_labels(gc_objects, collected)
+    sources = array.array(
+        "i",
+        itertools.chain.from_iterable(
+            itertools.repeat(obj_id, offsets[obj_id + 1] - offsets[obj_id])
+            for obj_id in range(len(gc_objects))
+        ),
+    )
+    node_labels = [object_to_string(obj, id(obj)) for obj in gc_objects]
+    sizes = [sys.getsizeof(obj, 0) for obj in gc_objects]
+    return (node_labels, sources, targets, labels), sizes
+
+
+def graph_sizes(graph: dict) -> list[int]:
+    """The node_sizes argument of the viewer for a generate_object_graph()."""
+    return [node.get("size", 0) for node in graph["nodes"]]
+
+
+def view_graph(graph: dict, block: bool = True, resolve_label=None):
+    """
+    Hand a graph from generate_object_graph() to the viewer in memory. With
+    block=False the viewer runs on its own thread and a graph_viewer.Viewer
+    handle is returned. resolve_label, e.g. from label_resolver(), supplies
+    full labels on demand.
+    """
+    import graph_viewer
+
+    arrays = graph_to_arrays(graph)
+    options = {"resolve_label": resolve_label, "node_sizes": graph_sizes(graph)}
+    if not block:
+        return graph_viewer.start_viewer(*arrays, **options)
+    graph_viewer.view_arrays(*arrays, **options)
+
+
 def collect_and_view(
     target: TargetType = None,
     output_file: Union[str, None] = None,
+    block: bool = True,
 ):
     """
-    Visualize the object graph.
+    Visualize the object graph. The graph is only written to disk when
+    output_file is given. With block=False the viewer stays open in the
+    background and its graph_viewer.Viewer handle is returned.
     """
 
-    json_file = collect_to_json(target, output_file)
-
     try:
         import graph_viewer
-
-        print("Opening graph viewer...")
-        graph_viewer.run_graph_viewer(json_file)
-        print("Done.")
     except ImportError:
         import sys
 
+        collect_to_json(target, output_file)
         print(
             "Please put the graph_viewer shared object, dylib, or dll in the proper place.",
             file=sys.stderr,
         )
         return
 
+    if output_file is not None:
+        json_file = collect_to_json(target, output_file)
+        print("Opening graph viewer...")
+        graph_viewer.run_graph_viewer(json_file)
+    else:
+        gc_objects = collect_objects(target)
+        resolve_label = label_resolver(gc_objects)
+        collect_graph = native_collector()
+        if collect_graph is None:
+            graph = generate_object_graph(gc_objects)
+            del gc_objects
+            print("Opening graph viewer...")
+            if not block:
+                return view_graph(graph, block=False, resolve_label=resolve_label)
+            view_graph(graph, resolve_label=resolve_label)
+        else:
+            arrays, sizes = objects_to_arrays(
+                gc_objects, collect_graph(gc_objects)
+            )
+            del gc_objects
+            options = {"resolve_label": resolve_label, "node_sizes": sizes}
+            print("Opening graph viewer...")
+            if not block:
+                return graph_viewer.start_viewer(*arrays, **options)
+            graph_viewer.view_arrays(*arrays, **options)
+    print("Done.")
+
 
 if __name__ == "__main__":
     collect_and_view()
@@ -1,6 +1,9 @@
 import graph_viewer
 import json
+import objgraph
 import os
+import sys
+import tempfile
 
 def create_test_json():
     test_data = {
@@ -21,6 +24,349 @@ def create_test_json():
     with open("test_graph.json", "w") as f:
         json.dump(test_data, f)
 
+def collected_edges(objects, collected):
+    offsets, targets, labels = collected
+    return {
+        (i, targets[k], labels[k])
+        for i in range(len(objects))
+        for k in range(offsets[i], offsets[i + 1])
+    }
+
+def test_collect_graph():
+    class Node:
+        pass
+    class Slotted:
+        __slots__ = ("ref",)
+    def function():
+        pass
+    function.tag = "tag"
+
+    leaf = Node()
+    parent = Node()
+    parent.child = leaf
+    slotted = Slotted()
+    slotted.ref = leaf
+    keyed = {"key": leaf, 1: parent}
+    objects = [parent, leaf, slotted, keyed, Node, function, vars(function)]
+
+    collected = graph_viewer.collect_graph(objects)
+    offsets, targets, labels = collected
+    assert len(offsets) == len(objects) + 1
+    assert offsets[0] == 0 and offsets[-1] == len(targets) == len(labels)
+    assert all(offsets[i] <= offsets[i + 1] for i in range(len(objects)))
+
+    edges = collected_edges(objects, collected)
+    assert (0, 4, "__class__") in edges
+    assert (2, 1, "ref") in edges
+    assert (3, 1, "key") in edges
+    assert (3, 0, None) in edges  # Only str keys name their values
+    assert (5, 6, "__dict__") in edges
+
+def test_collect_graph_without_labels():
+    class Node:
+        pass
+    parent = Node()
+    parent.child = Node()
+    objects = [parent, parent.child, vars(parent), Node]
+
+    offsets, targets, labels = graph_viewer.collect_graph(objects, labels=False)
+    assert labels is None
+    with_labels = graph_viewer.collect_graph(objects)
+    assert list(offsets) == list(with_labels[0])
+    assert list(targets) == list(with_labels[1])
+
+def test_objects_to_arrays():
+    class Node:
+        pass
+    parent = Node()
+    parent.child = Node()
+    objects = [parent, parent.child, vars(parent), {1: parent}, Node]
+
+    arrays, sizes = objgraph.objects_to_arrays(
+        objects, graph_viewer.collect_graph(objects))
+    graph = objgraph.generate_object_graph(objects)
+    expected = objgraph.graph_to_arrays(graph)
+    assert arrays[0] == expected[0]
+    assert list(arrays[1]) == list(expected[1])
+    assert list(arrays[2]) == list(expected[2])
+    assert arrays[3] == expected[3]
+    assert None not in arrays[3]
+    assert sizes == objgraph.graph_sizes(graph)
+
+def test_fill_edge_labels_of_proxy():
+    class Proxy:
+        def __getattribute__(self, name):
+            raise RuntimeError(name)
+    class Leaf:
+        pass
+    proxy = Proxy()
+    object.__setattr__(proxy, "child", Leaf())
+    objects = [proxy, object.__getattribute__(proxy, "child"), {1: proxy},
+               Proxy]
+
+    collected = graph_viewer.collect_graph(objects)
+    objgraph.fill_edge_labels(objects, collected)
+    edges = collected_edges(objects, collected)
+    assert (0, 1, "child") in edges
+    assert (2, 0, f"Indirect Reference to {Proxy}") in edges
+
+def write_json_graph(directory, name, nodes, edges):
+    path = os.path.join(directory, name)
+    with open(path, "w") as f:
+        json.dump({"nodes": nodes, "edges": edges}, f)
+    return path
+
+def test_diff_graphs():
+    with tempfile.TemporaryDirectory() as directory:
+        before = write_json_graph(directory, "before.json", [
+            {"id": 0, "label": "a", "type": "A", "address": 16},
+            {"id": 1, "label": "b", "type": "B", "address": 32},
+            {"id": 2, "label": "c", "type": "C", "address": 48},
+        ], [
+            {"source": 0, "target": 1, "label": "x"},
+            {"source": 1, "target": 2, "label": "y"},
+        ])
+        # b's address is reused by an object of another type
+        after = write_json_graph(directory, "after.json", [
+            {"id": 0, "label": "a", "type": "A", "address": 16},
+            {"id": 1, "label": "e", "type": "E", "address": 32},
+            {"id": 2, "label": "d", "type": "D", "address": 64},
+        ], [
+            {"source": 0, "target": 1, "label": "x"},
+            {"source": 0, "target": 2, "label": "z"},
+        ])
+        graph = graph_viewer.read_graph(after, before=before)
+
+    status = {node["label"]: node["diff"] for node in graph["nodes"]}
+    assert status == {"a": "retained", "d": "added", "e": "added",
+                      "b": "removed", "c": "removed"}
+    labels = [node["label"] for node in graph["nodes"]]
+    edges = {(labels[e["source"]], labels[e["target"]], e["label"])
+             for e in graph["edges"]}
+    # Edges of the removed objects are carried over from before
+    assert edges == {("a", "e", "x"), ("a", "d", "z"),
+                     ("a", "b", "x"), ("b", "c", "y")}
+
+class Fixture:
+    pass
+
+def fixture_objects():
+    parent = Fixture()
+    parent.child = Fixture()
+    return [parent, parent.child, Fixture]
+
+def check_fixture_graph(graph, objects, roots):
+    nodes = graph["nodes"]
+    assert len(nodes) == len(objects)
+    assert [node["address"] for node in nodes] == [id(obj) for obj in objects]
+    assert [node["type"] for node in nodes] == ["Fixture", "Fixture", "type"]
+    assert [node["root"] for node in nodes] == [
+        i in roots for i in range(len(objects))]
+    assert [node["size"] for node in nodes] == [
+        sys.getsizeof(obj, 0) for obj in objects]
+    edges = {(e["source"], e["target"], e["label"]) for e in graph["edges"]}
+    assert edges == {(0, 1, "child"), (0, 2, "__class__"), (1, 2, "__class__")}
+
+def test_read_graph_jsonl():
+    objects = fixture_objects()
+    with tempfile.TemporaryDirectory() as directory:
+        path = os.path.join(directory, "graph.jsonl")
+        with open(path, "w") as f:
+            objgraph.write_graph_jsonl(objects, f, roots={0})
+            # A stream cut short can end with an edge to a node it never wrote
+            f.write('{"source":1,"target":3,"label":"cut"}\n')
+        graph = graph_viewer.read_graph(path)
+    check_fixture_graph(graph, objects, {0})
+
+def test_read_graph_shards():
+    objects = fixture_objects()
+    roots = objgraph.external_roots(objects)
+    with tempfile.TemporaryDirectory() as directory:
+        path = os.path.join(directory, "graph.json")
+        objgraph.write_graph_shards(objects, path, workers=2)
+        with open(path) as f:
+            manifest = json.loads(f.readline())
+        assert manifest["shards"] == ["graph.0.json", "graph.1.json"]
+        graph = graph_viewer.read_graph(path)
+    # Edges leaving the first shard point into the second
+    check_fixture_graph(graph, objects, roots)
+
+def test_retained_sizes():
+    nodes = [
+        {"id": 0, "label": "root", "size": 10, "root": True},
+        {"id": 1, "label": "a", "size": 20},
+        {"id": 2, "label": "b", "size": 30},
+        {"id": 3, "label": "shared", "size": 5},
+        {"id": 4, "label": "garbage", "size": 7},
+    ]
+    edges = [
+        {"source": 0, "target": 1, "label": "a"},
+        {"source": 1, "target": 2, "label": "b"},
+        {"source": 0, "target": 3, "label": "shared"},
+        {"source": 1, "target": 3, "label": "shared"},
+        {"source": 4, "target": 0, "label": "root"},
+    ]
+    with tempfile.TemporaryDirectory() as directory:
+        path = write_json_graph(directory, "graph.json", nodes, edges)
+        graph = graph_viewer.read_graph(path, retained=True)
+
+    # "shared" is reachable around "a", so only the root dominates it
+    retained = {node["label"]: node["retained"] for node in graph["nodes"]}
+    assert retained == {"root": 65, "a": 50, "b": 30, "shared": 5,
+                        "garbage": 0}
+
+def test_weak_references_skipped():
+    nodes = [
+        {"id": 0, "label": "root", "size": 10, "root": True},
+        {"id": 1, "label": "a", "size": 20},
+        {"id": 2, "label": "weakly held", "size": 30},
+        {"id": 3, "label": "behind weak", "size": 7},
+        {"id": 4, "label": "both", "size": 1},
+    ]
+    edges = [
+        {"source": 0, "target": 1, "label": "a"},
+        {"source": 0, "target": 2, "label": objgraph.WEAKREF_EDGE_LABEL},
+        {"source": 2, "target": 3, "label": "x"},
+        {"source": 0, "target": 4, "label": objgraph.WEAKREF_EDGE_LABEL},
+        {"source": 1, "target": 4, "label": "y"},
+    ]
+    with tempfile.TemporaryDirectory() as directory:
+        path = write_json_graph(directory, "graph.json", nodes, edges)
+        graph = graph_viewer.read_graph(path, retained=True, reachable=True)
+        unfiltered = graph_viewer.read_graph(path, retained=True,
+                                             reachable=True, skip=[])
+
+    # Only the weak path leads to "weakly held"; "both" has a strong one too
+    reachable = {node["label"]: node["reachable"] for node in graph["nodes"]}
+    assert reachable == {"root": True, "a": True, "weakly held": False,
+                         "behind weak": False, "both": True}
+    retained = {node["label"]: node["retained"] for node in graph["nodes"]}
+    assert retained == {"root": 31, "a": 21, "weakly held": 0,
+                        "behind weak": 0, "both": 1}
+
+    assert all(node["reachable"] for node in unfiltered["nodes"])
+    retained = {node["label"]: node["retained"]
+                for node in unfiltered["nodes"]}
+    assert retained == {"root": 68, "a": 20, "weakly held": 37,
+                        "behind weak": 7, "both": 1}
+
+def write_edge_list(directory, edges, roots=(0,)):
+    """Write a graph given as (source, target, label) edges."""
+    count = max(max(source, target) for source, target, _ in edges) + 1
+    nodes = [{"id": i, "label": str(i), "root": i in roots}
+             for i in range(count)]
+    edges = [{"source": source, "target": target, "label": label}
+             for source, target, label in edges]
+    return write_json_graph(directory, "graph.json", nodes, edges)
+
+def select_in_graph(edges, node, mode, roots=(0,)):
+    """select_nodes() on a graph given as (source, target, label) edges."""
+    with tempfile.TemporaryDirectory() as directory:
+        path = write_edge_list(directory, edges, roots)
+        return graph_viewer.select_nodes(path, node, mode)
+
+def read_edge_list(edges, roots=(0,), **options):
+    """read_graph() on a graph given as (source, target, label) edges."""
+    with tempfile.TemporaryDirectory() as directory:
+        return graph_viewer.read_graph(
+            write_edge_list(directory, edges, roots), **options)
+
+def test_min_cut():
+    # Two disjoint paths from the root: both last references must go
+    disjoint = [(0, 1, "a"), (0, 2, "b"), (1, 3, "x"), (2, 3, "y")]
+    result = select_in_graph(disjoint, 3, "Min Cut")
+    assert sorted(result["cut"]) == [2, 3]
+    assert sorted(result["selected"]) == [1, 2, 3]
+
+    # Both paths run through one reference, which is the whole cut
+    shared = disjoint + [(3, 4, "shared")]
+    result = select_in_graph(shared, 4, "Min Cut")
+    assert [shared[e][2] for e in result["cut"]] == ["shared"]
+    assert sorted(result["selected"]) == [3, 4]
+
+def test_path_to_root():
+    edges = [(0, 1, "a"), (1, 2, "b"), (2, 3, "c"), (3, 5, "d"),  # Long
+             (0, 4, "x"), (4, 5, "y"),                            # Short
+             (6, 5, "garbage")]
+    result = select_in_graph(edges, 5, "Path to Root")
+    assert [edges[e][2] for e in result["path"]] == ["x", "y"]
+    assert sorted(result["selected"]) == [0, 4, 5]
+
+    # The nearest of several roots is the one reported
+    result = select_in_graph(edges, 5, "Path to Root", roots=(0, 3))
+    assert [edges[e][2] for e in result["path"]] == ["d"]
+
+def check_cycles(edges, node, cycles):
+    """Each cycle closes at node, and none is reported twice."""
+    for cycle in cycles:
+        assert edges[cycle[0]][0] == node and edges[cycle[-1]][1] == node
+        for e, f in zip(cycle, cycle[1:]):
+            assert edges[e][1] == edges[f][0]
+    assert len({tuple(cycle) for cycle in cycles}) == len(cycles)
+    lengths = [len(cycle) for cycle in cycles]
+    assert lengths == sorted(lengths)
+
+def test_cycles():
+    edges = [(0, 2, "a"), (2, 3, "b"), (3, 0, "c"),  # Length 3
+             (0, 1, "d"), (1, 0, "e"),               # Length 2
+             (0, 0, "self"),                         # Length 1
+             (1, 2, "f"), (4, 0, "g")]               # No more cycles
+    cycles = select_in_graph(edges, 0, "Cycles")["cycles"]
+    check_cycles(edges, 0, cycles)
+    assert cycles == [[5], [3, 4], [0, 1, 2], [3, 6, 1, 2]]
+
+    # A ring one reference too long is not followed
+    length = graph_viewer.MAX_CYCLE_LENGTH
+    edges = [(i, i + 1, "") for i in range(length)] + [(length, 0, "")]
+    edges += [(0, length + 1, "")]
+    edges += [(i, i + 1, "") for i in range(length + 1, 2 * length - 1)]
+    edges += [(2 * length - 1, 0, "")]
+    cycles = select_in_graph(edges, 0, "Cycles")["cycles"]
+    check_cycles(edges, 0, cycles)
+    assert [len(cycle) for cycle in cycles] == [length]
+
+    # Past MAX_CYCLES the search stops, keeping the shortest
+    edges = [(0, 0, "self")]
+    for i in range(1, graph_viewer.MAX_CYCLES + 5):
+        edges += [(0, i, ""), (i, 0, "")]
+    cycles = select_in_graph(edges, 0, "Cycles")["cycles"]
+    check_cycles(edges, 0, cycles)
+    assert len(cycles) == graph_viewer.MAX_CYCLES
+    assert cycles[0] == [0]
+
+def test_components():
+    edges = [(0, 1, ""), (1, 0, ""),               # First component
+             (1, 2, ""),
+             (2, 3, ""), (3, 4, ""), (4, 2, ""),   # Second component
+             (4, 5, ""), (5, 6, "")]               # Tail
+    nodes = read_edge_list(edges, components=True)["nodes"]
+    component = [node["component"] for node in nodes]
+    assert component[0] == component[1]
+    assert component[2] == component[3] == component[4]
+    assert len(set(component)) == 4
+
+    # Reverse topological: every edge between components points down
+    assert component[0] > component[2] > component[5] > component[6]
+    assert [node["layer"] for node in nodes] == [0, 0, 1, 1, 1, 2, 3]
+
+def test_chains():
+    shortest = graph_viewer.MIN_CHAIN_LENGTH
+    # Node 0 is a root, node 1 is referenced by both chains
+    plain = list(range(2, 2 + shortest + 1))
+    short = list(range(plain[-1] + 1, plain[-1] + shortest))
+    ring = [short[-1] + 1, short[-1] + 2, short[-1] + 3]
+    edges = []
+    for chain in (plain, short):
+        path = [0] + chain + [1]
+        edges += [(a, b, "") for a, b in zip(path, path[1:])]
+    edges += [(a, b, "") for a, b in zip(ring, ring[1:] + ring[:1])]
+
+    graph = read_edge_list(edges, chains=True)
+    chain = [node["chain"] for node in graph["nodes"]]
+    assert graph["chain_ends"] == [[0, 1]]
+    assert [chain[v] for v in plain] == [0] * len(plain)
+    assert [v for v in range(len(chain)) if chain[v] is not None] == plain
+
 def test_graph_viewer():
     create_test_json()
     
@@ -31,4 +377,18 @@ def test_graph_viewer():
     os.remove("test_graph.json")
 
 if __name__ == "__main__":
+    test_collect_graph()
+    test_collect_graph_without_labels()
+    test_objects_to_arrays()
+    test_fill_edge_labels_of_proxy()
+    test_diff_graphs()
+    test_read_graph_jsonl()
+    test_read_graph_shards()
+    test_retained_sizes()
+    test_weak_references_skipped()
+    test_min_cut()
+    test_path_to_root()
+    test_cycles()
+    test_components()
+    test_chains()
     test_graph_viewer()